@@ -8,22 +8,46 @@ CONFIG -= app_bundle
 CONFIG -= qt
 
 SOURCES += \
+    src/activation.c \
+    src/cgroup.c \
+    src/clock.c \
     src/filecmd.c \
     src/ini.c \
     src/apps.c \
     src/log.c \
     src/main.c \
+    src/monitor.c \
+    src/phi.c \
+    src/placement.c \
+    src/resource.c \
+    src/rollout.c \
     src/server.c \
+    src/state.c \
     src/stats.c \
     src/test.c \
-    src/utils.c
+    src/trace.c \
+    src/upgrade.c \
+    src/utils.c \
+    src/zygote.c
 
 HEADERS += \
+    src/activation.h \
+    src/cgroup.h \
+    src/clock.h \
     src/ini.h \
     src/filecmd.h \
     src/apps.h \
     src/log.h \
+    src/monitor.h \
+    src/phi.h \
+    src/placement.h \
+    src/resource.h \
+    src/rollout.h \
     src/server.h \
+    src/state.h \
     src/stats.h \
     src/test.h \
-    src/utils.h
+    src/trace.h \
+    src/upgrade.h \
+    src/utils.h \
+    src/zygote.h
@@ -0,0 +1,530 @@
+/**
+    @file activation.c
+    @brief Process Watchdog Application Manager
+
+    The Process Watchdog application manages the processes listed in the configuration file.
+    It listens to a specified UDP port for heartbeat messages from these processes, which must
+    periodically send their PID. If any process stops running or fails to send its PID over UDP
+    within the expected interval, the Process Watchdog application will restart the process.
+
+    The application ensures high reliability and availability by continuously monitoring and
+    restarting processes as necessary. It also logs various statistics about the monitored
+    processes, including start times, crash times, and heartbeat intervals.
+
+    @date 2023-01-01
+    @version 1.0
+    @author by Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license GPL-3 License
+*/
+
+#include "activation.h"
+#include "apps.h"
+#include "log.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define LISTEN_PID_ENV "LISTEN_PID=" // completed in the new process
+#define MAX_SPEC_LENGTH 128
+
+/**
+    @brief Address of a socket parsed from its specification.
+*/
+typedef struct
+{
+    struct sockaddr_storage addr; /**< Address to bind. */
+    socklen_t length; /**< Length of the address. */
+    int type; /**< SOCK_STREAM or SOCK_DGRAM. */
+} SocketAddress_t;
+
+static int fds[MAX_APPS][MAX_LISTEN_FDS]; // held by the watchdog, at or above LISTEN_FD_MIN
+static int counts[MAX_APPS];
+static int inherited[MAX_APPS][MAX_LISTEN_FDS]; // handed over by the previous image until opened, 0 if none
+
+// Copies the next socket specification of a comma or space separated list, returns false at the end
+static bool next_spec(const char **list, char *spec, size_t size)
+{
+    const char *s = *list + strspn(*list, ", \t");
+    size_t length = strcspn(s, ", \t");
+
+    if(0 == length)
+    {
+        return false;
+    }
+
+    snprintf(spec, size, "%.*s", (int)length, s);
+    *list = s + length;
+    return true;
+}
+
+// Parses tcp:[address:]port, udp:[address:]port, unix:path or unixgram:path
+static int parse_spec(const char *spec, SocketAddress_t *sa)
+{
+    memset(sa, 0, sizeof(*sa));
+    sa->type = (0 == strncmp(spec, "udp:", 4) || 0 == strncmp(spec, "unixgram:", 9)) ? SOCK_DGRAM : SOCK_STREAM;
+
+    if(0 == strncmp(spec, "tcp:", 4) || 0 == strncmp(spec, "udp:", 4))
+    {
+        struct sockaddr_in *in = (struct sockaddr_in *)&sa->addr;
+        const char *colon = strrchr(spec + 4, ':');
+        const char *port = (NULL != colon) ? colon + 1 : spec + 4;
+        char host[INET_ADDRSTRLEN] = "0.0.0.0";
+        int number = atoi(port);
+
+        if(NULL != colon)
+        {
+            snprintf(host, sizeof(host), "%.*s", (int)(colon - (spec + 4)), spec + 4);
+        }
+
+        if(number <= 0 || number > 65535 || 1 != inet_pton(AF_INET, host, &in->sin_addr))
+        {
+            return 1;
+        }
+
+        in->sin_family = AF_INET;
+        in->sin_port = htons(number);
+        sa->length = sizeof(*in);
+        return 0;
+    }
+
+    if(0 == strncmp(spec, "unix:", 5) || 0 == strncmp(spec, "unixgram:", 9))
+    {
+        struct sockaddr_un *un = (struct sockaddr_un *)&sa->addr;
+        const char *path = strchr(spec, ':') + 1;
+
+        if(0 == strlen(path) || strlen(path) >= sizeof(un->sun_path))
+        {
+            return 1;
+        }
+
+        un->sun_family = AF_UNIX;
+        strcpy(un->sun_path, path);
+        sa->length = sizeof(*un);
+        return 0;
+    }
+
+    return 1;
+}
+
+// Checks that the socket is listening on the address of the specification, a datagram socket is bound to it
+static bool is_listening(int fd, const SocketAddress_t *sa)
+{
+    struct sockaddr_storage addr;
+    socklen_t length = sizeof(addr);
+    int type = 0, listening = 0;
+    socklen_t size = sizeof(type);
+
+    if(0 != getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &size) || type != sa->type)
+    {
+        return false;
+    }
+
+    size = sizeof(listening);
+
+    if((SOCK_STREAM == type && (0 != getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &size) || !listening)) ||
+            0 != getsockname(fd, (struct sockaddr *)&addr, &length) || addr.ss_family != sa->addr.ss_family)
+    {
+        return false;
+    }
+
+    if(AF_INET == addr.ss_family)
+    {
+        return ((struct sockaddr_in *)&addr)->sin_port == ((struct sockaddr_in *)&sa->addr)->sin_port;
+    }
+
+    return 0 == strcmp(((struct sockaddr_un *)&addr)->sun_path, ((struct sockaddr_un *)&sa->addr)->sun_path);
+}
+
+// Checks if the path of a unix socket is left by a previous run, nobody accepts connections or datagrams on it
+static bool is_stale(const SocketAddress_t *sa)
+{
+    int fd = socket(AF_UNIX, sa->type | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+
+    if(0 > fd)
+    {
+        return false;
+    }
+
+    bool stale = (0 != connect(fd, (const struct sockaddr *)&sa->addr, sa->length) && (ECONNREFUSED == errno || ENOENT == errno));
+    close(fd);
+    return stale;
+}
+
+// Creates a listening socket, the path of a unix socket is replaced only if it is stale and has no owner
+static int create_socket(const SocketAddress_t *sa, bool owned)
+{
+    int optval = 1;
+
+    if(AF_UNIX == sa->addr.ss_family)
+    {
+        if(owned || !is_stale(sa))
+        {
+            errno = EADDRINUSE;
+            return -1;
+        }
+
+        unlink(((struct sockaddr_un *)&sa->addr)->sun_path); // left by a previous run
+    }
+
+    int fd = socket(sa->addr.ss_family, sa->type | SOCK_CLOEXEC, 0);
+
+    if(0 > fd)
+    {
+        return -1;
+    }
+
+    if(AF_INET == sa->addr.ss_family)
+    {
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+    }
+
+    // A datagram socket queues the datagrams once it is bound
+    if(0 != bind(fd, (const struct sockaddr *)&sa->addr, sa->length) || (SOCK_STREAM == sa->type && 0 != listen(fd, SOMAXCONN)))
+    {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+
+    return fd;
+}
+
+// Finds the same socket held for another application, e.g. an instance of the same pool
+static int find_shared(int i, const char *spec, const SocketAddress_t *sa)
+{
+    char other[MAX_SPEC_LENGTH];
+
+    for(int n = 0; n < get_app_count(); n++)
+    {
+        const char *list = get_listen(n);
+
+        for(int k = 0; n != i && !is_application_removed(n) && k < counts[n] && next_spec(&list, other, sizeof(other)); k++)
+        {
+            if(0 == strcmp(spec, other) && is_listening(fds[n][k], sa))
+            {
+                return fds[n][k];
+            }
+        }
+    }
+
+    return -1;
+}
+
+// Takes the socket passed to the process adopted from a previous watchdog
+static int take_from(int pid, int k, const SocketAddress_t *sa)
+{
+    int fd = -1;
+#if defined(SYS_pidfd_open) && defined(SYS_pidfd_getfd)
+    int pidfd = syscall(SYS_pidfd_open, pid, 0);
+
+    if(0 <= pidfd)
+    {
+        fd = syscall(SYS_pidfd_getfd, pidfd, LISTEN_FDS_START + k, 0); // close-on-exec
+
+        if(0 <= fd && !is_listening(fd, sa))
+        {
+            close(fd);
+            fd = -1;
+        }
+
+        close(pidfd);
+    }
+
+#else
+    UNUSED(pid);
+    UNUSED(k);
+    UNUSED(sa);
+#endif
+    return fd;
+}
+
+int activation_open(int i)
+{
+    const char *list = get_listen(i);
+    char spec[MAX_SPEC_LENGTH];
+    SocketAddress_t sa;
+    int pid = is_application_running(i) ? get_app_pid(i) : 0;
+    activation_close(i, false); // held for a removed application using the same index
+
+    while(next_spec(&list, spec, sizeof(spec)))
+    {
+        int fd, shared;
+
+        if(counts[i] >= MAX_LISTEN_FDS)
+        {
+            LOGE("%s has more than %d sockets, %s is ignored", get_app_name(i), MAX_LISTEN_FDS, spec);
+            continue;
+        }
+
+        if(parse_spec(spec, &sa))
+        {
+            LOGE("Invalid socket of %s : %s", get_app_name(i), spec);
+            continue;
+        }
+
+        // Handed over by the previous image, kept at the same descriptor for a rollback
+        if(0 < (fd = inherited[i][counts[i]]) && is_listening(fd, &sa))
+        {
+            inherited[i][counts[i]] = 0;
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+            fds[i][counts[i]++] = fd;
+            LOGD("Socket %s of %s is handed over by the previous image", spec, get_app_name(i));
+            continue;
+        }
+
+        if(0 < pid && 0 <= (fd = take_from(pid, counts[i], &sa)))
+        {
+            LOGD("Socket %s of %s is taken from PID %d", spec, get_app_name(i), pid);
+        }
+        else if(0 <= (shared = find_shared(i, spec, &sa)))
+        {
+            fd = dup(shared);
+        }
+        else
+        {
+            // The adopted process still owns the path of its unix socket, it is not replaced under it
+            fd = create_socket(&sa, 0 < pid);
+        }
+
+        if(0 > fd)
+        {
+            LOGE("Socket %s of %s cannot be opened : %s", spec, get_app_name(i), strerror(errno));
+            continue;
+        }
+
+        // Kept above the descriptors the sockets are moved to in the new process
+        fds[i][counts[i]] = fcntl(fd, F_DUPFD_CLOEXEC, LISTEN_FD_MIN);
+        close(fd);
+
+        if(0 > fds[i][counts[i]])
+        {
+            LOGE("Socket %s of %s cannot be kept : %s", spec, get_app_name(i), strerror(errno));
+            continue;
+        }
+
+        counts[i]++;
+    }
+
+    if(0 < counts[i])
+    {
+        LOGI("%d sockets of %s are held by the watchdog", counts[i], get_app_name(i));
+    }
+    else if(is_on_demand(i))
+    {
+        LOGW("%s has no sockets to be activated on, it is started at once", get_app_name(i));
+    }
+
+    return counts[i];
+}
+
+void activation_close(int i, bool unlink_paths)
+{
+    const char *list = get_listen(i);
+    char spec[MAX_SPEC_LENGTH];
+    SocketAddress_t sa;
+
+    for(int k = 0; k < counts[i]; k++)
+    {
+        close(fds[i][k]);
+    }
+
+    // The paths of the sockets shared with another application are kept
+    while(unlink_paths && 0 < counts[i] && next_spec(&list, spec, sizeof(spec)))
+    {
+        if(0 == parse_spec(spec, &sa) && AF_UNIX == sa.addr.ss_family && 0 > find_shared(i, spec, &sa))
+        {
+            unlink(((struct sockaddr_un *)&sa.addr)->sun_path);
+        }
+    }
+
+    counts[i] = 0;
+}
+
+int activation_start(void)
+{
+    int count = 0;
+
+    for(int i = 0; i < get_app_count(); i++)
+    {
+        if(!is_application_removed(i))
+        {
+            count += activation_open(i);
+        }
+    }
+
+    // The sockets handed over for applications or addresses not in the ini file anymore
+    for(int i = 0; i < MAX_APPS; i++)
+    {
+        for(int k = 0; k < MAX_LISTEN_FDS; k++)
+        {
+            if(0 < inherited[i][k])
+            {
+                close(inherited[i][k]);
+                inherited[i][k] = 0;
+            }
+        }
+    }
+
+    return count;
+}
+
+void activation_inherit(int i, int k, int fd)
+{
+    if(0 > i || i >= MAX_APPS || 0 > k || k >= MAX_LISTEN_FDS || LISTEN_FD_MIN > fd)
+    {
+        LOGW("Invalid socket %d handed over by the previous image", fd);
+        return;
+    }
+
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    inherited[i][k] = fd;
+}
+
+void activation_inheritable(bool inheritable)
+{
+    // Called from a signal handler too, only fcntl is used
+    for(int i = 0; i < MAX_APPS; i++)
+    {
+        for(int k = 0; k < MAX_LISTEN_FDS; k++)
+        {
+            if(k < counts[i])
+            {
+                fcntl(fds[i][k], F_SETFD, inheritable ? 0 : FD_CLOEXEC);
+            }
+
+            if(0 < inherited[i][k])
+            {
+                fcntl(inherited[i][k], F_SETFD, inheritable ? 0 : FD_CLOEXEC);
+            }
+        }
+    }
+}
+
+void activation_stop(bool unlink_paths)
+{
+    for(int i = 0; i < get_app_count(); i++)
+    {
+        activation_close(i, unlink_paths);
+    }
+}
+
+int activation_count(int i)
+{
+    return counts[i];
+}
+
+bool activation_pending(int i)
+{
+    struct pollfd pfd[MAX_LISTEN_FDS];
+
+    for(int k = 0; k < counts[i]; k++)
+    {
+        pfd[k].fd = fds[i][k];
+        pfd[k].events = POLLIN;
+        pfd[k].revents = 0;
+    }
+
+    // A listening socket is readable when a connection is queued, a datagram socket when a datagram is
+    return 0 < counts[i] && 0 < poll(pfd, counts[i], 0);
+}
+
+int activation_fds(int i, int *out, int max)
+{
+    int n = 0;
+
+    for(int k = 0; k < counts[i] && n < max; k++)
+    {
+        out[n++] = fds[i][k];
+    }
+
+    return n;
+}
+
+char **activation_environ(int i)
+{
+    extern char **environ;
+    int env_count = 0;
+    size_t names = counts[i] * (strlen(get_app_name(i)) + 1) + sizeof("LISTEN_FDNAMES=");
+
+    if(0 == counts[i])
+    {
+        return NULL;
+    }
+
+    while(NULL != environ[env_count])
+    {
+        env_count++;
+    }
+
+    // Pointers, then LISTEN_PID, LISTEN_FDS and LISTEN_FDNAMES in the same allocation
+    char **envp = malloc((env_count + 4) * sizeof(char *) + sizeof(LISTEN_PID_ENV) + 16 + 32 + names);
+
+    if(NULL == envp)
+    {
+        return NULL;
+    }
+
+    char *s = (char *)&envp[env_count + 4];
+    int n = 0;
+
+    envp[n++] = s;
+    s += snprintf(s, sizeof(LISTEN_PID_ENV) + 16, "%s", LISTEN_PID_ENV) + 16; // room for the PID
+
+    envp[n++] = s;
+    s += sprintf(s, "LISTEN_FDS=%d", counts[i]) + 1;
+    envp[n++] = s;
+    s += sprintf(s, "LISTEN_FDNAMES=");
+
+    for(int k = 0; k < counts[i]; k++)
+    {
+        s += sprintf(s, "%s%s", k ? ":" : "", get_app_name(i));
+    }
+
+    for(int k = 0; k < env_count; k++)
+    {
+        if(0 != strncmp(environ[k], "LISTEN_", 7))
+        {
+            envp[n++] = environ[k];
+        }
+    }
+
+    envp[n] = NULL;
+    return envp;
+}
+
+void activation_child(int i, char **envp)
+{
+    char *p = envp[0] + sizeof(LISTEN_PID_ENV) - 1;
+    char digits[16];
+    int length = 0;
+
+    for(int k = 0; k < counts[i]; k++)
+    {
+        dup2(fds[i][k], LISTEN_FDS_START + k); // without close-on-exec
+    }
+
+    for(long pid = syscall(SYS_getpid); 0 < pid; pid /= 10)
+    {
+        digits[length++] = '0' + pid % 10;
+    }
+
+    while(0 < length)
+    {
+        *p++ = digits[--length];
+    }
+
+    *p = 0;
+}
@@ -0,0 +1,139 @@
+/**
+    @file activation.h
+    @brief Process Watchdog Application Manager
+
+    The Process Watchdog application manages the processes listed in the configuration file.
+    It listens to a specified UDP port for heartbeat messages from these processes, which must
+    periodically send their PID. If any process stops running or fails to send its PID over UDP
+    within the expected interval, the Process Watchdog application will restart the process.
+
+    The application ensures high reliability and availability by continuously monitoring and
+    restarting processes as necessary. It also logs various statistics about the monitored
+    processes, including start times, crash times, and heartbeat intervals.
+
+    @date 2023-01-01
+    @version 1.0
+    @author by Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license GPL-3 License
+*/
+
+#ifndef ACTIVATION_H
+#define ACTIVATION_H
+
+#include <stdbool.h>
+
+/**
+    @file activation.h
+    @brief Socket activation of the applications.
+
+    The listening sockets of an application are created once by the watchdog and passed to
+    every process it spawns, as sd_listen_fds() expects : from file descriptor 3 on, with
+    LISTEN_FDS, LISTEN_PID and LISTEN_FDNAMES in the environment. While the application
+    restarts, the kernel queues the new connections in the backlog of the sockets held by
+    the watchdog instead of refusing them, the datagrams in the receive queue of the
+    datagram sockets. Instances of a pool with the same socket share it.
+    The sockets of an application adopted from a previous watchdog are taken from the
+    process with pidfd_getfd(), an upgrade in place hands all of them over to the new image. An application activated on demand is started only once a
+    connection or a datagram is queued on one of its sockets, the main loop wakes up on them.
+*/
+
+#define MAX_LISTEN_FDS 8 /**< Maximum number of sockets of an application. */
+#define LISTEN_FDS_START 3 /**< First file descriptor of the sockets in the application. */
+#define LISTEN_FD_MIN 100 /**< Lowest file descriptor the sockets are kept at, above the ones they are passed at. */
+
+/**
+    @brief Opens the sockets of all the applications.
+
+    @return Number of the sockets opened.
+*/
+int activation_start(void);
+
+/**
+    @brief Closes the sockets of all the applications.
+
+    @param unlink_paths Remove the paths of the unix sockets, false when the applications are handed over.
+*/
+void activation_stop(bool unlink_paths);
+
+/**
+    @brief Records a socket of the specified application handed over by the previous image, it is
+    used by activation_open() and closed by activation_start() if it is not used.
+
+    @param i Index of the application.
+    @param k Index of the socket in the listen list of the application.
+    @param fd File descriptor inherited across execve().
+*/
+void activation_inherit(int i, int k, int fd);
+
+/**
+    @brief Makes the sockets held and handed over inheritable across execve(), or close-on-exec again.
+
+    Only async-signal-safe calls are made.
+
+    @param inheritable true before an upgrade or a rollback, false if it has failed.
+*/
+void activation_inheritable(bool inheritable);
+
+/**
+    @brief Opens the sockets of the specified application, uses the ones handed over by the previous
+    image, shares the ones of another application or takes them from its adopted process.
+
+    @param i Index of the application.
+    @return Number of the sockets opened.
+*/
+int activation_open(int i);
+
+/**
+    @brief Closes the sockets of the specified application.
+
+    @param i Index of the application.
+    @param unlink_paths Remove the paths of the unix sockets not shared with another application.
+*/
+void activation_close(int i, bool unlink_paths);
+
+/**
+    @brief Gets the number of sockets of the specified application.
+
+    @param i Index of the application.
+    @return Number of the sockets.
+*/
+int activation_count(int i);
+
+/**
+    @brief Checks if a connection or a datagram is queued on a socket of the specified application.
+
+    @param i Index of the application.
+    @return true if one of the sockets is readable, false otherwise or if the application has no sockets.
+*/
+bool activation_pending(int i);
+
+/**
+    @brief Gets the file descriptors of the sockets of the specified application.
+
+    @param i Index of the application.
+    @param out Array to store the file descriptors.
+    @param max Size of the array.
+    @return Number of the file descriptors stored.
+*/
+int activation_fds(int i, int *out, int max);
+
+/**
+    @brief Builds the environment of the specified application with the LISTEN_ variables, LISTEN_PID
+    is completed by activation_child() in the new process.
+
+    @param i Index of the application.
+    @return Allocated environment to be released with free(), NULL if the application has no sockets.
+*/
+char **activation_environ(int i);
+
+/**
+    @brief Moves the sockets of the specified application to their file descriptors and completes
+    LISTEN_PID, in the new process before its exec. Only async-signal-safe calls are made.
+
+    @param i Index of the application.
+    @param envp Environment built by activation_environ() with LISTEN_PID.
+*/
+void activation_child(int i, char **envp);
+
+#endif // ACTIVATION_H
@@ -19,10 +19,18 @@
 */
 
 #include "apps.h"
+#include "activation.h"
+#include "cgroup.h"
+#include "clock.h"
 #define INI_MAX_LINE MAX_APP_CMD_LENGTH
 #include "ini.h"
 #include "log.h"
+#include "phi.h"
+#include "placement.h"
+#include "stats.h"
+#include "trace.h"
 #include "utils.h"
+#include "zygote.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -33,8 +41,11 @@
 #include <limits.h>
 #include <time.h>
 #include <signal.h>
+#include <spawn.h>
 #include <unistd.h>
+#include <poll.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <errno.h>
@@ -49,22 +60,100 @@ typedef struct
     int start_delay; /**< Delay in seconds before starting the application. */
     int heartbeat_delay; /**< Time in seconds to wait before expecting a heartbeat from the application. */
     int heartbeat_interval; /**< Maximum time period in seconds between heartbeats. */
+    int heartbeat_max; /**< Maximum time period in seconds an application may request with NEXT, 0 ignores NEXT. */
+    double phi_threshold; /**< Suspicion level of the phi accrual detector restarting the application, 0 disables it. */
     char name[MAX_APP_NAME_LENGTH]; /**< Name of the application. */
     char cmd[MAX_APP_CMD_LENGTH]; /**< Command to start the application. */
+    char depends_on[MAX_APP_CMD_LENGTH]; /**< Names of the applications to wait for before starting. */
+    int restart_backoff; /**< Backoff before the second restart in a row (seconds). */
+    int restart_backoff_max; /**< Maximum restart backoff and hold time of a crash loop (seconds). */
+    int restart_limit; /**< Number of restarts in restart_window which marks a crash loop, 0 disables. */
+    int restart_window; /**< Window of the crash loop detection (seconds). */
+    int max_rss; /**< Maximum resident set size (MB), 0 unlimited. */
+    int max_cpu; /**< Maximum CPU usage (percent of one core), 0 unlimited. */
+    int max_cpu_duration; /**< Time the CPU usage may stay over max_cpu (seconds). */
+    char cpu_max[32]; /**< cpu.max of the cgroup, empty unlimited. */
+    char memory_max[32]; /**< memory.max of the cgroup, empty unlimited. */
+    int io_weight; /**< io.weight of the cgroup, 0 default. */
+    char cpu_affinity[MAX_APP_CMD_LENGTH]; /**< CPUs to run on, "auto" to spread, empty for all. */
+    char numa_nodes[MAX_APP_CMD_LENGTH]; /**< NUMA nodes to allocate memory from, "auto" for the nodes of the CPUs, empty for all. */
+    char numa_policy[16]; /**< NUMA memory policy, "bind", "preferred" or "interleave". */
+    int nice; /**< Nice value, NICE_INHERIT to keep the one of the watchdog. */
+    char ionice[32]; /**< I/O scheduling class and level, empty to inherit. */
+    char sched_policy[32]; /**< Scheduling policy and priority, empty to inherit. */
+    char listen[MAX_APP_CMD_LENGTH]; /**< Sockets held by the watchdog and passed to the application, empty for none. */
+    bool on_demand; /**< Started on the first connection or datagram on its sockets instead of with the watchdog. */
+    int idle_timeout; /**< Time without reported activity stopping the application started on demand (seconds), 0 never. */
+    bool ready_notify; /**< Ready on a heartbeat carrying READY=1 instead of on the first heartbeat. */
+    int ready_timeout; /**< Time from the spawn within which READY=1 must be received with notify readiness (seconds). */
+    bool warm_spare; /**< A second process is kept paused after its initialisation to take over a failure. */
+    char zygote[MAX_APP_CMD_LENGTH]; /**< Command of the fork server the application is started from, empty for none. */
+    int instances; /**< Number of instances, 0 if the application is not a pool. */
+    int rollout_batch; /**< Maximum number of instances restarting at a time in a rollout. */
+    int rollout_max_failures; /**< Number of failed instances aborting a rollout, 0 never aborts. */
+    // Prepared from the ini file
+    char pool[MAX_APP_NAME_LENGTH]; /**< Name of the pool of the instance, empty if the application is not a pool. */
+    int instance; /**< Instance number within the pool, from 0. */
+    int depends[MAX_APP_DEPENDS]; /**< Indexes of the applications to wait for before starting. */
+    int depend_count; /**< Number of the applications to wait for. */
+    char args[MAX_APP_CMD_LENGTH]; /**< Tokenised copy of the command, argv points into it. */
+    char *argv[MAX_APP_ARGS]; /**< Arguments of the command, NULL terminated, argv[0] is NULL if the command is invalid. */
+    char exe[MAX_APP_CMD_LENGTH]; /**< Executable of the command resolved in PATH. */
     // Not in the ini file
     bool started; /**< Flag indicating whether the application has been started. */
+    bool spawning; /**< Flag indicating that the zygote is forking the process, its PID is not known yet. */
     bool first_heartbeat; /**< Flag indicating whether the application has sent its first heartbeat. */
     int pid; /**< Process ID of the application. */
+    int pgid; /**< Process group of the application, 0 if it has none. */
     time_t last_heartbeat; /**< Time when the last heartbeat was received from the application. */
+    clk_t last_heartbeat_ms; /**< Monotonic time when the last heartbeat was received (milliseconds). */
+    clk_t next_heartbeat_ms; /**< Time the application requested until its next heartbeat, 0 if none (milliseconds). */
+    clk_t last_alive_ms; /**< Monotonic time when the application was last seen running (milliseconds). */
+    clk_t started_ms; /**< Monotonic time of the last spawn (milliseconds). */
+    clk_t restart_at; /**< Monotonic time of the scheduled restart, 0 if none (milliseconds). */
+    clk_t stop_at; /**< Monotonic time SIGTERM was sent by stop_application(), 0 if none (milliseconds). */
+    StopAction_t stop_then; /**< Action taken once the process stopped by stop_application() has exited. */
+    clk_t restarts[MAX_RESTART_LIMIT]; /**< Monotonic times of the recent restarts, a ring buffer (milliseconds). */
+    int restart_head; /**< Next slot in restarts. */
+    int backoff_level; /**< Number of restarts in a row without a stable run. */
+    bool crash_loop; /**< Flag indicating that the application is in a crash loop. */
+    bool removed; /**< Flag indicating that the application is removed from the ini file, its slot is free. */
+    bool adopted; /**< Flag indicating that the process was started by a previous watchdog, it is not a child. */
+    bool forked; /**< Flag indicating that the process was forked by the zygote, it is not a child. */
+    int pidfd; /**< pidfd of the adopted or forked process, -1 if pidfd is not supported. */
+    unsigned long long start_time; /**< Start time of the adopted or forked process (clock ticks after boot). */
+    clk_t active_ms; /**< Monotonic time of the last activity reported by the application (milliseconds). */
+    int spare_pid; /**< Process ID of the warm spare, 0 if none. */
+    int spare_pgid; /**< Process group of the warm spare, 0 if it has none. */
+    bool spare_ready; /**< Flag indicating that the warm spare has sent its first heartbeat and is paused. */
+    bool spare_spawning; /**< Flag indicating that the zygote is forking the warm spare, its PID is not known yet. */
+    bool spare_forked; /**< Flag indicating that the warm spare was forked by the zygote, it is not a child. */
+    clk_t spare_started_ms; /**< Monotonic time of the last spawn of a warm spare, 0 to start the next one at once (milliseconds). */
 } Application_t;
 
 static Application_t apps[MAX_APPS]; /**< Array of Application_t structures representing applications defined in the ini file. */
-static int app_count; /**< Total number of applications found in the ini file. */
+static int app_count; /**< Total number of applications found in the ini file, the instances included. */
+static int ini_count; /**< Number of the application entries in the ini file. */
 static int udp_port = 12345; /**< UDP port number specified in the ini file. */
 static char ini_file[MAX_APP_CMD_LENGTH] = INI_FILE; /**< Path to the ini file. */
 static time_t ini_last_modified_time; /**< Last modified time of the ini file. */
 static long uptime; /**< System uptime in seconds. */
 static int ini_index; /**< Index used to read an array in the ini file. */
+static Application_t *parsed = apps; /**< Table the ini file is read into. */
+static AppChange_t changes[MAX_APPS]; /**< Changes of the applications by the last reload. */
+static int parsed_count; /**< Number of the applications read into parsed. */
+static char trace_file[MAX_APP_CMD_LENGTH]; /**< Path of the lifecycle trace file, empty if disabled. */
+static int sample_interval = SAMPLE_INTERVAL; /**< Resource usage sample interval (seconds), 0 disabled. */
+static char cgroup_root[MAX_APP_CMD_LENGTH]; /**< Root of the application cgroups, "auto" for the cgroup of the watchdog, empty or "none" disabled. */
+static char state_file[MAX_APP_CMD_LENGTH]; /**< Path of the state file handed over to the next watchdog, empty if disabled. */
+
+static int os_spawn(int i);
+static int os_wait(int pid, int *status, int options);
+static const ProcessOps_t os_process_ops = { os_spawn, kill, os_wait }; /**< Operations on real processes. */
+static const ProcessOps_t *process = &os_process_ops; /**< Process operations in use. */
+static bool spawning_spare; /**< The process spawned is a warm spare, it joins the cgroup of the application when promoted. */
+
+extern char **environ;
 
 //------------------------------------------------------------------
 
@@ -75,7 +164,44 @@ void print_app(int i)
     LOGN("%d- start_delay       : %d", i, apps[i].start_delay);
     LOGN("%d- heartbeat_delay   : %d", i, apps[i].heartbeat_delay);
     LOGN("%d- heartbeat_interval: %d", i, apps[i].heartbeat_interval);
+    LOGN("%d- heartbeat_max     : %d", i, apps[i].heartbeat_max);
+    LOGN("%d- phi_threshold     : %.1f", i, apps[i].phi_threshold);
+    LOGN("%d- depends_on        : %s", i, apps[i].depends_on);
+    LOGN("%d- restart_backoff   : %d", i, apps[i].restart_backoff);
+    LOGN("%d- restart_backoff_max: %d", i, apps[i].restart_backoff_max);
+    LOGN("%d- restart_limit     : %d", i, apps[i].restart_limit);
+    LOGN("%d- restart_window    : %d", i, apps[i].restart_window);
+    LOGN("%d- max_rss_mb        : %d", i, apps[i].max_rss);
+    LOGN("%d- max_cpu_pct       : %d", i, apps[i].max_cpu);
+    LOGN("%d- max_cpu_duration  : %d", i, apps[i].max_cpu_duration);
+    LOGN("%d- cpu_max           : %s", i, apps[i].cpu_max);
+    LOGN("%d- memory_max        : %s", i, apps[i].memory_max);
+    LOGN("%d- io_weight         : %d", i, apps[i].io_weight);
+    LOGN("%d- cpu_affinity      : %s", i, apps[i].cpu_affinity);
+    LOGN("%d- numa_nodes        : %s", i, apps[i].numa_nodes);
+    LOGN("%d- numa_policy       : %s", i, apps[i].numa_policy);
+    LOGN("%d- nice              : %d", i, apps[i].nice);
+    LOGN("%d- ionice            : %s", i, apps[i].ionice);
+    LOGN("%d- sched_policy      : %s", i, apps[i].sched_policy);
+    LOGN("%d- listen            : %s", i, apps[i].listen);
+    LOGN("%d- activation        : %s", i, apps[i].on_demand ? ACTIVATION_ON_DEMAND : ACTIVATION_ALWAYS);
+    LOGN("%d- idle_timeout      : %d", i, apps[i].idle_timeout);
+    LOGN("%d- readiness         : %s", i, apps[i].ready_notify ? READINESS_NOTIFY : READINESS_HEARTBEAT);
+    LOGN("%d- ready_timeout     : %d", i, apps[i].ready_timeout);
+    LOGN("%d- warm_spare        : %d", i, apps[i].warm_spare);
+    LOGN("%d- zygote            : %s", i, apps[i].zygote);
+    LOGN("%d- pool              : %s", i, apps[i].pool);
+    LOGN("%d- instance          : %d of %d", i, apps[i].instance, apps[i].instances);
+    LOGN("%d- rollout_batch     : %d", i, apps[i].rollout_batch);
+    LOGN("%d- rollout_max_failures: %d", i, apps[i].rollout_max_failures);
     LOGN("%d- cmd               : %s", i, apps[i].cmd);
+    LOGN("%d- exe               : %s", i, apps[i].exe);
+
+    for(int n = 0; NULL != apps[i].argv[n]; n++)
+    {
+        LOGN("%d- argv[%d]           : %s", i, n, apps[i].argv[n]);
+    }
+
     LOGN("%d- started           : %d", i, apps[i].started);
     LOGN("%d- first_heartbeat   : %d", i, apps[i].first_heartbeat);
     LOGN("%d- pid               : %d", i, apps[i].pid);
@@ -86,10 +212,42 @@ void print_app(int i)
 
 void update_heartbeat_time(int i)
 {
-    apps[i].last_heartbeat = time(NULL);
+    apps[i].last_heartbeat = clock_time();
+    apps[i].last_heartbeat_ms = clock_ms();
+    apps[i].next_heartbeat_ms = 0;
     LOGD("Heartbeat time updated for %s", apps[i].name);
 }
 
+void set_next_heartbeat(int i, long ms)
+{
+    clk_t max = (clk_t)apps[i].heartbeat_max * 1000;
+
+    if(0 == max || 0 >= ms)
+    {
+        return;
+    }
+
+    apps[i].next_heartbeat_ms = ((clk_t)ms < max) ? (clk_t)ms : max;
+    LOGD("%s requested its next heartbeat within %llu ms", apps[i].name, (unsigned long long)apps[i].next_heartbeat_ms);
+}
+
+void update_activity_time(int i)
+{
+    apps[i].active_ms = clock_ms();
+}
+
+bool is_idle(int i)
+{
+    return apps[i].on_demand && 0 < apps[i].idle_timeout &&
+           clock_ms() - apps[i].active_ms >= (clk_t)apps[i].idle_timeout * 1000;
+}
+
+bool is_ready_late(int i)
+{
+    return apps[i].ready_notify && !apps[i].first_heartbeat &&
+           clock_ms() - apps[i].started_ms >= (clk_t)apps[i].ready_timeout * 1000;
+}
+
 int find_pid(int pid)
 {
     for(int i = 0; i < app_count; i++)
@@ -105,23 +263,58 @@ int find_pid(int pid)
 
 time_t get_heartbeat_time(int i)
 {
-    time_t t = time(NULL);
+    time_t t = clock_time();
     return t - apps[i].last_heartbeat;
 }
 
+clk_t get_heartbeat_ms(int i)
+{
+    return apps[i].last_heartbeat_ms;
+}
+
+clk_t get_alive_time(int i)
+{
+    return apps[i].last_alive_ms;
+}
+
+time_t get_startup_time(int i)
+{
+    return (time_t)((clock_ms() - apps[i].started_ms) / 1000);
+}
+
 bool is_timeup(int i)
 {
-    bool ret = false;
-    time_t t = time(NULL);
+    bool ret;
+    time_t t = clock_time();
 
     if(t < apps[i].last_heartbeat)
     {
         update_heartbeat_time(i);
     }
 
-    if(t - apps[i].last_heartbeat >= (apps[i].first_heartbeat ? apps[i].heartbeat_interval : apps[i].heartbeat_delay))
+    if(0 < apps[i].next_heartbeat_ms)
+    {
+        ret = (clock_ms() - apps[i].last_heartbeat_ms >= apps[i].next_heartbeat_ms);
+    }
+    else
+    {
+        ret = (t - apps[i].last_heartbeat >= (apps[i].first_heartbeat ? apps[i].heartbeat_interval : apps[i].heartbeat_delay));
+
+        // The detector may suspect a running application before heartbeat_interval, never after
+        if(!ret && apps[i].first_heartbeat && 0 < apps[i].phi_threshold)
+        {
+            double phi = phi_value(i, clock_ms() - apps[i].last_heartbeat_ms);
+
+            if(phi >= apps[i].phi_threshold)
+            {
+                ret = true;
+                LOGD("Heartbeat of %s is suspected, phi %.1f", apps[i].name, phi);
+            }
+        }
+    }
+
+    if(ret)
     {
-        ret = true;
         LOGD("Heartbeat time up for %s", apps[i].name);
     }
 
@@ -163,17 +356,126 @@ int set_ini_file(char *path)
     return ret;
 }
 
-static time_t file_modified_time(char *path)
+// Gets the last modification time of the file, mtime is left unchanged on failure
+static int file_modified_time(const char *path, time_t *mtime)
 {
     struct stat attr;
-    stat(path, &attr);
-    return attr.st_mtime;
+
+    if(0 != stat(path, &attr))
+    {
+        return 1;
+    }
+
+    *mtime = attr.st_mtime;
+    return 0;
 }
 
 bool is_ini_updated()
 {
-    time_t file_last_modified_time = file_modified_time(ini_file);
-    return (file_last_modified_time != ini_last_modified_time);
+    time_t file_last_modified_time;
+
+    // A file being replaced can be missing for a moment, it is compared once it is back
+    if(file_modified_time(ini_file, &file_last_modified_time))
+    {
+        return false;
+    }
+
+    // A file being written is read once it has not changed for a second
+    return (file_last_modified_time != ini_last_modified_time && time(NULL) > file_last_modified_time);
+}
+
+// Tokenises the command and resolves its executable once, so nothing is parsed at spawn time
+static void prepare_command(Application_t *app)
+{
+    memcpy(app->args, app->cmd, sizeof(app->args));
+    app->args[sizeof(app->args) - 1] = '\0';
+
+    if(0 >= split_command(app->args, app->argv, MAX_APP_ARGS))
+    {
+        LOGE("CMD of %s is invalid, check the quotes and the number of arguments (max %d)", app->name, MAX_APP_ARGS - 1);
+        app->argv[0] = NULL;
+        return;
+    }
+
+    if(!find_executable(app->argv[0], app->exe, sizeof(app->exe)))
+    {
+        LOGE("Executable %s of %s is not found", app->argv[0], app->name);
+    }
+}
+
+// Replaces every %i in the string with the instance number
+static void substitute_instance(char *s, size_t size, int instance)
+{
+    char buf[MAX_APP_CMD_LENGTH];
+    size_t n = 0;
+
+    for(const char *p = s; '\0' != *p && n < sizeof(buf) - 1; p++)
+    {
+        if('%' == p[0] && 'i' == p[1])
+        {
+            n += snprintf(&buf[n], sizeof(buf) - n, "%d", instance);
+            n = (n < sizeof(buf)) ? n : sizeof(buf) - 1;
+            p++;
+        }
+        else
+        {
+            buf[n++] = *p;
+        }
+    }
+
+    buf[n] = '\0';
+    strncpy(s, buf, size - 1);
+    s[size - 1] = '\0';
+}
+
+// Expands the application read at index first into its instances, returns the number of them
+static int expand_instances(int first)
+{
+    Application_t app = parsed[first];
+    int count = app.instances;
+
+    if(0 == count) // not a pool
+    {
+        prepare_command(&parsed[first]);
+        return 1;
+    }
+
+    if(count > MAX_APPS - first)
+    {
+        LOGE("%d instances of %s do not fit in %d applications, rebuild with MAX_APPS", count, app.name, MAX_APPS);
+        count = MAX_APPS - first;
+    }
+
+    // The pool is named without the instance number, e.g. worker-%i is the pool worker
+    const char *p = strstr(app.name, "%i");
+
+    if(NULL != p)
+    {
+        int length = p - app.name;
+        length -= (0 < length && NULL != strchr("-_.", app.name[length - 1])) ? 1 : 0;
+        snprintf(app.pool, sizeof(app.pool), "%.*s%s", length, app.name, p + 2);
+    }
+    else
+    {
+        strncpy(app.pool, app.name, sizeof(app.pool) - 1);
+        snprintf(app.name, sizeof(app.name), "%.*s-%%i", (int)sizeof(app.name) - 4, app.pool);
+    }
+
+    for(int n = 0; n < count; n++)
+    {
+        Application_t *instance = &parsed[first + n];
+        *instance = app;
+        instance->instances = count;
+        instance->instance = n;
+        substitute_instance(instance->name, sizeof(instance->name), n);
+        substitute_instance(instance->cmd, sizeof(instance->cmd), n);
+        substitute_instance(instance->cpu_affinity, sizeof(instance->cpu_affinity), n);
+        substitute_instance(instance->listen, sizeof(instance->listen), n);
+        prepare_command(instance);
+    }
+
+    LOGD("%s expanded into %d instances", app.pool, count);
+    return count;
 }
 
 static int handler(void *user, const char *section, const char *name, const char *value)
@@ -191,10 +493,37 @@ static int handler(void *user, const char *section, const char *name, const char
 
     if(MATCH(_section, "nWdtApps"))
     {
-        app_count = atoi(value);
+        ini_count = atoi(value);
+
+        if(ini_count > MAX_APPS)
+        {
+            LOGE("nWdtApps %d is more than %d, rebuild with MAX_APPS", ini_count, MAX_APPS);
+            ini_count = MAX_APPS;
+        }
+    }
+
+    if(MATCH(_section, "trace_file"))
+    {
+        strncpy(trace_file, value, sizeof(trace_file) - 1);
+    }
+
+    if(MATCH(_section, "sample_interval"))
+    {
+        sample_interval = atoi(value);
+    }
+
+    if(MATCH(_section, "cgroup_root"))
+    {
+        strncpy(cgroup_root, value, sizeof(cgroup_root) - 1);
+    }
+
+    if(MATCH(_section, "state_file"))
+    {
+        strncpy(state_file, value, sizeof(state_file) - 1);
     }
 
-    if(app_count > 0)
+    // The entry is read into the next free application, expanded into its instances by the cmd
+    if(ini_index < ini_count && parsed_count < MAX_APPS)
     {
         SECTION(ini_index, "name");
 
@@ -208,208 +537,1171 @@ static int handler(void *user, const char *section, const char *name, const char
             }
 
             length = length > MAX_APP_NAME_LENGTH ? MAX_APP_NAME_LENGTH : length;
-            strncpy(apps[ini_index].name, value, length);
+            strncpy(parsed[parsed_count].name, value, length);
         }
 
         SECTION(ini_index, "start_delay");
 
         if(MATCH(_section, b))
         {
-            apps[ini_index].start_delay = atoi(value);
+            parsed[parsed_count].start_delay = atoi(value);
         }
 
         SECTION(ini_index, "heartbeat_delay");
 
         if(MATCH(_section, b))
         {
-            apps[ini_index].heartbeat_delay = atoi(value);
+            parsed[parsed_count].heartbeat_delay = atoi(value);
         }
 
         SECTION(ini_index, "heartbeat_interval");
 
         if(MATCH(_section, b))
         {
-            apps[ini_index].heartbeat_interval = atoi(value);
+            parsed[parsed_count].heartbeat_interval = atoi(value);
         }
 
-        SECTION(ini_index, "cmd"); // this always must be the last one
+        SECTION(ini_index, "heartbeat_max");
 
         if(MATCH(_section, b))
         {
-            int length = strlen(value);
+            parsed[parsed_count].heartbeat_max = atoi(value);
+        }
 
-            if(length > MAX_APP_CMD_LENGTH)
-            {
-                LOGE("CMD is longer than %d", MAX_APP_CMD_LENGTH);
-            }
+        SECTION(ini_index, "phi_threshold");
 
-            length = length > MAX_APP_CMD_LENGTH ? MAX_APP_CMD_LENGTH : length;
-            strncpy(apps[ini_index].cmd, value, length);
-            ini_index++; // order of the names in the ini are important
+        if(MATCH(_section, b))
+        {
+            parsed[parsed_count].phi_threshold = atof(value);
         }
-    }
-
-    return 1;
-}
 
-int read_ini_file()
-{
-    uptime = get_uptime();
-    LOGD("Reading ini file %s", ini_file);
-    memset(apps, 0, sizeof(apps));
-    app_count = 0;
-    ini_index = 0;
+        SECTION(ini_index, "restart_backoff");
 
-    if(ini_parse(ini_file, handler, NULL) < 0)
-    {
-        LOGE("Can't load %s", ini_file);
-        return 1;
-    }
+        if(MATCH(_section, b))
+        {
+            parsed[parsed_count].restart_backoff = atoi(value);
+        }
 
-    LOGD("%d processes have found in the ini file %s", app_count, ini_file);
-    ini_last_modified_time = file_modified_time(ini_file);
-    return 0;
-}
+        SECTION(ini_index, "restart_backoff_max");
 
-//------------------------------------------------------------------
+        if(MATCH(_section, b))
+        {
+            parsed[parsed_count].restart_backoff_max = atoi(value);
+        }
 
-bool is_application_running(int i)
-{
-    pid_t result = -1;
+        SECTION(ini_index, "restart_limit");
 
-    if(apps[i].pid > 0)
-    {
-        // Check if the application is running on Linux
-        if(kill(apps[i].pid, 0) == 0)
+        if(MATCH(_section, b))
         {
-            //LOGD("Process %s is running", apps[i].name);
-            /* process is running or a zombie */
-            result = 0;
+            int limit = atoi(value);
+
+            if(limit > MAX_RESTART_LIMIT)
+            {
+                LOGE("restart_limit is more than %d", MAX_RESTART_LIMIT);
+                limit = MAX_RESTART_LIMIT;
+            }
+
+            parsed[parsed_count].restart_limit = limit < 0 ? 0 : limit;
         }
-        else
+
+        SECTION(ini_index, "restart_window");
+
+        if(MATCH(_section, b))
         {
-            LOGD("Process %s is not running : %s", apps[i].name, strerror(errno));
+            parsed[parsed_count].restart_window = atoi(value);
         }
-    }
 
-    return (result == 0);
-}
-
-bool is_application_started(int i)
-{
-    return apps[i].started;
-}
+        SECTION(ini_index, "max_rss_mb");
 
-bool is_application_start_time(int i)
-{
-    return (get_uptime() - uptime) >= (long)apps[i].start_delay;
-}
+        if(MATCH(_section, b))
+        {
+            parsed[parsed_count].max_rss = atoi(value);
+        }
 
-void start_application(int i)
-{
-    apps[i].pid = 0;
-    // Start the application on Linux
-    pid_t pid = fork();
+        SECTION(ini_index, "max_cpu_pct");
 
-    if(pid < 0)
-    {
-        LOGE("Failed to start process %s, error code: %d - %s", apps[i].name, errno, strerror(errno));
-    }
-    else if(pid == 0)
-    {
-        /* Delete signal handlers */
-        signal(SIGINT, SIG_DFL); // restart
-        signal(SIGTERM, SIG_DFL); // terminate
-        signal(SIGQUIT, SIG_DFL); // reboot
-        signal(SIGUSR1, SIG_DFL); // terminate
-        signal(SIGUSR2, SIG_DFL); // rfu
-        LOGD("Starting the process %s with CMD : %s", apps[i].name, apps[i].cmd);
-        run_command(apps[i].cmd);
-        LOGE("Process %s stopped running", apps[i].name);
-        exit(EXIT_FAILURE); // exit child process
-    }
-    else
-    {
-        // Parent process
-        apps[i].started = true;
-        apps[i].first_heartbeat = false;
-        apps[i].pid = pid;
-        LOGI("Process %s started (PID %d): %s", apps[i].name, apps[i].pid, apps[i].cmd);
-        update_heartbeat_time(i);
-    }
-}
+        if(MATCH(_section, b))
+        {
+            parsed[parsed_count].max_cpu = atoi(value);
+        }
 
-void kill_application(int i)
-{
-    bool killed = false;
-    LOGD("Killing process %s", apps[i].name);
+        SECTION(ini_index, "max_cpu_duration");
 
-    // Send the SIGTERM signal to the application on Linux
-    if(kill(apps[i].pid, SIGTERM) < 0)
-    {
-        if(errno != ESRCH) // No such process
+        if(MATCH(_section, b))
         {
-            LOGE("Failed to terminate process %s, error: %d - %s", apps[i].name, errno, strerror(errno));
+            parsed[parsed_count].max_cpu_duration = atoi(value);
         }
-    }
-
-    // Wait for the process to terminate
-    int status;
-    LOGD("Waiting for the process %s", apps[i].name);
-    int max_wait = MAX_WAIT_PROCESS_TERMINATION; // [seconds]
 
-    do
-    {
-        sleep(1);
+        SECTION(ini_index, "cpu_max");
 
-        if(waitpid(apps[i].pid, &status, WUNTRACED | WCONTINUED) < 0)
+        if(MATCH(_section, b))
         {
-            if(errno != ECHILD)
-            {
-                LOGE("Failed to wait for process %s, error : %d - %s", apps[i].name, errno, strerror(errno));
-            }
+            strncpy(parsed[parsed_count].cpu_max, value, sizeof(parsed[parsed_count].cpu_max) - 1);
         }
 
-        if(WIFEXITED(status))
+        SECTION(ini_index, "memory_max");
+
+        if(MATCH(_section, b))
         {
-            LOGD("Process %s exited, status=%d", apps[i].name, WEXITSTATUS(status));
-            max_wait = 0;
+            strncpy(parsed[parsed_count].memory_max, value, sizeof(parsed[parsed_count].memory_max) - 1);
         }
-        else if(WIFSIGNALED(status))
+
+        SECTION(ini_index, "io_weight");
+
+        if(MATCH(_section, b))
         {
-            LOGD("Process %s killed by signal %d", apps[i].name, WTERMSIG(status));
-            max_wait = 0;
+            parsed[parsed_count].io_weight = atoi(value);
         }
-        else if(WIFSTOPPED(status))
+
+        SECTION(ini_index, "cpu_affinity");
+
+        if(MATCH(_section, b))
         {
-            LOGD("Process %s stopped by signal %d", apps[i].name, WSTOPSIG(status));
-            max_wait = 0;
+            strncpy(parsed[parsed_count].cpu_affinity, value, sizeof(parsed[parsed_count].cpu_affinity) - 1);
         }
-        else if(WIFCONTINUED(status))
+
+        SECTION(ini_index, "numa_nodes");
+
+        if(MATCH(_section, b))
         {
-            LOGD("Process %s continued", apps[i].name);
-            max_wait--;
+            strncpy(parsed[parsed_count].numa_nodes, value, sizeof(parsed[parsed_count].numa_nodes) - 1);
         }
-    }
-    while(0 < max_wait);
 
-    sleep(1);
+        SECTION(ini_index, "numa_policy");
 
-    // If the process hasn't terminated after receiving SIGTERM, send the SIGKILL signal
-    if(is_application_running(i))
-    {
-        LOGD("Sending SIGKILL to process %s", apps[i].name);
-
-        if(kill(apps[i].pid, SIGKILL) < 0)
+        if(MATCH(_section, b))
         {
-            if(errno != ESRCH) // No such process
-            {
-                LOGE("Failed to kill process %s, error : %d - %s", apps[i].name, errno, strerror(errno));
-            }
+            strncpy(parsed[parsed_count].numa_policy, value, sizeof(parsed[parsed_count].numa_policy) - 1);
         }
-        else
+
+        SECTION(ini_index, "nice");
+
+        if(MATCH(_section, b))
         {
-            LOGI("Process %s killed", apps[i].name);
+            parsed[parsed_count].nice = atoi(value);
+        }
+
+        SECTION(ini_index, "ionice");
+
+        if(MATCH(_section, b))
+        {
+            strncpy(parsed[parsed_count].ionice, value, sizeof(parsed[parsed_count].ionice) - 1);
+        }
+
+        SECTION(ini_index, "sched_policy");
+
+        if(MATCH(_section, b))
+        {
+            strncpy(parsed[parsed_count].sched_policy, value, sizeof(parsed[parsed_count].sched_policy) - 1);
+        }
+
+        SECTION(ini_index, "listen");
+
+        if(MATCH(_section, b))
+        {
+            strncpy(parsed[parsed_count].listen, value, sizeof(parsed[parsed_count].listen) - 1);
+        }
+
+        SECTION(ini_index, "activation");
+
+        if(MATCH(_section, b))
+        {
+            parsed[parsed_count].on_demand = (0 == strcmp(value, ACTIVATION_ON_DEMAND));
+
+            if(!parsed[parsed_count].on_demand && 0 != strcmp(value, ACTIVATION_ALWAYS))
+            {
+                LOGE("activation of %s is invalid : %s, %s is used", parsed[parsed_count].name, value, ACTIVATION_ALWAYS);
+            }
+        }
+
+        SECTION(ini_index, "idle_timeout");
+
+        if(MATCH(_section, b))
+        {
+            parsed[parsed_count].idle_timeout = atoi(value);
+        }
+
+        SECTION(ini_index, "readiness");
+
+        if(MATCH(_section, b))
+        {
+            parsed[parsed_count].ready_notify = (0 == strcmp(value, READINESS_NOTIFY));
+
+            if(!parsed[parsed_count].ready_notify && 0 != strcmp(value, READINESS_HEARTBEAT))
+            {
+                LOGE("readiness of %s is invalid : %s, %s is used", parsed[parsed_count].name, value, READINESS_HEARTBEAT);
+            }
+        }
+
+        SECTION(ini_index, "ready_timeout");
+
+        if(MATCH(_section, b))
+        {
+            parsed[parsed_count].ready_timeout = atoi(value);
+        }
+
+        SECTION(ini_index, "warm_spare");
+
+        if(MATCH(_section, b))
+        {
+            parsed[parsed_count].warm_spare = (0 != atoi(value));
+        }
+
+        SECTION(ini_index, "zygote");
+
+        if(MATCH(_section, b))
+        {
+            strncpy(parsed[parsed_count].zygote, value, sizeof(parsed[parsed_count].zygote) - 1);
+        }
+
+        SECTION(ini_index, "instances");
+
+        if(MATCH(_section, b))
+        {
+            parsed[parsed_count].instances = (0 == strcmp(value, INSTANCES_NCPU)) ? (int)sysconf(_SC_NPROCESSORS_ONLN) : atoi(value);
+
+            if(parsed[parsed_count].instances < 1)
+            {
+                LOGE("instances of %s is invalid : %s, one is started", parsed[parsed_count].name, value);
+                parsed[parsed_count].instances = 1;
+            }
+        }
+
+        SECTION(ini_index, "rollout_batch");
+
+        if(MATCH(_section, b))
+        {
+            parsed[parsed_count].rollout_batch = atoi(value);
+        }
+
+        SECTION(ini_index, "rollout_max_failures");
+
+        if(MATCH(_section, b))
+        {
+            parsed[parsed_count].rollout_max_failures = atoi(value);
+        }
+
+        SECTION(ini_index, "depends_on");
+
+        if(MATCH(_section, b))
+        {
+            strncpy(parsed[parsed_count].depends_on, value, MAX_APP_CMD_LENGTH - 1);
+        }
+
+        SECTION(ini_index, "cmd"); // this always must be the last one
+
+        if(MATCH(_section, b))
+        {
+            int length = strlen(value);
+
+            if(length > MAX_APP_CMD_LENGTH)
+            {
+                LOGE("CMD is longer than %d", MAX_APP_CMD_LENGTH);
+            }
+
+            length = length > MAX_APP_CMD_LENGTH ? MAX_APP_CMD_LENGTH : length;
+            strncpy(parsed[parsed_count].cmd, value, length);
+            parsed_count += expand_instances(parsed_count);
+            ini_index++; // order of the names in the ini are important
+        }
+    }
+
+    return 1;
+}
+
+static int find_app(const char *name)
+{
+    for(int i = 0; i < app_count; i++)
+    {
+        if(!apps[i].removed && 0 == strncmp(apps[i].name, name, MAX_APP_NAME_LENGTH))
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+// Returns the index of the first instance of the pool
+static int find_pool(const char *name)
+{
+    for(int i = 0; i < app_count; i++)
+    {
+        if(!apps[i].removed && 0 == strncmp(apps[i].pool, name, MAX_APP_NAME_LENGTH))
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+// Drops the dependencies closing a cycle, such apps fall back to the start delay only
+static void break_cycles(int i, char *state)
+{
+    state[i] = 1; // visiting
+
+    for(int n = 0; n < apps[i].depend_count; n++)
+    {
+        int d = apps[i].depends[n];
+
+        if(1 == state[d])
+        {
+            LOGE("Dependency cycle, %s depends on %s, the dependency is ignored", apps[i].name, apps[d].name);
+            apps[i].depends[n--] = apps[i].depends[--apps[i].depend_count];
+        }
+        else if(0 == state[d])
+        {
+            break_cycles(d, state);
+        }
+    }
+
+    state[i] = 2; // visited
+}
+
+// Resolves depends_on names into indexes, after all the apps are read
+static void resolve_dependencies(void)
+{
+    static char state[MAX_APPS];
+
+    for(int i = 0; i < app_count; i++)
+    {
+        char names[MAX_APP_CMD_LENGTH], *save = NULL;
+        strncpy(names, apps[i].depends_on, sizeof(names));
+        apps[i].depend_count = 0;
+
+        for(char *name = strtok_r(names, ", ", &save); NULL != name; name = strtok_r(NULL, ", ", &save))
+        {
+            int d = find_app(name);
+            bool pool = false;
+
+            // A pool is ready when all its instances are
+            if(d < 0 && 0 <= (d = find_pool(name)))
+            {
+                pool = true;
+            }
+
+            if(d < 0 || d == i)
+            {
+                LOGE("%s depends on unknown application %s, the dependency is ignored", apps[i].name, name);
+                continue;
+            }
+
+            for(; d < app_count; d++)
+            {
+                if(d == i || apps[d].removed || (pool && 0 != strncmp(apps[d].pool, name, MAX_APP_NAME_LENGTH)))
+                {
+                    continue;
+                }
+
+                if(apps[i].depend_count >= MAX_APP_DEPENDS)
+                {
+                    LOGE("%s depends on more than %d applications, %s is ignored", apps[i].name, MAX_APP_DEPENDS, apps[d].name);
+                    break;
+                }
+
+                apps[i].depends[apps[i].depend_count++] = d;
+
+                if(!pool)
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    memset(state, 0, sizeof(state));
+
+    for(int i = 0; i < app_count; i++)
+    {
+        if(0 == state[i])
+        {
+            break_cycles(i, state);
+        }
+    }
+}
+
+// Reads the applications of the ini file into the table, the settings of the watchdog are read as well
+static int parse_ini_file(Application_t *table)
+{
+    parsed = table;
+    parsed_count = 0;
+    ini_count = 0;
+    ini_index = 0;
+
+    for(int i = 0; i < MAX_APPS; i++)
+    {
+        table[i].restart_backoff = RESTART_BACKOFF;
+        table[i].restart_backoff_max = RESTART_BACKOFF_MAX;
+        table[i].restart_limit = RESTART_LIMIT;
+        table[i].restart_window = RESTART_WINDOW;
+        table[i].max_cpu_duration = MAX_CPU_DURATION;
+        table[i].ready_timeout = READY_TIMEOUT;
+        table[i].nice = NICE_INHERIT;
+        table[i].rollout_batch = ROLLOUT_BATCH;
+        table[i].rollout_max_failures = ROLLOUT_MAX_FAILURES;
+    }
+
+    int ret = ini_parse(ini_file, handler, NULL);
+    parsed = apps;
+
+    if(ret < 0)
+    {
+        LOGE("Can't load %s", ini_file);
+        return 1;
+    }
+
+    return 0;
+}
+
+int read_ini_file()
+{
+    uptime = clock_uptime();
+    LOGD("Reading ini file %s", ini_file);
+    memset(apps, 0, sizeof(apps));
+    memset(trace_file, 0, sizeof(trace_file));
+    sample_interval = SAMPLE_INTERVAL;
+    memset(cgroup_root, 0, sizeof(cgroup_root));
+    memset(state_file, 0, sizeof(state_file));
+    app_count = 0;
+
+    if(parse_ini_file(apps))
+    {
+        return 1;
+    }
+
+    app_count = parsed_count;
+    resolve_dependencies();
+    LOGD("%d processes have found in the ini file %s", app_count, ini_file);
+    file_modified_time(ini_file, &ini_last_modified_time);
+    return 0;
+}
+
+// Copies the fields not in the ini file, a field added there has to be added here too
+static void copy_runtime(Application_t *to, const Application_t *from)
+{
+    to->started = from->started;
+    to->spawning = from->spawning;
+    to->first_heartbeat = from->first_heartbeat;
+    to->pid = from->pid;
+    to->pgid = from->pgid;
+    to->last_heartbeat = from->last_heartbeat;
+    to->last_heartbeat_ms = from->last_heartbeat_ms;
+    to->next_heartbeat_ms = from->next_heartbeat_ms;
+    to->last_alive_ms = from->last_alive_ms;
+    to->started_ms = from->started_ms;
+    to->restart_at = from->restart_at;
+    to->stop_at = from->stop_at;
+    to->stop_then = from->stop_then;
+    memcpy(to->restarts, from->restarts, sizeof(to->restarts));
+    to->restart_head = from->restart_head;
+    to->backoff_level = from->backoff_level;
+    to->crash_loop = from->crash_loop;
+    to->removed = from->removed;
+    to->adopted = from->adopted;
+    to->forked = from->forked;
+    to->pidfd = from->pidfd;
+    to->start_time = from->start_time;
+    to->active_ms = from->active_ms;
+    to->spare_pid = from->spare_pid;
+    to->spare_pgid = from->spare_pgid;
+    to->spare_ready = from->spare_ready;
+    to->spare_spawning = from->spare_spawning;
+    to->spare_forked = from->spare_forked;
+    to->spare_started_ms = from->spare_started_ms;
+}
+
+// Installs the definition read from the ini file, the runtime state of the application is kept
+static void update_application(int i, const Application_t *app)
+{
+    Application_t state = apps[i];
+    apps[i] = *app;
+    copy_runtime(&apps[i], &state);
+
+    // The arguments point into the command tokenised in the table read
+    for(int n = 0; NULL != app->argv[n]; n++)
+    {
+        apps[i].argv[n] = apps[i].args + (app->argv[n] - app->args);
+    }
+}
+
+static int find_in(const Application_t *table, int count, const char *name)
+{
+    for(int k = 0; k < count; k++)
+    {
+        if(0 == strncmp(table[k].name, name, MAX_APP_NAME_LENGTH))
+        {
+            return k;
+        }
+    }
+
+    return -1;
+}
+
+// Saves the statistics of a removed application and frees its cgroup, its processes have exited
+static void finish_removal(int i)
+{
+    stats_write_to_file(i);
+    stats_print_to_file(i);
+    cgroup_remove(i);
+    apps[i].started = false;
+    apps[i].restart_at = 0;
+}
+
+// Stops an application removed from the ini file, its slot is freed once its processes have exited
+static void remove_application(int i)
+{
+    LOGN("Process %s is removed from the ini file, stopping", apps[i].name);
+    stop_spare(i);
+    apps[i].removed = true;
+    changes[i] = APP_REMOVED;
+
+    if(is_application_started(i))
+    {
+        stop_application(i, STOP_REMOVE);
+    }
+
+    zygote_kill(i);
+
+    if(!is_application_stopping(i))
+    {
+        finish_removal(i);
+    }
+}
+
+// Takes the slot of a removed application or a new one, -1 if there is none
+static int allocate_application(void)
+{
+    for(int i = 0; i < app_count; i++)
+    {
+        if(apps[i].removed && !is_application_stopping(i))
+        {
+            return i;
+        }
+    }
+
+    return (app_count < MAX_APPS) ? app_count++ : -1;
+}
+
+int reload_ini_file(void)
+{
+    Application_t *table = calloc(MAX_APPS, sizeof(Application_t));
+    static char used[MAX_APPS];
+    int port = udp_port;
+    char trace[sizeof(trace_file)];
+    char root[sizeof(cgroup_root)];
+    char state[sizeof(state_file)];
+
+    if(NULL == table)
+    {
+        LOGE("Not enough memory to reload the ini file %s", ini_file);
+        return 1;
+    }
+
+    LOGN("Reloading ini file %s", ini_file);
+    memcpy(trace, trace_file, sizeof(trace));
+    memcpy(root, cgroup_root, sizeof(root));
+    memcpy(state, state_file, sizeof(state));
+    memset(trace_file, 0, sizeof(trace_file));
+    sample_interval = SAMPLE_INTERVAL;
+    memset(cgroup_root, 0, sizeof(cgroup_root));
+    memset(state_file, 0, sizeof(state_file));
+    int ret = parse_ini_file(table);
+
+    // The settings of the watchdog other than sample_interval need a restart
+    if(ret || port != udp_port || 0 != strcmp(trace, trace_file) || 0 != strcmp(root, cgroup_root))
+    {
+        if(!ret)
+        {
+            LOGW("udp_port, trace_file and cgroup_root changes need a restart of the watchdog");
+        }
+
+        udp_port = port;
+        memcpy(trace_file, trace, sizeof(trace_file));
+        memcpy(cgroup_root, root, sizeof(cgroup_root));
+    }
+
+    if(ret)
+    {
+        memcpy(state_file, state, sizeof(state_file));
+        file_modified_time(ini_file, &ini_last_modified_time); // not retried until it changes again
+        free(table);
+        return 1;
+    }
+
+    int count = parsed_count;
+    memset(changes, 0, sizeof(changes));
+    memset(used, 0, sizeof(used));
+
+    // The applications are matched by name, their slots and state are kept
+    for(int i = 0; i < app_count; i++)
+    {
+        if(apps[i].removed)
+        {
+            continue;
+        }
+
+        int k = find_in(table, count, apps[i].name);
+
+        if(k < 0)
+        {
+            remove_application(i);
+            continue;
+        }
+
+        used[k] = 1;
+
+        if(0 != strcmp(apps[i].cmd, table[k].cmd) || 0 != strcmp(apps[i].listen, table[k].listen))
+        {
+            LOGN("Command or sockets of %s have changed, restarting", apps[i].name);
+
+            // Started with the new command by the next scan once the old process has exited
+            if(is_application_started(i))
+            {
+                stop_application(i, STOP_RESPAWN);
+            }
+
+            apps[i].restart_at = 0;
+            apps[i].backoff_level = 0;
+            apps[i].crash_loop = false;
+            changes[i] = APP_RESTARTED;
+        }
+        else if(0 != strcmp(apps[i].cpu_max, table[k].cpu_max) || 0 != strcmp(apps[i].memory_max, table[k].memory_max) ||
+                apps[i].io_weight != table[k].io_weight)
+        {
+            changes[i] = APP_LIMITS_CHANGED;
+        }
+
+        update_application(i, &table[k]);
+    }
+
+    for(int k = 0; k < count; k++)
+    {
+        int i;
+
+        if(used[k])
+        {
+            continue;
+        }
+
+        if(0 > (i = allocate_application()))
+        {
+            LOGE("%s cannot be added, all %d applications are in use, rebuild with MAX_APPS", table[k].name, MAX_APPS);
+            continue;
+        }
+
+        LOGN("Process %s is added to the ini file", table[k].name);
+        memset(&apps[i], 0, sizeof(apps[i]));
+        update_application(i, &table[k]);
+        changes[i] = APP_ADDED;
+    }
+
+    free(table);
+    resolve_dependencies();
+    file_modified_time(ini_file, &ini_last_modified_time);
+    return 0;
+}
+
+AppChange_t get_app_change(int i)
+{
+    return changes[i];
+}
+
+bool is_application_removed(int i)
+{
+    return apps[i].removed;
+}
+
+//------------------------------------------------------------------
+
+// Checks that an adopted or forked process has not exited, its PID may be reused by another process afterwards
+static bool is_tracked_alive(int i)
+{
+    if(0 <= apps[i].pidfd)
+    {
+        struct pollfd pfd = { apps[i].pidfd, POLLIN, 0 };
+        return 0 == poll(&pfd, 1, 0); // the pidfd becomes readable when the process exits
+    }
+
+    return 0 != apps[i].start_time && apps[i].start_time == process_start_time(apps[i].pid);
+}
+
+static void release_tracking(int i)
+{
+    if((apps[i].adopted || apps[i].forked) && 0 <= apps[i].pidfd)
+    {
+        close(apps[i].pidfd);
+    }
+
+    apps[i].adopted = false;
+    apps[i].forked = false;
+    apps[i].pidfd = -1;
+}
+
+// A process forked by the zygote is not a child of the watchdog, its exit is watched through a pidfd
+static void track_forked(int i, int pid)
+{
+    release_tracking(i);
+    apps[i].forked = true;
+#ifdef SYS_pidfd_open
+    apps[i].pidfd = syscall(SYS_pidfd_open, pid, 0); // fails with ESRCH if it has already exited
+#endif
+    apps[i].start_time = (0 <= apps[i].pidfd || ESRCH != errno) ? process_start_time(pid) : 0;
+}
+
+int adopt_application(int i, int pid, int pgid, unsigned long long start_time, bool first_heartbeat, uint64_t heartbeat_age,
+                      int backoff_level)
+{
+    int pidfd = -1;
+    clk_t now = clock_ms();
+
+    if(0 >= pid)
+    {
+        return 1;
+    }
+
+#ifdef SYS_pidfd_open
+    pidfd = syscall(SYS_pidfd_open, pid, 0);
+
+    if(0 > pidfd && ENOSYS != errno && EINVAL != errno)
+    {
+        LOGW("Process %s (PID %d) is not running anymore, starting it again", apps[i].name, pid);
+        return 1;
+    }
+
+#endif
+
+    // Read after the pidfd is opened, so a matching start time proves the pidfd refers to the saved process
+    if(0 == start_time || start_time != process_start_time(pid))
+    {
+        LOGW("Process %s (PID %d) is not running anymore, starting it again", apps[i].name, pid);
+
+        if(0 <= pidfd)
+        {
+            close(pidfd);
+        }
+
+        return 1;
+    }
+
+    release_tracking(i);
+    apps[i].adopted = true;
+    apps[i].pidfd = pidfd;
+    apps[i].start_time = start_time;
+    apps[i].started = true;
+    apps[i].first_heartbeat = first_heartbeat;
+    apps[i].pid = pid;
+    apps[i].pgid = pgid;
+    apps[i].last_alive_ms = now;
+    apps[i].started_ms = now;
+    apps[i].restart_at = 0;
+    apps[i].backoff_level = backoff_level;
+    heartbeat_age = (heartbeat_age < now) ? heartbeat_age : now;
+    apps[i].last_heartbeat_ms = now - heartbeat_age;
+    apps[i].last_heartbeat = clock_time() - (time_t)(heartbeat_age / 1000);
+    apps[i].next_heartbeat_ms = 0;
+    apps[i].active_ms = now;
+    trace_app_phase(i, first_heartbeat ? TRACE_PHASE_RUNNING : TRACE_PHASE_STARTING);
+    LOGN("Process %s (PID %d) is adopted from the previous watchdog", apps[i].name, pid);
+    return 0;
+}
+
+bool is_application_running(int i)
+{
+    pid_t result = -1;
+
+    if(apps[i].spawning)
+    {
+        return true; // the zygote replies within ZYGOTE_TIMEOUT
+    }
+
+    if(apps[i].pid > 0)
+    {
+        // Check if the application is running on Linux
+        if(process->kill(apps[i].pid, 0) == 0 && ((!apps[i].adopted && !apps[i].forked) || is_tracked_alive(i)))
+        {
+            //LOGD("Process %s is running", apps[i].name);
+            /* process is running or a zombie */
+            result = 0;
+            apps[i].last_alive_ms = clock_ms();
+        }
+        else
+        {
+            LOGD("Process %s is not running : %s", apps[i].name, strerror(errno));
+        }
+    }
+
+    return (result == 0);
+}
+
+bool is_application_started(int i)
+{
+    return apps[i].started;
+}
+
+bool is_application_ready(int i)
+{
+    return apps[i].started && apps[i].first_heartbeat;
+}
+
+bool is_application_start_time(int i)
+{
+    if((clock_uptime() - uptime) < (long)apps[i].start_delay)
+    {
+        return false;
+    }
+
+    for(int n = 0; n < apps[i].depend_count; n++)
+    {
+        if(!is_application_ready(apps[i].depends[n]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static int os_spawn(int i)
+{
+    // Start the application on Linux, posix_spawn does not copy the address space of the watchdog
+    // and the files of the watchdog are opened close-on-exec, so only stdin, stdout and stderr are inherited
+    pid_t pid = -1;
+    posix_spawnattr_t attr;
+    sigset_t signals;
+
+    if(NULL == apps[i].argv[0])
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    LOGD("Starting the process %s with CMD : %s", apps[i].name, apps[i].cmd);
+
+    // A zygote forks the process from its preloaded runtime, until it is ready the process is spawned directly
+    if(0 < strlen(apps[i].zygote) && 0 == zygote_spawn(i, apps[i].argv, spawning_spare))
+    {
+        return 0; // the PID arrives with the reply of the zygote
+    }
+
+    // The process inherits the CPU affinity and the NUMA memory policy set for the spawn
+    placement_begin(i);
+
+    bool into_cgroup = cgroup_enabled(i) && !spawning_spare;
+
+    // posix_spawn can neither set LISTEN_PID to the PID of the new process nor move it into its cgroup before its exec
+    if(into_cgroup || 0 < activation_count(i))
+    {
+        pid = cgroup_spawn(i, apps[i].exe, apps[i].argv, into_cgroup);
+        placement_end(i, pid);
+        apps[i].pgid = pid;
+        return pid;
+    }
+
+    posix_spawnattr_init(&attr);
+    sigemptyset(&signals);
+    posix_spawnattr_setsigmask(&attr, &signals);
+    /* Reset the signals handled or ignored by the watchdog */
+    sigaddset(&signals, SIGINT); // restart
+    sigaddset(&signals, SIGTERM); // terminate
+    sigaddset(&signals, SIGQUIT); // reboot
+    sigaddset(&signals, SIGUSR1); // terminate
+    sigaddset(&signals, SIGUSR2); // rfu
+    sigaddset(&signals, SIGCHLD); // ignored, the children are reaped automatically
+    sigaddset(&signals, SIGPIPE); // ignored
+    posix_spawnattr_setsigdefault(&attr, &signals);
+    // Lead a process group, so the processes it forks can be signalled together
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETPGROUP);
+    int ret = posix_spawn(&pid, apps[i].exe, NULL, &attr, apps[i].argv, environ);
+    posix_spawnattr_destroy(&attr);
+    placement_end(i, (0 == ret) ? pid : -1);
+
+    if(0 != ret)
+    {
+        errno = ret;
+        return -1;
+    }
+
+    apps[i].pgid = pid;
+    return pid;
+}
+
+static int os_wait(int pid, int *status, int options)
+{
+    int i = find_pid(pid);
+
+    // An adopted process or one forked by the zygote is not a child of the watchdog, it cannot be waited for
+    if(0 <= i && (apps[i].adopted || apps[i].forked))
+    {
+        *status = 0;
+        return is_tracked_alive(i) ? 0 : pid;
+    }
+
+    return waitpid(pid, status, options);
+}
+
+void set_process_ops(const ProcessOps_t *ops)
+{
+    process = (NULL != ops) ? ops : &os_process_ops;
+}
+
+// Sends the signal to the process group of the application, to its process if it has no group
+static int signal_application(int i, int sig)
+{
+    if(0 >= apps[i].pid)
+    {
+        errno = ESRCH; // kill(0) would signal the process group of the watchdog
+        return -1;
+    }
+
+    if(0 < apps[i].pgid && 0 == process->kill(-apps[i].pgid, sig))
+    {
+        return 0;
+    }
+
+    return process->kill(apps[i].pid, sig);
+}
+
+// Fills pids with the running processes of the application, its cgroup or process group
+static int find_members(int i, int *pids, int max)
+{
+    if(cgroup_enabled(i))
+    {
+        return cgroup_procs(i, pids, max);
+    }
+
+    if(0 < apps[i].pgid)
+    {
+        return find_process_group(apps[i].pgid, pids, max);
+    }
+
+    return 0;
+}
+
+// Reports and kills the processes left by the application after its main process has ended
+static void kill_leftovers(int i)
+{
+    int pids[MAX_LEFTOVERS];
+    char list[MAX_APP_CMD_LENGTH] = "";
+    int count = find_members(i, pids, MAX_LEFTOVERS);
+
+    if(0 < count)
+    {
+        for(int n = 0, length = 0; n < count && length < (int)sizeof(list); n++)
+        {
+            char name[32];
+            length += snprintf(&list[length], sizeof(list) - length, "%s%d (%s)", n ? ", " : "", pids[n],
+                               process_name(pids[n], name, sizeof(name)));
+        }
+
+        LOGW("Process %s left %d%s processes running, killing them : %s", apps[i].name, count,
+             MAX_LEFTOVERS == count ? " or more" : "", list);
+        stats_leftover_processes(i, count);
+
+        if(cgroup_enabled(i))
+        {
+            cgroup_kill(i);
+        }
+        else
+        {
+            process->kill(-apps[i].pgid, SIGKILL);
+        }
+    }
+
+    apps[i].pgid = 0;
+}
+
+// Sends SIGKILL to all processes of the application without waiting for them
+static void kill_at_once(int i)
+{
+    LOGD("Sending SIGKILL to process %s", apps[i].name);
+
+    if(cgroup_enabled(i))
+    {
+        cgroup_kill(i);
+    }
+    else if(signal_application(i, SIGKILL) < 0 && errno != ESRCH)
+    {
+        LOGE("Failed to kill process %s, error : %d - %s", apps[i].name, errno, strerror(errno));
+    }
+}
+
+void start_application(int i)
+{
+    release_tracking(i);
+    apps[i].pid = 0;
+    apps[i].pgid = 0;
+    pid_t pid = process->spawn(i);
+
+    if(pid < 0)
+    {
+        LOGE("Failed to start process %s, error code: %d - %s", apps[i].name, errno, strerror(errno));
+    }
+    else
+    {
+        // Parent process
+        apps[i].started = true;
+        apps[i].spawning = (0 == pid);
+        apps[i].first_heartbeat = false;
+        apps[i].pid = pid;
+        apps[i].last_alive_ms = clock_ms();
+        apps[i].started_ms = apps[i].last_alive_ms;
+        apps[i].active_ms = apps[i].last_alive_ms;
+        apps[i].restart_at = 0;
+        apps[i].stop_at = 0;
+
+        if(apps[i].spawning)
+        {
+            LOGD("Process %s is being forked by its zygote", apps[i].name);
+        }
+        else
+        {
+            LOGI("Process %s started (PID %d): %s", apps[i].name, apps[i].pid, apps[i].cmd);
+        }
+
+        update_heartbeat_time(i);
+        stats_respawned_at(i);
+        trace_app_phase(i, TRACE_PHASE_STARTING);
+    }
+}
+
+void set_forked_pid(int i, int pid, bool spare)
+{
+    if(spare)
+    {
+        apps[i].spare_spawning = false;
+
+        if(0 >= pid)
+        {
+            LOGE("Failed to start the spare of %s, error code: %d - %s", apps[i].name, errno, strerror(errno));
+            return;
+        }
+
+        apps[i].spare_pid = pid;
+        apps[i].spare_pgid = pid; // the zygote makes it lead its own process group
+        apps[i].spare_forked = true;
+        placement_end(i, pid);
+        LOGI("Spare of %s started (PID %d)", apps[i].name, pid);
+        return;
+    }
+
+    apps[i].spawning = false;
+
+    if(0 >= pid)
+    {
+        // Found not running by the next scan and restarted
+        LOGE("Failed to start process %s, error code: %d - %s", apps[i].name, errno, strerror(errno));
+        return;
+    }
+
+    apps[i].pid = pid;
+    apps[i].pgid = pid;
+    track_forked(i, pid);
+    placement_end(i, pid);
+
+    if(cgroup_enabled(i))
+    {
+        cgroup_attach(i, pid);
+    }
+
+    LOGI("Process %s started (PID %d): %s", apps[i].name, apps[i].pid, apps[i].cmd);
+}
+
+void kill_application(int i)
+{
+    bool killed = false;
+    clk_t deadline = clock_ms() + MAX_WAIT_PROCESS_TERMINATION * 1000;
+    LOGD("Killing process %s", apps[i].name);
+    stop_spare(i); // a new one is started for the next process
+    trace_app_phase(i, TRACE_PHASE_STOPPING);
+
+    // The PID of a process being forked is known once the zygote replies
+    if(apps[i].spawning)
+    {
+        zygote_wait(i);
+    }
+
+    // Send the SIGTERM signal to the application and the processes it forked
+    if(signal_application(i, SIGTERM) < 0)
+    {
+        if(errno != ESRCH) // No such process
+        {
+            LOGE("Failed to terminate process %s, error: %d - %s", apps[i].name, errno, strerror(errno));
+        }
+    }
+
+    // Wait for the process to terminate
+    int status = 0;
+    LOGD("Waiting for the process %s", apps[i].name);
+    int max_wait = (0 < apps[i].pid) ? MAX_WAIT_PROCESS_TERMINATION * 10 : 0; // [100 ms]
+
+    while(0 < max_wait)
+    {
+        clock_sleep_ms(100);
+
+        int ret = process->wait(apps[i].pid, &status, WNOHANG | WUNTRACED | WCONTINUED);
+
+        if(ret < 0)
+        {
+            if(errno != ECHILD)
+            {
+                LOGE("Failed to wait for process %s, error : %d - %s", apps[i].name, errno, strerror(errno));
+            }
+        }
+        else if(ret == 0) // still running, e.g. SIGTERM is ignored
+        {
+            max_wait--;
+            continue;
+        }
+
+        if(WIFEXITED(status))
+        {
+            LOGD("Process %s exited, status=%d", apps[i].name, WEXITSTATUS(status));
+            max_wait = 0;
+        }
+        else if(WIFSIGNALED(status))
+        {
+            LOGD("Process %s killed by signal %d", apps[i].name, WTERMSIG(status));
+            max_wait = 0;
+        }
+        else if(WIFSTOPPED(status))
+        {
+            LOGD("Process %s stopped by signal %d", apps[i].name, WSTOPSIG(status));
+            max_wait = 0;
+        }
+        else if(WIFCONTINUED(status))
+        {
+            LOGD("Process %s continued", apps[i].name);
+            max_wait--;
+        }
+    }
+
+    // If the process hasn't terminated after receiving SIGTERM, send the SIGKILL signal
+    if(is_application_running(i))
+    {
+        LOGD("Sending SIGKILL to process %s", apps[i].name);
+
+        if(cgroup_enabled(i))
+        {
+            cgroup_kill(i);
+            LOGI("Process %s killed", apps[i].name);
+
+            if(!is_application_running(i))
+            {
+                killed = true;
+            }
+        }
+        else if(signal_application(i, SIGKILL) < 0)
+        {
+            if(errno != ESRCH) // No such process
+            {
+                LOGE("Failed to kill process %s, error : %d - %s", apps[i].name, errno, strerror(errno));
+            }
+        }
+        else
+        {
+            LOGI("Process %s killed", apps[i].name);
 
             if(!is_application_running(i))
             {
@@ -419,16 +1711,321 @@ void kill_application(int i)
     }
     else
     {
-        LOGI("Process %s terminated", apps[i].name);
-        killed = true;
+        LOGI("Process %s terminated", apps[i].name);
+        int member;
+
+        // The processes it forked got SIGTERM as well, wait for them within the same time limit
+        while(clock_ms() < deadline && 0 < find_members(i, &member, 1))
+        {
+            clock_sleep_ms(100);
+        }
+
+        killed = true;
+    }
+
+    if(killed)
+    {
+        kill_leftovers(i);
+        release_tracking(i);
+        apps[i].started = false;
+        apps[i].first_heartbeat = false;
+        apps[i].pid = 0;
+        apps[i].stop_at = 0;
+        trace_app_phase(i, TRACE_PHASE_NONE);
+    }
+}
+
+void stop_application(int i, StopAction_t then)
+{
+    // A removal is not turned into a restart by a later request
+    if(0 == apps[i].stop_at || STOP_REMOVE != apps[i].stop_then)
+    {
+        apps[i].stop_then = then;
+    }
+
+    if(0 < apps[i].stop_at)
+    {
+        return;
+    }
+
+    LOGD("Stopping process %s", apps[i].name);
+    stop_spare(i); // a new one is started for the next process
+    trace_app_phase(i, TRACE_PHASE_STOPPING);
+
+    // The PID of a process being forked is known once the zygote replies
+    if(apps[i].spawning)
+    {
+        zygote_wait(i);
+    }
+
+    // Send the SIGTERM signal to the application and the processes it forked
+    if(signal_application(i, SIGTERM) < 0 && errno != ESRCH)
+    {
+        LOGE("Failed to terminate process %s, error: %d - %s", apps[i].name, errno, strerror(errno));
+    }
+
+    apps[i].stop_at = clock_ms();
+}
+
+bool is_application_stopping(int i)
+{
+    return 0 < apps[i].stop_at;
+}
+
+bool update_stop(int i)
+{
+    int member;
+    bool expired = (clock_ms() - apps[i].stop_at >= (clk_t)MAX_WAIT_PROCESS_TERMINATION * 1000);
+
+    if(is_application_running(i))
+    {
+        if(!expired)
+        {
+            return false;
+        }
+
+        // Not terminated by SIGTERM, killed and checked again by the next scan
+        kill_at_once(i);
+
+        if(is_application_running(i))
+        {
+            return false;
+        }
+    }
+    else if(!expired && 0 < find_members(i, &member, 1))
+    {
+        return false; // the processes it forked got SIGTERM as well, they get the same time limit
+    }
+
+    LOGI("Process %s terminated", apps[i].name);
+    apps[i].stop_at = 0;
+
+    if(STOP_RESTART == apps[i].stop_then)
+    {
+        schedule_restart(i); // the remaining processes are killed there
+        return true;
+    }
+
+    kill_leftovers(i);
+    release_tracking(i);
+    apps[i].started = false;
+    apps[i].first_heartbeat = false;
+    apps[i].pid = 0;
+    apps[i].restart_at = 0;
+    trace_app_phase(i, TRACE_PHASE_NONE);
+
+    if(STOP_RESPAWN == apps[i].stop_then && 0 == activation_count(i))
+    {
+        activation_open(i); // closed by a reload changing them, the old process has released them
+    }
+    else if(STOP_REMOVE == apps[i].stop_then)
+    {
+        finish_removal(i);
+    }
+
+    return true;
+}
+
+// Sends the signal to the process group of the warm spare, to its process if it has no group
+static int signal_spare(int i, int sig)
+{
+    if(0 < apps[i].spare_pgid && 0 == process->kill(-apps[i].spare_pgid, sig))
+    {
+        return 0;
+    }
+
+    return process->kill(apps[i].spare_pid, sig);
+}
+
+void start_spare(int i)
+{
+    int pgid = apps[i].pgid;
+
+    if(0 < apps[i].spare_pid || apps[i].spare_spawning)
+    {
+        return;
+    }
+
+    spawning_spare = true;
+    pid_t pid = process->spawn(i);
+    spawning_spare = false;
+    apps[i].spare_pgid = (0 <= pid && apps[i].pgid != pgid) ? apps[i].pgid : 0;
+    apps[i].pgid = pgid;
+    apps[i].spare_started_ms = clock_ms();
+    apps[i].spare_ready = false;
+
+    if(pid < 0)
+    {
+        LOGE("Failed to start the spare of %s, error code: %d - %s", apps[i].name, errno, strerror(errno));
+        return;
+    }
+
+    if(0 == pid)
+    {
+        apps[i].spare_spawning = true;
+        LOGD("Spare of %s is being forked by its zygote", apps[i].name);
+        return;
+    }
+
+    apps[i].spare_pid = pid;
+    apps[i].spare_forked = false;
+    LOGI("Spare of %s started (PID %d)", apps[i].name, pid);
+}
+
+void stop_spare(int i)
+{
+    if(apps[i].spare_spawning)
+    {
+        zygote_wait(i);
+    }
+
+    if(0 >= apps[i].spare_pid)
+    {
+        return;
+    }
+
+    // SIGKILL ends a paused process without continuing it first, the children are reaped automatically
+    if(0 > signal_spare(i, SIGKILL) && ESRCH != errno)
+    {
+        LOGE("Failed to kill the spare of %s, error : %d - %s", apps[i].name, errno, strerror(errno));
+    }
+
+    LOGD("Spare of %s (PID %d) stopped", apps[i].name, apps[i].spare_pid);
+    apps[i].spare_pid = 0;
+    apps[i].spare_pgid = 0;
+    apps[i].spare_ready = false;
+}
+
+int find_spare(int pid)
+{
+    for(int i = 0; i < app_count; i++)
+    {
+        if(0 < apps[i].spare_pid && pid == apps[i].spare_pid)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void set_spare_ready(int i)
+{
+    if(apps[i].spare_ready)
+    {
+        return; // heartbeats sent before the pause took effect
+    }
+
+    if(0 > signal_spare(i, SIGSTOP))
+    {
+        LOGE("Failed to pause the spare of %s, error : %d - %s", apps[i].name, errno, strerror(errno));
+        stop_spare(i);
+        return;
+    }
+
+    apps[i].spare_ready = true;
+    LOGN("Spare of %s (PID %d) is ready after %llu ms, paused", apps[i].name, apps[i].spare_pid,
+         (unsigned long long)(clock_ms() - apps[i].spare_started_ms));
+}
+
+bool is_spare_ready(int i)
+{
+    return apps[i].spare_ready;
+}
+
+void update_spare(int i)
+{
+    clk_t now = clock_ms();
+
+    if(0 < apps[i].spare_pid)
+    {
+        if(!apps[i].warm_spare || !apps[i].started)
+        {
+            stop_spare(i);
+        }
+        else if(0 != process->kill(apps[i].spare_pid, 0))
+        {
+            LOGW("Spare of %s (PID %d) has exited", apps[i].name, apps[i].spare_pid);
+            apps[i].spare_pid = 0;
+            apps[i].spare_pgid = 0;
+            apps[i].spare_ready = false;
+        }
+        else if(!apps[i].spare_ready && now - apps[i].spare_started_ms >= (clk_t)apps[i].heartbeat_delay * 1000)
+        {
+            LOGW("Spare of %s has not sent a heartbeat in time, replacing it", apps[i].name);
+            stop_spare(i);
+        }
+    }
+
+    // Built once the application is ready so both do not initialise at once, failed spares are retried every heartbeat_delay
+    if(apps[i].warm_spare && 0 == apps[i].spare_pid && !apps[i].spare_spawning && is_application_ready(i) && !is_restart_pending(i) &&
+            (0 == apps[i].spare_started_ms || now - apps[i].spare_started_ms >= (clk_t)apps[i].heartbeat_delay * 1000))
+    {
+        start_spare(i);
+    }
+}
+
+bool promote_spare(int i)
+{
+    int pids[MAX_LEFTOVERS];
+    int pid = apps[i].spare_pid;
+    int pgid = apps[i].spare_pgid;
+    bool forked = apps[i].spare_forked;
+    clk_t now = clock_ms();
+
+    if(!apps[i].spare_ready || 0 != signal_spare(i, SIGCONT))
+    {
+        return false;
+    }
+
+    // The spare serves at once, the failed process is stopped afterwards
+    apps[i].spare_pid = 0;
+    apps[i].spare_pgid = 0;
+    apps[i].spare_ready = false;
+    apps[i].spare_started_ms = 0; // the next spare is started at once
+
+    // The failed process is killed without waiting, its exit is not watched anymore
+    if(is_application_running(i))
+    {
+        kill_at_once(i);
+        apps[i].pgid = 0;
+    }
+    else
+    {
+        kill_leftovers(i);
     }
 
-    if(killed)
+    // The spare and the processes it forked join the cgroup of the application
+    if(cgroup_enabled(i) && 0 < pgid)
     {
-        apps[i].started = false;
-        apps[i].first_heartbeat = false;
-        apps[i].pid = 0;
+        for(int n = 0, count = find_process_group(pgid, pids, MAX_LEFTOVERS); n < count; n++)
+        {
+            cgroup_attach(i, pids[n]);
+        }
+    }
+
+    if(forked)
+    {
+        track_forked(i, pid);
     }
+    else
+    {
+        release_tracking(i);
+    }
+
+    apps[i].started = true;
+    apps[i].first_heartbeat = true;
+    apps[i].pid = pid;
+    apps[i].pgid = pgid;
+    apps[i].last_alive_ms = now;
+    apps[i].started_ms = now;
+    apps[i].active_ms = now;
+    apps[i].restart_at = 0;
+    update_heartbeat_time(i);
+    trace_app_phase(i, TRACE_PHASE_RUNNING);
+    stats_promoted_at(i);
+    LOGN("Spare of %s (PID %d) is promoted", apps[i].name, pid);
+    return true;
 }
 
 void restart_application(int i)
@@ -436,16 +2033,15 @@ void restart_application(int i)
     // Log that the application is being restarted
     LOGD("Restarting process %s", apps[i].name);
 
-    // Kill the existing instance of the application
+    // The existing instance is started again by the application scan once it has exited
     if(is_application_running(i))
     {
-        kill_application(i);
+        stop_application(i, STOP_RESPAWN);
+        return;
     }
 
     // Start a new instance of the application
     start_application(i);
-    // Wait for the new instance of the application to start
-    sleep(2);
 
     // Check if the new instance of the application is running
     if(!is_application_running(i))
@@ -461,6 +2057,129 @@ void restart_application(int i)
     }
 }
 
+void schedule_restart(int i)
+{
+    clk_t now = clock_ms();
+    clk_t delay = 0;
+    int recent = 0;
+
+    if(is_application_running(i))
+    {
+        stop_application(i, STOP_RESTART);
+        return; // scheduled again by update_stop() once it has exited
+    }
+
+    kill_leftovers(i);
+    apps[i].restarts[apps[i].restart_head] = now;
+    apps[i].restart_head = (apps[i].restart_head + 1) % MAX_RESTART_LIMIT;
+
+    for(int n = 0; n < MAX_RESTART_LIMIT; n++)
+    {
+        if(0 < apps[i].restarts[n] && now - apps[i].restarts[n] < (clk_t)apps[i].restart_window * 1000)
+        {
+            recent++;
+        }
+    }
+
+    if(0 < apps[i].restart_limit && recent > apps[i].restart_limit)
+    {
+        if(!apps[i].crash_loop)
+        {
+            apps[i].crash_loop = true;
+            LOGE("Process %s is in a crash loop, %d restarts in %d seconds, restarting every %d seconds",
+                 apps[i].name, recent, apps[i].restart_window, apps[i].restart_backoff_max);
+            stats_crash_loop_at(i);
+        }
+
+        delay = (clk_t)apps[i].restart_backoff_max * 1000;
+    }
+    else if(0 < apps[i].backoff_level)
+    {
+        int shift = apps[i].backoff_level - 1 < 16 ? apps[i].backoff_level - 1 : 16;
+        delay = ((clk_t)apps[i].restart_backoff * 1000) << shift;
+
+        if(delay > (clk_t)apps[i].restart_backoff_max * 1000)
+        {
+            delay = (clk_t)apps[i].restart_backoff_max * 1000;
+        }
+    }
+
+    if(0 < delay)
+    {
+        // Spread the restarts of apps failing together
+        int64_t spread = (int64_t)delay * RESTART_JITTER / 100;
+        delay += (rand() % (2 * spread + 1)) - spread;
+    }
+
+    apps[i].backoff_level++;
+    apps[i].started = true;
+    apps[i].first_heartbeat = false;
+    apps[i].pid = 0;
+    apps[i].restart_at = now + delay + 1; // never 0
+    LOGD("Restart of %s scheduled in %llu ms", apps[i].name, (unsigned long long)delay);
+    trace_app_phase(i, TRACE_PHASE_BACKOFF);
+}
+
+void resume_restart(int i, uint64_t delay, int backoff_level)
+{
+    release_tracking(i);
+    apps[i].started = true;
+    apps[i].first_heartbeat = false;
+    apps[i].pid = 0;
+    apps[i].pgid = 0;
+    apps[i].backoff_level = backoff_level;
+    apps[i].restart_at = clock_ms() + delay + 1; // never 0
+    LOGD("Restart of %s resumed in %llu ms", apps[i].name, (unsigned long long)delay);
+    trace_app_phase(i, TRACE_PHASE_BACKOFF);
+}
+
+uint64_t get_restart_delay(int i)
+{
+    clk_t now = clock_ms();
+    return (0 < apps[i].restart_at && apps[i].restart_at > now) ? apps[i].restart_at - now : 0;
+}
+
+int get_backoff_level(int i)
+{
+    return apps[i].backoff_level;
+}
+
+bool is_restart_pending(int i)
+{
+    return 0 < apps[i].restart_at;
+}
+
+bool is_restart_time(int i)
+{
+    return 0 < apps[i].restart_at && clock_ms() >= apps[i].restart_at;
+}
+
+void cancel_restart(int i)
+{
+    apps[i].restart_at = 0;
+    apps[i].started = false;
+    trace_app_phase(i, TRACE_PHASE_NONE);
+}
+
+bool is_crash_loop(int i)
+{
+    return apps[i].crash_loop;
+}
+
+void update_restart_backoff(int i)
+{
+    if(0 < apps[i].backoff_level && clock_ms() - apps[i].started_ms >= (clk_t)apps[i].restart_window * 1000)
+    {
+        if(apps[i].crash_loop)
+        {
+            apps[i].crash_loop = false;
+            LOGN("Process %s has recovered from the crash loop", apps[i].name);
+        }
+
+        apps[i].backoff_level = 0;
+    }
+}
+
 int get_app_count(void)
 {
     return app_count;
@@ -471,7 +2190,167 @@ char *get_app_name(int i)
     return apps[i].name;
 }
 
+int get_app_pid(int i)
+{
+    return apps[i].pid;
+}
+
+int get_app_pgid(int i)
+{
+    return apps[i].pgid;
+}
+
 int get_udp_port(void)
 {
     return udp_port;
 }
+
+char *get_trace_file(void)
+{
+    return trace_file;
+}
+
+char *get_cgroup_root(void)
+{
+    return cgroup_root;
+}
+
+char *get_state_file(void)
+{
+    return state_file;
+}
+
+char *get_cpu_max(int i)
+{
+    return apps[i].cpu_max;
+}
+
+char *get_memory_max(int i)
+{
+    return apps[i].memory_max;
+}
+
+int get_io_weight(int i)
+{
+    return apps[i].io_weight;
+}
+
+char *get_pool_name(int i)
+{
+    return apps[i].pool;
+}
+
+int get_instance(int i)
+{
+    return apps[i].instance;
+}
+
+int get_instance_count(int i)
+{
+    return apps[i].instances;
+}
+
+int get_rollout_batch(int i)
+{
+    return apps[i].rollout_batch;
+}
+
+int get_rollout_max_failures(int i)
+{
+    return apps[i].rollout_max_failures;
+}
+
+char *get_cpu_affinity(int i)
+{
+    return apps[i].cpu_affinity;
+}
+
+char *get_numa_nodes(int i)
+{
+    return apps[i].numa_nodes;
+}
+
+char *get_numa_policy(int i)
+{
+    return apps[i].numa_policy;
+}
+
+int get_nice(int i)
+{
+    return apps[i].nice;
+}
+
+char *get_ionice(int i)
+{
+    return apps[i].ionice;
+}
+
+char *get_sched_policy(int i)
+{
+    return apps[i].sched_policy;
+}
+
+char *get_listen(int i)
+{
+    return apps[i].listen;
+}
+
+bool is_on_demand(int i)
+{
+    return apps[i].on_demand;
+}
+
+int get_idle_timeout(int i)
+{
+    return apps[i].idle_timeout;
+}
+
+double get_phi_threshold(int i)
+{
+    return apps[i].phi_threshold;
+}
+
+bool is_next_heartbeat_requested(int i)
+{
+    return 0 < apps[i].next_heartbeat_ms;
+}
+
+bool is_ready_notify(int i)
+{
+    return apps[i].ready_notify;
+}
+
+int get_ready_timeout(int i)
+{
+    return apps[i].ready_timeout;
+}
+
+bool has_warm_spare(int i)
+{
+    return apps[i].warm_spare;
+}
+
+char *get_zygote(int i)
+{
+    return apps[i].zygote;
+}
+
+int get_sample_interval(void)
+{
+    return sample_interval;
+}
+
+int get_max_rss(int i)
+{
+    return apps[i].max_rss;
+}
+
+int get_max_cpu(int i)
+{
+    return apps[i].max_cpu;
+}
+
+int get_max_cpu_duration(int i)
+{
+    return apps[i].max_cpu_duration;
+}
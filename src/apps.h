@@ -22,6 +22,7 @@
 #define APPS_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <time.h>
 
 /**
@@ -30,12 +31,69 @@
 */
 
 // Constants
-#define MAX_APPS 6 /**< Maximum supported number of applications. */
+#ifndef MAX_APPS
+#define MAX_APPS 6 /**< Maximum supported number of applications, can be overridden at build time. */
+#endif
 #define MAX_APP_CMD_LENGTH 256 /**< Maximum length of the command to start an application. */
 #define MAX_APP_NAME_LENGTH 32 /**< Maximum length of an application name. */
+#define MAX_APP_ARGS 64 /**< Maximum number of arguments of the command including the executable. */
+#define MAX_APP_DEPENDS 8 /**< Maximum number of applications an application can depend on. */
 #define MAX_WAIT_PROCESS_TERMINATION 30 /**< Maximum time to wait for a process to terminate (seconds). */
+#define MAX_RESTART_LIMIT 32 /**< Maximum value of restart_limit. */
+#define MAX_LEFTOVERS 16 /**< Maximum number of processes left by an application listed in the log. */
+#define RESTART_BACKOFF 1 /**< Default backoff before the second restart in a row, doubled for every further one (seconds). */
+#define RESTART_BACKOFF_MAX 60 /**< Default maximum restart backoff, also the hold time of a crash loop (seconds). */
+#define RESTART_LIMIT 5 /**< Default number of restarts in restart_window which marks a crash loop, 0 disables. */
+#define RESTART_WINDOW 60 /**< Default window of the crash loop detection and stable runtime which resets the backoff (seconds). */
+#define RESTART_JITTER 20 /**< Random spread of the restart backoff (percent). */
+#define SAMPLE_INTERVAL 5 /**< Default resource usage sample interval (seconds). */
+#define MAX_CPU_DURATION 30 /**< Default time the CPU usage may stay over max_cpu (seconds). */
+#define INSTANCES_NCPU "ncpu" /**< Value of instances starting one instance per online CPU. */
+#define ROLLOUT_BATCH 1 /**< Default number of instances restarting at a time in a rollout. */
+#define ROLLOUT_MAX_FAILURES 2 /**< Default number of failed instances aborting a rollout. */
+#define ACTIVATION_ALWAYS "always" /**< Value of activation starting the application with the watchdog. */
+#define ACTIVATION_ON_DEMAND "on_demand" /**< Value of activation starting the application on the first connection or datagram. */
+#define READINESS_HEARTBEAT "heartbeat" /**< Value of readiness making the application ready with its first heartbeat. */
+#define READINESS_NOTIFY "notify" /**< Value of readiness making the application ready with a heartbeat carrying READY=1. */
+#define READY_TIMEOUT 90 /**< Default time from the spawn within which an application with notify readiness must be ready (seconds). */
+#define NICE_INHERIT 20 /**< nice value which keeps the one of the watchdog, out of the valid range. */
 #define INI_FILE "config.ini" /**< Default ini file path. */
 
+/**
+    @brief Process operations used to spawn, signal and reap the applications.
+
+    The default operations act on real processes, simulations replace them with scripted children.
+*/
+typedef struct
+{
+    int (*spawn)(int i); /**< Starts the application at index i, returns its PID, 0 if its zygote passes it to set_forked_pid() later, or -1 on failure. */
+    int (*kill)(int pid, int sig); /**< Sends a signal like kill(2), signal 0 checks the existence. */
+    int (*wait)(int pid, int *status, int options); /**< Waits for a state change like waitpid(2). */
+} ProcessOps_t;
+
+/**
+    @brief Change of an application by a reload of the ini file.
+*/
+typedef enum
+{
+    APP_UNCHANGED = 0, /**< Same command, the other settings are updated in place. */
+    APP_ADDED, /**< Added to the ini file, not started yet. */
+    APP_RESTARTED, /**< The command has changed, stopped to be started with the new one. */
+    APP_LIMITS_CHANGED, /**< The cgroup limits have changed. */
+    APP_REMOVED /**< Removed from the ini file and stopped, its slot is free. */
+} AppChange_t;
+
+/**
+    @brief What is done with an application once its process stopped by stop_application() has exited.
+*/
+typedef enum
+{
+    STOP_RESTART = 0, /**< Restarted after its backoff, see schedule_restart(). */
+    STOP_RESPAWN, /**< Started again by the next scan without a backoff, e.g. by a restart command or with a changed command. */
+    STOP_HALT, /**< Left stopped until it is started again. */
+    STOP_REMOVE /**< Removed from the ini file, its slot is freed. */
+} StopAction_t;
+
 // Function prototypes
 
 /**
@@ -68,9 +126,71 @@ int find_pid(int pid);
 */
 time_t get_heartbeat_time(int i);
 
+/**
+    @brief Gets the monotonic time of the last heartbeat received from the specified application.
+
+    @param i Index of the application.
+    @return Monotonic time in milliseconds, see time_ms().
+*/
+uint64_t get_heartbeat_ms(int i);
+
+/**
+    @brief Gets the monotonic time when the specified application was last seen running.
+
+    @param i Index of the application.
+    @return Monotonic time in milliseconds, see time_ms().
+*/
+uint64_t get_alive_time(int i);
+
+/**
+    @brief Updates the time of the last activity reported by the specified application.
+
+    @param i Index of the application.
+*/
+void update_activity_time(int i);
+
+/**
+    @brief Checks if the specified application, started on demand, has reported no activity for its idle timeout.
+
+    @param i Index of the application.
+    @return true if the application is idle and is to be stopped, false otherwise.
+*/
+bool is_idle(int i);
+
+/**
+    @brief Checks if the specified application with notify readiness has not sent READY=1 within ready_timeout
+    since its spawn, which is a failed start.
+
+    @param i Index of the application.
+    @return true if the application is late, false otherwise.
+*/
+bool is_ready_late(int i);
+
+/**
+    @brief Gets the time since the specified application was started.
+
+    @param i Index of the application.
+    @return Time since the spawn or the adoption of the process (seconds).
+*/
+time_t get_startup_time(int i);
+
+/**
+    @brief Sets the time the specified application requested until its next heartbeat.
+
+    The request replaces heartbeat_delay or heartbeat_interval until the next heartbeat, it is
+    bounded by heartbeat_max and ignored if heartbeat_max is 0.
+
+    @param i Index of the application.
+    @param ms Time until the next heartbeat (milliseconds).
+*/
+void set_next_heartbeat(int i, long ms);
+
 /**
     @brief Checks if it is time to expect a heartbeat from the specified application.
 
+    The time requested by the application in its last heartbeat applies if any, otherwise the
+    phi accrual detector may suspect a running application before heartbeat_interval.
+
     @param i Index of the application.
     @return true if it is time to expect a heartbeat, false otherwise.
 */
@@ -100,7 +220,7 @@ bool get_first_heartbeat(int i);
 int set_ini_file(char *path);
 
 /**
-    @brief Checks if the ini file has been modified since the last check.
+    @brief Checks if the ini file has been modified since it was read, and not within the last second.
 
     @return true if the ini file has been modified, false otherwise.
 */
@@ -113,6 +233,52 @@ bool is_ini_updated();
 */
 int read_ini_file();
 
+/**
+    @brief Reads the ini file again and applies the differences to the running applications.
+
+    The applications are matched by name and keep their index and state. Added applications
+    are started like at boot, removed ones are stopped and their indexes reused, the ones
+    whose command has changed are restarted and the other settings are updated in place.
+    udp_port, trace_file and cgroup_root need a restart of the watchdog.
+
+    @return 0 if successful, 1 if the ini file cannot be read and nothing is changed.
+*/
+int reload_ini_file(void);
+
+/**
+    @brief Gets the change of the specified application by the last reload of the ini file.
+
+    @param i Index of the application.
+    @return Change of the application.
+*/
+AppChange_t get_app_change(int i);
+
+/**
+    @brief Checks if the specified application has been removed from the ini file by a reload.
+
+    @param i Index of the application.
+    @return true if the index is free, false otherwise.
+*/
+bool is_application_removed(int i);
+
+/**
+    @brief Takes over a process started by a previous watchdog instead of starting the application.
+
+    The process is verified by its pidfd and start time, a process reusing the PID is not adopted.
+    It is not a child of the watchdog, its exit is detected on the pidfd.
+
+    @param i Index of the application.
+    @param pid Process ID saved by the previous watchdog.
+    @param pgid Process group saved by the previous watchdog, 0 if none.
+    @param start_time Start time of the process saved by the previous watchdog (clock ticks after boot).
+    @param first_heartbeat Whether the process had sent its first heartbeat.
+    @param heartbeat_age Time since its last heartbeat (milliseconds).
+    @param backoff_level Number of restarts in a row without a stable run.
+    @return 0 if the process is adopted, 1 if it is not running anymore.
+*/
+int adopt_application(int i, int pid, int pgid, unsigned long long start_time, bool first_heartbeat, uint64_t heartbeat_age,
+                      int backoff_level);
+
 /**
     @brief Checks if the specified application is currently running.
 
@@ -130,13 +296,29 @@ bool is_application_running(int i);
 bool is_application_started(int i);
 
 /**
-    @brief Checks if it is time to start the specified application based on the start delay.
+    @brief Checks if the specified application is ready, it is started and has sent its first heartbeat.
+
+    @param i Index of the application.
+    @return true if the application is ready, false otherwise.
+*/
+bool is_application_ready(int i);
+
+/**
+    @brief Checks if it is time to start the specified application, the start delay has elapsed
+    and all the applications it depends on are ready.
 
     @param i Index of the application.
     @return true if it is time to start the application, false otherwise.
 */
 bool is_application_start_time(int i);
 
+/**
+    @brief Replaces the process operations, e.g. with simulated children.
+
+    @param ops Process operations, NULL restores the operations on real processes.
+*/
+void set_process_ops(const ProcessOps_t *ops);
+
 /**
     @brief Starts the specified application.
 
@@ -145,19 +327,189 @@ bool is_application_start_time(int i);
 void start_application(int i);
 
 /**
-    @brief Stops the specified application by killing its process.
+    @brief Completes the start of a process of the specified application forked by its zygote.
+
+    @param i Index of the application.
+    @param pid Process ID, -1 with errno set if the zygote has not forked it.
+    @param spare true if the process is the warm spare of the application.
+*/
+void set_forked_pid(int i, int pid, bool spare);
+
+/**
+    @brief Stops the specified application by killing its process and waits for it, up to
+    MAX_WAIT_PROCESS_TERMINATION seconds, e.g. when the watchdog exits.
 
     @param i Index of the application.
 */
 void kill_application(int i);
 
 /**
-    @brief Restarts the specified application.
+    @brief Asks the process of the specified application to terminate with SIGTERM, without waiting for it.
+
+    The application scan takes the action once it has exited, see update_stop().
+
+    @param i Index of the application.
+    @param then Action taken once the process has exited.
+*/
+void stop_application(int i, StopAction_t then);
+
+/**
+    @brief Checks if the process of the specified application is terminating after stop_application().
+
+    @param i Index of the application.
+    @return true if the process is terminating, false otherwise.
+*/
+bool is_application_stopping(int i);
+
+/**
+    @brief Checks if the process stopped by stop_application() and the processes it forked have exited,
+    and kills them with SIGKILL once they have not terminated within MAX_WAIT_PROCESS_TERMINATION seconds.
+
+    The action given to stop_application() is taken once they have exited.
+
+    @param i Index of the application.
+    @return true if the processes have exited, false if they are still terminating.
+*/
+bool update_stop(int i);
+
+/**
+    @brief Starts the warm spare of the specified application, a second process of its command.
+
+    The spare is left out of the cgroup of the application until it is promoted.
+
+    @param i Index of the application.
+*/
+void start_spare(int i);
+
+/**
+    @brief Kills the warm spare of the specified application, if it has one.
+
+    @param i Index of the application.
+*/
+void stop_spare(int i);
+
+/**
+    @brief Finds the application with a warm spare of the specified process ID.
+
+    @param pid Process ID of the spare.
+    @return Index of the application, -1 if not found.
+*/
+int find_spare(int pid);
+
+/**
+    @brief Pauses the warm spare of the specified application with SIGSTOP, called on its first heartbeat.
+
+    @param i Index of the application.
+*/
+void set_spare_ready(int i);
+
+/**
+    @brief Checks if the warm spare of the specified application is initialised and paused.
+
+    @param i Index of the application.
+    @return true if the spare can be promoted, false otherwise.
+*/
+bool is_spare_ready(int i);
+
+/**
+    @brief Replaces an exited or late warm spare and starts a new one once the application is ready.
+
+    @param i Index of the application.
+*/
+void update_spare(int i);
+
+/**
+    @brief Continues the paused warm spare of the specified application in place of its failed process,
+    which is killed afterwards.
+
+    @param i Index of the application.
+    @return true if the spare has been promoted, false if the application has no ready spare.
+*/
+bool promote_spare(int i);
+
+/**
+    @brief Restarts the specified application, immediately if it is not running, otherwise once its process
+    has exited, see stop_application().
 
     @param i Index of the application.
 */
 void restart_application(int i);
 
+/**
+    @brief Schedules the restart of the specified application after the backoff, once its process has exited
+    if it is running, see stop_application().
+
+    The first restart is immediate, every further restart in a row waits twice as long up to
+    restart_backoff_max. More than restart_limit restarts in restart_window mark a crash loop,
+    which is logged once and holds the application for restart_backoff_max between restarts.
+
+    @param i Index of the application.
+*/
+void schedule_restart(int i);
+
+/**
+    @brief Schedules a restart of the application handed over by a previous watchdog with its remaining backoff.
+
+    @param i Index of the application.
+    @param delay Time left until the restart (milliseconds).
+    @param backoff_level Number of restarts in a row without a stable run.
+*/
+void resume_restart(int i, uint64_t delay, int backoff_level);
+
+/**
+    @brief Gets the time left until the scheduled restart of the specified application.
+
+    @param i Index of the application.
+    @return Time until the restart (milliseconds), 0 if no restart is scheduled or it is due.
+*/
+uint64_t get_restart_delay(int i);
+
+/**
+    @brief Gets the number of restarts in a row of the specified application without a stable run.
+
+    @param i Index of the application.
+    @return Backoff level.
+*/
+int get_backoff_level(int i);
+
+/**
+    @brief Checks if a restart of the specified application is scheduled.
+
+    @param i Index of the application.
+    @return true if the application is waiting for its restart, false otherwise.
+*/
+bool is_restart_pending(int i);
+
+/**
+    @brief Checks if the scheduled restart of the specified application is due.
+
+    @param i Index of the application.
+    @return true if the application must be started now, false otherwise.
+*/
+bool is_restart_time(int i);
+
+/**
+    @brief Cancels the scheduled restart of the specified application, it is left stopped.
+
+    @param i Index of the application.
+*/
+void cancel_restart(int i);
+
+/**
+    @brief Checks if the specified application is in a crash loop.
+
+    @param i Index of the application.
+    @return true if the application is in a crash loop, false otherwise.
+*/
+bool is_crash_loop(int i);
+
+/**
+    @brief Resets the restart backoff and the crash loop state once the application has run for restart_window.
+
+    @param i Index of the application.
+*/
+void update_restart_backoff(int i);
+
 /**
     @brief Gets the total number of applications found in the ini file.
 
@@ -173,6 +525,62 @@ int get_app_count();
 */
 char *get_app_name(int i);
 
+/**
+    @brief Gets the name of the pool the application at the specified index is an instance of.
+
+    @param i Index of the application.
+    @return Name of the pool, empty string if the application is not a pool.
+*/
+char *get_pool_name(int i);
+
+/**
+    @brief Gets the instance number of the application at the specified index within its pool.
+
+    @param i Index of the application.
+    @return Instance number from 0.
+*/
+int get_instance(int i);
+
+/**
+    @brief Gets the number of instances of the pool of the application at the specified index.
+
+    @param i Index of the application.
+    @return Number of instances, 0 if the application is not a pool.
+*/
+int get_instance_count(int i);
+
+/**
+    @brief Gets the maximum number of instances of the pool of the specified application restarting at a time in a rollout.
+
+    @param i Index of the application.
+    @return Number of instances.
+*/
+int get_rollout_batch(int i);
+
+/**
+    @brief Gets the number of failed instances aborting a rollout of the pool of the specified application.
+
+    @param i Index of the application.
+    @return Number of failures, 0 if a rollout is never aborted.
+*/
+int get_rollout_max_failures(int i);
+
+/**
+    @brief Gets the process ID of the application at the specified index.
+
+    @param i Index of the application.
+    @return Process ID, 0 if the application is not running.
+*/
+int get_app_pid(int i);
+
+/**
+    @brief Gets the process group of the application at the specified index.
+
+    @param i Index of the application.
+    @return Process group ID, 0 if the application has none.
+*/
+int get_app_pgid(int i);
+
 /**
     @brief Gets the UDP port number specified in the ini file.
 
@@ -180,4 +588,201 @@ char *get_app_name(int i);
 */
 int get_udp_port();
 
+/**
+    @brief Gets the lifecycle trace file path specified in the ini file.
+
+    @return Path of the trace file, empty string if the trace export is disabled.
+*/
+char *get_trace_file();
+
+/**
+    @brief Gets the cgroup root specified in the ini file.
+
+    @return Path of the root, empty string for automatic, "none" if cgroups are disabled.
+*/
+char *get_cgroup_root();
+
+/**
+    @brief Gets the state file path specified in the ini file.
+
+    @return Path of the state file, empty string if the applications are not handed over on a restart.
+*/
+char *get_state_file();
+
+/**
+    @brief Gets the cpu.max cgroup limit of the application at the specified index.
+
+    @param i Index of the application.
+    @return Value of cpu.max, empty string if unlimited.
+*/
+char *get_cpu_max(int i);
+
+/**
+    @brief Gets the memory.max cgroup limit of the application at the specified index.
+
+    @param i Index of the application.
+    @return Value of memory.max, empty string if unlimited.
+*/
+char *get_memory_max(int i);
+
+/**
+    @brief Gets the io.weight cgroup setting of the application at the specified index.
+
+    @param i Index of the application.
+    @return Value of io.weight, 0 for the default.
+*/
+int get_io_weight(int i);
+
+/**
+    @brief Gets the CPU affinity of the application at the specified index.
+
+    @param i Index of the application.
+    @return List of CPUs like "0-3,8", "auto" for the automatic placement, empty string for all CPUs.
+*/
+char *get_cpu_affinity(int i);
+
+/**
+    @brief Gets the NUMA nodes of the memory policy of the application at the specified index.
+
+    @param i Index of the application.
+    @return List of nodes like "0-1", "auto" for the nodes of its CPUs, empty string for all nodes.
+*/
+char *get_numa_nodes(int i);
+
+/**
+    @brief Gets the NUMA memory policy of the application at the specified index.
+
+    @param i Index of the application.
+    @return "bind", "preferred" or "interleave", empty string for bind.
+*/
+char *get_numa_policy(int i);
+
+/**
+    @brief Gets the nice value of the application at the specified index.
+
+    @param i Index of the application.
+    @return Nice value between -20 and 19, NICE_INHERIT to keep the one of the watchdog.
+*/
+int get_nice(int i);
+
+/**
+    @brief Gets the I/O scheduling class and level of the application at the specified index.
+
+    @param i Index of the application.
+    @return "realtime:level", "best-effort:level" or "idle", empty string to inherit.
+*/
+char *get_ionice(int i);
+
+/**
+    @brief Gets the scheduling policy of the application at the specified index.
+
+    @param i Index of the application.
+    @return "other", "batch", "idle", "fifo:priority" or "rr:priority", empty string to inherit.
+*/
+char *get_sched_policy(int i);
+
+/**
+    @brief Gets the sockets of the application at the specified index.
+
+    @param i Index of the application.
+    @return Socket list, e.g. "tcp:8080, udp:5353, unix:/run/app.sock", empty string if none.
+*/
+char *get_listen(int i);
+
+/**
+    @brief Checks if the application at the specified index is started on the first connection or datagram.
+
+    @param i Index of the application.
+    @return true if the activation is on_demand, false if always.
+*/
+bool is_on_demand(int i);
+
+/**
+    @brief Gets the idle timeout of the application at the specified index.
+
+    @param i Index of the application.
+    @return Time without activity stopping the application started on demand (seconds), 0 never.
+*/
+int get_idle_timeout(int i);
+
+/**
+    @brief Gets the threshold of the phi accrual detector of the application at the specified index.
+
+    @param i Index of the application.
+    @return Suspicion level restarting the application, 0 if the detector is disabled.
+*/
+double get_phi_threshold(int i);
+
+/**
+    @brief Checks if the application at the specified index has requested the time until its next heartbeat.
+
+    @param i Index of the application.
+    @return true if the last heartbeat carried NEXT, false otherwise.
+*/
+bool is_next_heartbeat_requested(int i);
+
+/**
+    @brief Checks if the application at the specified index notifies its readiness with READY=1.
+
+    @param i Index of the application.
+    @return true if the readiness is notify, false if the first heartbeat makes it ready.
+*/
+bool is_ready_notify(int i);
+
+/**
+    @brief Gets the time from the spawn within which the application at the specified index must be ready
+    with notify readiness.
+
+    @param i Index of the application.
+    @return Time of the readiness deadline (seconds).
+*/
+int get_ready_timeout(int i);
+
+/**
+    @brief Checks if the application at the specified index keeps a warm spare.
+
+    @param i Index of the application.
+    @return true if warm_spare is set, false otherwise.
+*/
+bool has_warm_spare(int i);
+
+/**
+    @brief Gets the zygote command of the application at the specified index.
+
+    @param i Index of the application.
+    @return Command of the fork server the application is started from, empty string if none.
+*/
+char *get_zygote(int i);
+
+/**
+    @brief Gets the resource usage sample interval specified in the ini file.
+
+    @return Sample interval (seconds), 0 if the sampling is disabled.
+*/
+int get_sample_interval();
+
+/**
+    @brief Gets the memory limit of the application at the specified index.
+
+    @param i Index of the application.
+    @return Maximum resident set size (MB), 0 if unlimited.
+*/
+int get_max_rss(int i);
+
+/**
+    @brief Gets the CPU usage limit of the application at the specified index.
+
+    @param i Index of the application.
+    @return Maximum CPU usage (percent of one core), 0 if unlimited.
+*/
+int get_max_cpu(int i);
+
+/**
+    @brief Gets the time the CPU usage of the application at the specified index may stay over its limit.
+
+    @param i Index of the application.
+    @return Duration (seconds).
+*/
+int get_max_cpu_duration(int i);
+
 #endif // APPS_H
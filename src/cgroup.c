@@ -0,0 +1,529 @@
+/**
+    @file cgroup.c
+    @brief Process Watchdog Application Manager
+
+    The Process Watchdog application manages the processes listed in the configuration file.
+    It listens to a specified UDP port for heartbeat messages from these processes, which must
+    periodically send their PID. If any process stops running or fails to send its PID over UDP
+    within the expected interval, the Process Watchdog application will restart the process.
+
+    The application ensures high reliability and availability by continuously monitoring and
+    restarting processes as necessary. It also logs various statistics about the monitored
+    processes, including start times, crash times, and heartbeat intervals.
+
+    @date 2023-01-01
+    @version 1.0
+    @author by Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license GPL-3 License
+*/
+
+#define _GNU_SOURCE // clone
+
+#include "cgroup.h"
+#include "activation.h"
+#include "apps.h"
+#include "clock.h"
+#include "log.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sched.h>
+#include <pthread.h>
+
+static bool started; // cgroups are used
+static int root_fd = -1; // root of the application cgroups
+static char root_path[PATH_MAX];
+static int app_fd[MAX_APPS]; // cgroup directories of the applications, -1 if none
+
+/**
+    @brief cgroup limits of an application.
+*/
+typedef struct
+{
+    char cpu_max[32]; /**< Value of cpu.max, empty if unlimited. */
+    char memory_max[32]; /**< Value of memory.max, empty if unlimited. */
+    int io_weight; /**< Value of io.weight, 0 for the default. */
+} Limits_t;
+
+static Limits_t limits[MAX_APPS];
+
+static int write_at(int dirfd, const char *file, const char *value)
+{
+    int fd = openat(dirfd, file, O_WRONLY | O_CLOEXEC);
+
+    if(fd < 0)
+    {
+        return -1;
+    }
+
+    ssize_t n = write(fd, value, strlen(value));
+    int err = errno;
+    close(fd);
+    errno = err;
+    return n < 0 ? -1 : 0;
+}
+
+static int read_at(int dirfd, const char *file, char *buf, size_t size)
+{
+    int fd = openat(dirfd, file, O_RDONLY | O_CLOEXEC);
+
+    if(fd < 0)
+    {
+        return -1;
+    }
+
+    ssize_t n = read(fd, buf, size - 1);
+    close(fd);
+
+    if(n < 0)
+    {
+        return -1;
+    }
+
+    buf[n] = 0;
+    return 0;
+}
+
+// Finds the cgroup v2 directory of the watchdog, is_root is set if it is in the root cgroup
+static int own_cgroup(char *path, size_t size, bool *is_root)
+{
+    char line[PATH_MAX], mount[PATH_MAX] = "", own[PATH_MAX] = "";
+    FILE *fp = fopen("/proc/self/mounts", "re");
+
+    if(NULL == fp)
+    {
+        return 1;
+    }
+
+    while(NULL != fgets(line, sizeof(line), fp))
+    {
+        char dev[64], dir[PATH_MAX], type[64];
+
+        if(3 == sscanf(line, "%63s %4095s %63s", dev, dir, type) && 0 == strcmp(type, "cgroup2"))
+        {
+            snprintf(mount, sizeof(mount), "%s", dir);
+            break;
+        }
+    }
+
+    fclose(fp);
+    fp = fopen("/proc/self/cgroup", "re");
+
+    if(NULL == fp)
+    {
+        return 1;
+    }
+
+    while(NULL != fgets(line, sizeof(line), fp))
+    {
+        if(0 == strncmp(line, "0::", 3))
+        {
+            line[strcspn(line, "\n")] = 0;
+            snprintf(own, sizeof(own), "%s", &line[3]);
+            break;
+        }
+    }
+
+    fclose(fp);
+
+    if(0 == strlen(mount) || 0 == strlen(own))
+    {
+        return 1;
+    }
+
+    *is_root = (0 == strcmp(own, "/"));
+    snprintf(path, size, "%s%s", mount, *is_root ? "" : own);
+    return 0;
+}
+
+static void enable_controllers(void)
+{
+    static const char *controllers[] = { "cpu", "memory", "io" };
+    char available[256];
+
+    if(read_at(root_fd, "cgroup.controllers", available, sizeof(available)))
+    {
+        return;
+    }
+
+    for(size_t k = 0; k < sizeof(controllers) / sizeof(controllers[0]); k++)
+    {
+        char enable[16];
+        snprintf(enable, sizeof(enable), "+%s", controllers[k]);
+
+        if(NULL == strstr(available, controllers[k]) || write_at(root_fd, "cgroup.subtree_control", enable))
+        {
+            LOGD("cgroup controller %s is not available in %s", controllers[k], root_path);
+        }
+    }
+}
+
+int cgroup_start(const char *root)
+{
+    char path[PATH_MAX];
+    bool is_root = false;
+    bool move_self = false;
+
+    for(int i = 0; i < MAX_APPS; i++)
+    {
+        app_fd[i] = -1;
+    }
+
+    // Placement changes the cgroup of the watchdog, so it is only done when it is asked for
+    if(0 == strlen(root) || 0 == strcmp(root, "none"))
+    {
+        LOGI("cgroups are disabled, applications run in process groups");
+        return 1;
+    }
+
+    if(0 != strcmp(root, CGROUP_ROOT_AUTO))
+    {
+        snprintf(root_path, sizeof(root_path), "%s", root);
+    }
+    else if(own_cgroup(path, sizeof(path), &is_root))
+    {
+        LOGW("cgroup v2 is not available, applications run in process groups");
+        return 1;
+    }
+    else if(is_root)
+    {
+        snprintf(root_path, sizeof(root_path), "%s/%s", path, CGROUP_ROOT_NAME);
+    }
+    else
+    {
+        // A delegated cgroup with processes cannot enable controllers for its children
+        snprintf(root_path, sizeof(root_path), "%s", path);
+        move_self = true;
+    }
+
+    if(0 != mkdir(root_path, 0755) && EEXIST != errno)
+    {
+        LOGW("cgroup %s cannot be created, applications run in process groups : %s", root_path, strerror(errno));
+        return 1;
+    }
+
+    root_fd = open(root_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    if(root_fd < 0)
+    {
+        LOGW("cgroup %s cannot be opened, applications run in process groups : %s", root_path, strerror(errno));
+        return 1;
+    }
+
+    if(move_self && ((0 != mkdirat(root_fd, CGROUP_SUPERVISOR_NAME, 0755) && EEXIST != errno) ||
+                     0 != write_at(root_fd, CGROUP_SUPERVISOR_NAME "/cgroup.procs", "0")))
+    {
+        LOGW("cgroup %s is not delegated, applications run in process groups : %s", root_path, strerror(errno));
+        close(root_fd);
+        root_fd = -1;
+        return 1;
+    }
+
+    enable_controllers();
+    started = true;
+    LOGI("Applications run in cgroups under %s", root_path);
+    return 0;
+}
+
+void cgroup_remove(int i)
+{
+    if(0 <= app_fd[i])
+    {
+        close(app_fd[i]);
+        app_fd[i] = -1;
+
+        if(0 != unlinkat(root_fd, get_app_name(i), AT_REMOVEDIR))
+        {
+            LOGD("cgroup of %s is not removed : %s", get_app_name(i), strerror(errno));
+        }
+    }
+}
+
+void cgroup_stop(void)
+{
+    for(int i = 0; i < MAX_APPS; i++)
+    {
+        cgroup_remove(i);
+    }
+
+    if(0 <= root_fd)
+    {
+        close(root_fd);
+        root_fd = -1;
+    }
+
+    started = false;
+}
+
+// Writes the limits of the application to its cgroup
+static void apply_limits(int i)
+{
+    Limits_t *l = &limits[i];
+    char weight[16];
+
+    if(0 < strlen(l->cpu_max) && write_at(app_fd[i], "cpu.max", l->cpu_max))
+    {
+        LOGE("Failed to set cpu.max of %s to %s : %s", get_app_name(i), l->cpu_max, strerror(errno));
+        l->cpu_max[0] = 0; // reported once, not retried for the new cgroups
+    }
+
+    if(0 < strlen(l->memory_max) && write_at(app_fd[i], "memory.max", l->memory_max))
+    {
+        LOGE("Failed to set memory.max of %s to %s : %s", get_app_name(i), l->memory_max, strerror(errno));
+        l->memory_max[0] = 0;
+    }
+
+    snprintf(weight, sizeof(weight), "%d", l->io_weight);
+
+    if(0 < l->io_weight && write_at(app_fd[i], "io.weight", weight))
+    {
+        LOGE("Failed to set io.weight of %s to %s : %s", get_app_name(i), weight, strerror(errno));
+        l->io_weight = 0;
+    }
+}
+
+// Creates or opens the cgroup directory of the application and applies its limits
+static int open_group(int i)
+{
+    if(0 != mkdirat(root_fd, get_app_name(i), 0755) && EEXIST != errno)
+    {
+        LOGE("Failed to create the cgroup of %s, error : %d - %s", get_app_name(i), errno, strerror(errno));
+        return 1;
+    }
+
+    app_fd[i] = openat(root_fd, get_app_name(i), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+    if(app_fd[i] < 0)
+    {
+        LOGE("Failed to open the cgroup of %s, error : %d - %s", get_app_name(i), errno, strerror(errno));
+        return 1;
+    }
+
+    apply_limits(i);
+    return 0;
+}
+
+int cgroup_create(int i, const char *cpu_max, const char *memory_max, int io_weight)
+{
+    if(!started)
+    {
+        return 1;
+    }
+
+    snprintf(limits[i].cpu_max, sizeof(limits[i].cpu_max), "%s", cpu_max);
+    snprintf(limits[i].memory_max, sizeof(limits[i].memory_max), "%s", memory_max);
+    limits[i].io_weight = io_weight;
+
+    if(open_group(i))
+    {
+        return 1;
+    }
+
+    // The processes adopted from the previous watchdog are kept
+    if(!is_application_started(i) && !cgroup_empty(i))
+    {
+        LOGW("cgroup of %s has processes left by a previous run, killing them", get_app_name(i));
+        return cgroup_kill(i);
+    }
+
+    return 0;
+}
+
+int cgroup_update(int i, const char *cpu_max, const char *memory_max, int io_weight)
+{
+    if(!cgroup_enabled(i))
+    {
+        return 1;
+    }
+
+    snprintf(limits[i].cpu_max, sizeof(limits[i].cpu_max), "%s", cpu_max);
+    snprintf(limits[i].memory_max, sizeof(limits[i].memory_max), "%s", memory_max);
+    limits[i].io_weight = io_weight;
+    apply_limits(i);
+    return 0;
+}
+
+bool cgroup_enabled(int i)
+{
+    return started && 0 <= app_fd[i];
+}
+
+/**
+    @brief Arguments of the spawned process, shared with it until its exec.
+*/
+typedef struct
+{
+    int i; /**< Index of the application. */
+    const char *exe; /**< Path of the executable. */
+    char *const *argv; /**< Arguments of the process. */
+    char **envp; /**< Environment with the sockets of the application, NULL for none. */
+    int procs_fd; /**< cgroup.procs of the cgroup to move into before the exec, -1 for none. */
+    volatile int err; /**< Error of the process before or on its exec, 0 if it has exec'ed. */
+} Spawn_t;
+
+static char spawn_stack[SPAWN_STACK_SIZE] __attribute__((aligned(16))); // the watchdog is suspended while it is used
+
+static int spawn_child(void *arg)
+{
+    extern char **environ;
+    static const int signals[] = { SIGINT, SIGTERM, SIGQUIT, SIGUSR1, SIGUSR2, SIGCHLD, SIGPIPE };
+    Spawn_t *spawn = arg;
+    struct sigaction sa;
+    sigset_t mask;
+
+    // Shares the memory of the watchdog, only async-signal-safe calls until exec
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = SIG_DFL;
+
+    for(size_t k = 0; k < sizeof(signals) / sizeof(signals[0]); k++)
+    {
+        sigaction(signals[k], &sa, NULL);
+    }
+
+    sigemptyset(&mask);
+    sigprocmask(SIG_SETMASK, &mask, NULL);
+    setpgid(0, 0);
+
+    // Writing 0 moves the writing process, the application never runs outside of its cgroup
+    if(0 <= spawn->procs_fd && 1 != write(spawn->procs_fd, "0", 1))
+    {
+        spawn->err = errno;
+        _exit(127);
+    }
+
+    if(NULL != spawn->envp)
+    {
+        activation_child(spawn->i, spawn->envp);
+    }
+
+    execve(spawn->exe, spawn->argv, (NULL != spawn->envp) ? spawn->envp : environ);
+    spawn->err = errno;
+    _exit(127);
+}
+
+int cgroup_spawn(int i, const char *exe, char *const argv[], bool into_cgroup)
+{
+    Spawn_t spawn = { i, exe, argv, NULL, -1, 0 };
+    sigset_t all, old;
+
+    if(into_cgroup && cgroup_enabled(i) && 0 > (spawn.procs_fd = openat(app_fd[i], "cgroup.procs", O_WRONLY | O_CLOEXEC)))
+    {
+        return -1;
+    }
+
+    // The environment with LISTEN_PID is prepared before the clone, the child only completes it
+    spawn.envp = activation_environ(i);
+    // Like posix_spawn, the signals are blocked until the child has reset their handlers
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    int pid = clone(spawn_child, spawn_stack + sizeof(spawn_stack), CLONE_VM | CLONE_VFORK | SIGCHLD, &spawn);
+    int err = (0 > pid) ? errno : spawn.err;
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    free(spawn.envp);
+
+    if(0 <= spawn.procs_fd)
+    {
+        close(spawn.procs_fd);
+    }
+
+    // The child has exited if it failed, it is reaped automatically
+    if(0 != err)
+    {
+        errno = err;
+        return -1;
+    }
+
+    return pid;
+}
+
+int cgroup_attach(int i, int pid)
+{
+    char value[16];
+    snprintf(value, sizeof(value), "%d", pid);
+
+    if(write_at(app_fd[i], "cgroup.procs", value))
+    {
+        LOGE("Failed to move %s into its cgroup, error : %d - %s", get_app_name(i), errno, strerror(errno));
+        return 1;
+    }
+
+    return 0;
+}
+
+int cgroup_procs(int i, int *pids, int max)
+{
+    char procs[4096];
+    int count = 0;
+
+    if(read_at(app_fd[i], "cgroup.procs", procs, sizeof(procs)))
+    {
+        return 0;
+    }
+
+    for(char *p = procs; *p && count < max; p += strcspn(p, "\n") + ('\n' == p[strcspn(p, "\n")]))
+    {
+        pids[count++] = atoi(p);
+    }
+
+    return count;
+}
+
+bool cgroup_empty(int i)
+{
+    char events[256];
+
+    if(read_at(app_fd[i], "cgroup.events", events, sizeof(events)))
+    {
+        return true;
+    }
+
+    return NULL != strstr(events, "populated 0");
+}
+
+int cgroup_kill(int i)
+{
+    if(write_at(app_fd[i], "cgroup.kill", "1"))
+    {
+        // Before Linux 5.14, kill the members one by one until none is left forking
+        char procs[4096];
+
+        for(int n = 0; n < 100 && 0 == read_at(app_fd[i], "cgroup.procs", procs, sizeof(procs)) && 0 < strlen(procs); n++)
+        {
+            for(char *p = procs; *p; p += strcspn(p, "\n") + ('\n' == p[strcspn(p, "\n")]))
+            {
+                kill(atoi(p), SIGKILL);
+            }
+        }
+    }
+
+    for(int waited = 0; !cgroup_empty(i); waited += 10)
+    {
+        if(waited >= CGROUP_KILL_TIMEOUT)
+        {
+            LOGE("cgroup of %s is not empty after cgroup.kill", get_app_name(i));
+            return 1;
+        }
+
+        clock_sleep_ms(10);
+    }
+
+    // Children cloned into a killed cgroup can be killed as well, continue in a new one
+    close(app_fd[i]);
+    app_fd[i] = -1;
+
+    if(0 != unlinkat(root_fd, get_app_name(i), AT_REMOVEDIR))
+    {
+        LOGD("cgroup of %s is not removed : %s", get_app_name(i), strerror(errno));
+    }
+
+    return open_group(i);
+}
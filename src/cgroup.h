@@ -0,0 +1,147 @@
+/**
+    @file cgroup.h
+    @brief Process Watchdog Application Manager
+
+    The Process Watchdog application manages the processes listed in the configuration file.
+    It listens to a specified UDP port for heartbeat messages from these processes, which must
+    periodically send their PID. If any process stops running or fails to send its PID over UDP
+    within the expected interval, the Process Watchdog application will restart the process.
+
+    The application ensures high reliability and availability by continuously monitoring and
+    restarting processes as necessary. It also logs various statistics about the monitored
+    processes, including start times, crash times, and heartbeat intervals.
+
+    @date 2023-01-01
+    @version 1.0
+    @author by Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license GPL-3 License
+*/
+
+#ifndef CGROUP_H
+#define CGROUP_H
+
+#include <stdbool.h>
+
+/**
+    @file cgroup.h
+    @brief cgroup v2 placement of the applications.
+
+    Every application runs in its own cgroup under a common root, the spawned process moves
+    itself into it before its exec, so its whole process tree is contained and can be
+    torn down at once with cgroup.kill. The cpu.max, memory.max and io.weight limits of
+    the applications are applied to their cgroups. Without cgroup_root, or when cgroup v2 is
+    not available or not delegated to the watchdog, the applications are run in their own
+    process groups.
+*/
+
+#define CGROUP_ROOT_AUTO "auto" /**< cgroup_root value selecting the cgroup of the watchdog. */
+#define CGROUP_ROOT_NAME "processWatchdog" /**< cgroup of the applications when the watchdog runs in the root cgroup. */
+#define CGROUP_SUPERVISOR_NAME "supervisor" /**< Leaf cgroup the watchdog moves itself into within a delegated cgroup. */
+#define CGROUP_KILL_TIMEOUT 1000 /**< Maximum time to wait for a killed cgroup to become empty (milliseconds). */
+#define SPAWN_STACK_SIZE (64 * 1024) /**< Stack of a spawned process until its exec (bytes). */
+
+/**
+    @brief Prepares the cgroup root of the applications and enables the controllers.
+
+    @param root Path of the root, CGROUP_ROOT_AUTO for the cgroup of the watchdog, empty or "none" to disable.
+    @return 0 if the applications are placed in cgroups, 1 otherwise.
+*/
+int cgroup_start(const char *root);
+
+/**
+    @brief Removes the cgroups of the applications, the applications must be stopped.
+*/
+void cgroup_stop(void);
+
+/**
+    @brief Creates the cgroup of the specified application and applies its limits.
+
+    A cgroup left over by a previous run is emptied with cgroup.kill and reused.
+
+    @param i Index of the application.
+    @param cpu_max Value of cpu.max, e.g. "50000 100000", empty to leave it unlimited.
+    @param memory_max Value of memory.max, e.g. "512M", empty to leave it unlimited.
+    @param io_weight Value of io.weight between 1 and 10000, 0 to leave the default.
+    @return 0 on success, 1 otherwise.
+*/
+int cgroup_create(int i, const char *cpu_max, const char *memory_max, int io_weight);
+
+/**
+    @brief Applies changed limits to the cgroup of the specified application, its processes keep running.
+
+    @param i Index of the application.
+    @param cpu_max Value of cpu.max, empty to leave it unchanged.
+    @param memory_max Value of memory.max, empty to leave it unchanged.
+    @param io_weight Value of io.weight between 1 and 10000, 0 to leave it unchanged.
+    @return 0 on success, 1 if the application has no cgroup.
+*/
+int cgroup_update(int i, const char *cpu_max, const char *memory_max, int io_weight);
+
+/**
+    @brief Removes the cgroup of the specified application, the application must be stopped.
+
+    @param i Index of the application.
+*/
+void cgroup_remove(int i);
+
+/**
+    @brief Checks if the specified application is placed in a cgroup.
+
+    @param i Index of the application.
+    @return true if the application has a cgroup, false otherwise.
+*/
+bool cgroup_enabled(int i);
+
+/**
+    @brief Starts a process of the specified application, in its cgroup if it has one and into_cgroup is set.
+
+    The process is cloned with CLONE_VM | CLONE_VFORK on its own stack like posix_spawn, the
+    watchdog is suspended until its exec. It leads its own process group, its signal
+    dispositions and mask are reset, it moves itself into the cgroup through cgroup.procs and
+    it receives the sockets of the application with LISTEN_PID set to its own PID.
+
+    @param i Index of the application.
+    @param exe Path of the executable.
+    @param argv Arguments of the process.
+    @param into_cgroup Spawn into the cgroup of the application, false to leave the process in the cgroup of the watchdog.
+    @return Process ID, -1 on failure with errno set.
+*/
+int cgroup_spawn(int i, const char *exe, char *const argv[], bool into_cgroup);
+
+/**
+    @brief Moves a process into the cgroup of the specified application, used for the processes not started by cgroup_spawn().
+
+    @param i Index of the application.
+    @param pid Process ID.
+    @return 0 on success, 1 otherwise.
+*/
+int cgroup_attach(int i, int pid);
+
+/**
+    @brief Kills all processes in the cgroup of the specified application and waits until it is empty.
+
+    @param i Index of the application.
+    @return 0 if the cgroup is empty, 1 otherwise.
+*/
+int cgroup_kill(int i);
+
+/**
+    @brief Lists the processes in the cgroup of the specified application.
+
+    @param i Index of the application.
+    @param pids Array receiving the process IDs.
+    @param max Size of the array.
+    @return Number of processes found.
+*/
+int cgroup_procs(int i, int *pids, int max);
+
+/**
+    @brief Checks if the cgroup of the specified application has no processes.
+
+    @param i Index of the application.
+    @return true if the cgroup is empty, false otherwise.
+*/
+bool cgroup_empty(int i);
+
+#endif // CGROUP_H
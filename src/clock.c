@@ -0,0 +1,112 @@
+/**
+    @file clock.c
+    @brief Process Watchdog Application Manager
+
+    The Process Watchdog application manages the processes listed in the configuration file.
+    It listens to a specified UDP port for heartbeat messages from these processes, which must
+    periodically send their PID. If any process stops running or fails to send its PID over UDP
+    within the expected interval, the Process Watchdog application will restart the process.
+
+    The application ensures high reliability and availability by continuously monitoring and
+    restarting processes as necessary. It also logs various statistics about the monitored
+    processes, including start times, crash times, and heartbeat intervals.
+
+    @date 2023-01-01
+    @version 1.0
+    @author by Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license GPL-3 License
+*/
+
+#include "clock.h"
+
+/**
+    @brief Structure representing a clock implementation.
+*/
+typedef struct
+{
+    clk_t (*ms)(void); /**< Monotonic time in milliseconds. */
+    time_t (*time)(void); /**< Seconds since the epoch. */
+    long (*uptime)(void); /**< System uptime in seconds. */
+    void (*sleep_ms)(int ms); /**< Sleep for the given milliseconds. */
+} Clock_t;
+
+#define SIM_BASE_MS ((clk_t)3600 * 1000) // monotonic time when the simulation starts
+#define SIM_BASE_TIME ((time_t)1672531200) // wall clock time when the simulation starts, 2023-01-01 00:00:00 UTC
+#define SIM_BASE_UPTIME 3600L // uptime when the simulation starts
+
+static clk_t sim_base_ms; // monotonic time when the simulation started
+static time_t sim_base_time; // wall clock time when the simulation started
+static long sim_base_uptime; // uptime when the simulation started
+static clk_t sim_elapsed_ms; // virtual time elapsed since the simulation started
+
+static time_t real_time(void)
+{
+    return time(NULL);
+}
+
+static clk_t sim_ms(void)
+{
+    return sim_base_ms + sim_elapsed_ms;
+}
+
+static time_t sim_time(void)
+{
+    return sim_base_time + (time_t)(sim_elapsed_ms / 1000);
+}
+
+static long sim_uptime(void)
+{
+    return sim_base_uptime + (long)(sim_elapsed_ms / 1000);
+}
+
+static void sim_sleep_ms(int ms)
+{
+    if(ms > 0)
+    {
+        sim_elapsed_ms += ms;
+    }
+}
+
+static const Clock_t real_clock = { time_ms, real_time, get_uptime, delay_ms };
+static const Clock_t sim_clock = { sim_ms, sim_time, sim_uptime, sim_sleep_ms };
+static const Clock_t *clock_impl = &real_clock;
+
+clk_t clock_ms(void)
+{
+    return clock_impl->ms();
+}
+
+time_t clock_time(void)
+{
+    return clock_impl->time();
+}
+
+long clock_uptime(void)
+{
+    return clock_impl->uptime();
+}
+
+void clock_sleep_ms(int ms)
+{
+    clock_impl->sleep_ms(ms);
+}
+
+void clock_simulate(bool enable)
+{
+    if(enable && clock_impl != &sim_clock)
+    {
+        // Fixed, so that a simulation does not depend on the host
+        sim_base_ms = SIM_BASE_MS;
+        sim_base_time = SIM_BASE_TIME;
+        sim_base_uptime = SIM_BASE_UPTIME;
+        sim_elapsed_ms = 0;
+    }
+
+    clock_impl = enable ? &sim_clock : &real_clock;
+}
+
+bool clock_simulated(void)
+{
+    return clock_impl == &sim_clock;
+}
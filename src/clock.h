@@ -0,0 +1,77 @@
+/**
+    @file clock.h
+    @brief Process Watchdog Application Manager
+
+    The Process Watchdog application manages the processes listed in the configuration file.
+    It listens to a specified UDP port for heartbeat messages from these processes, which must
+    periodically send their PID. If any process stops running or fails to send its PID over UDP
+    within the expected interval, the Process Watchdog application will restart the process.
+
+    The application ensures high reliability and availability by continuously monitoring and
+    restarting processes as necessary. It also logs various statistics about the monitored
+    processes, including start times, crash times, and heartbeat intervals.
+
+    @date 2023-01-01
+    @version 1.0
+    @author by Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license GPL-3 License
+*/
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include "utils.h"
+
+/**
+    @file clock.h
+    @brief Clock interface for all time and sleep calls of the watchdog.
+
+    The real clock reads the system clocks and sleeps. The simulated clock starts from the
+    current real values and only advances when a sleep is requested, which returns at once.
+    This lets the supervisor logic run against scripted children faster than real time.
+*/
+
+/**
+    @brief Gets the monotonic time.
+
+    @return Monotonic time in milliseconds.
+*/
+clk_t clock_ms(void);
+
+/**
+    @brief Gets the wall clock time, replaces time(NULL).
+
+    @return Seconds since the epoch.
+*/
+time_t clock_time(void);
+
+/**
+    @brief Gets the system uptime, replaces get_uptime().
+
+    @return System uptime in seconds.
+*/
+long clock_uptime(void);
+
+/**
+    @brief Sleeps for the specified time, the simulated clock advances instead.
+
+    @param ms Number of milliseconds to sleep.
+*/
+void clock_sleep_ms(int ms);
+
+/**
+    @brief Switches between the real and the simulated clock.
+
+    @param enable true to use the simulated clock, false to use the real clock.
+*/
+void clock_simulate(bool enable);
+
+/**
+    @brief Checks if the simulated clock is in use.
+
+    @return true if the clock is simulated, false otherwise.
+*/
+bool clock_simulated(void);
+
+#endif // CLOCK_H
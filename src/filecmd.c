@@ -28,6 +28,7 @@ typedef enum
     fc_START = 0,
     fc_STOP,
     fc_RESTART,
+    fc_ROLLOUT,
     fc_END
 } action_t;
 
@@ -36,6 +37,7 @@ static const char *prefixes[] =
     "start",
     "stop",
     "restart",
+    "rollout",
     0
 };
 
@@ -44,7 +46,9 @@ static void get_file_name(action_t action, int i, char *out)
     char *p;
     p = out;
     p = pstrcpy(p, prefixes[action]);
-    strncpy(p, get_app_name(i), MAX_APP_NAME_LENGTH);
+    // A rollout is requested for the whole pool of an instance
+    const char *name = (fc_ROLLOUT == action && 0 < get_instance_count(i)) ? get_pool_name(i) : get_app_name(i);
+    strncpy(p, name, MAX_APP_NAME_LENGTH);
     toLower(out);
 }
 
@@ -84,6 +88,11 @@ bool filecmd_restart(int i)
     return is_file_exist(fc_RESTART, i);
 }
 
+bool filecmd_rollout(int i)
+{
+    return is_file_exist(fc_ROLLOUT, i);
+}
+
 void filecmd_remove_start(int i)
 {
     if(filecmd_start(i))
@@ -108,6 +117,14 @@ void filecmd_remove_restart(int i)
     }
 }
 
+void filecmd_remove_rollout(int i)
+{
+    if(filecmd_rollout(i))
+    {
+        remove_file(fc_ROLLOUT, i);
+    }
+}
+
 void filecmd_create_start(int i)
 {
     if(!filecmd_start(i))
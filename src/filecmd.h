@@ -34,6 +34,7 @@
 #define FILECMD_STOPAPP     "wdtstop" /**< Command to stop all apps and then itself. */
 #define FILECMD_RESTARTAPP  "wdtrestart" /**< Command to stop all apps and restart itself. */
 #define FILECMD_REBOOT      "wdtreboot" /**< Command to stop all apps and reboot the OS. */
+#define FILECMD_UPGRADE     "wdtupgrade" /**< Command to re-execute its binary in place, keeping all apps running. */
 
 /**
     @brief File commands for controlling application lifecycle based on an application's name specified in the ini file:
@@ -44,6 +45,8 @@
     - startbot: If the "bot" application is not currently running, this command will start it. Upon successful start, the "startbot" file will be removed.
 
     - restartbot: Restarts the "bot" application if it is already running. The "restartbot" file will be removed after the restart operation is completed.
+
+    - rolloutbot: Restarts the instances of the pool "bot" one batch at a time, see rollout.h. The "rolloutbot" file will be removed when the rolling restart begins.
 */
 
 /**
@@ -70,6 +73,14 @@ bool filecmd_stop(int i);
 */
 bool filecmd_restart(int i);
 
+/**
+    @brief Checks if the file command to restart the pool of an application one batch at a time exists.
+
+    @param i Index of the application.
+    @return true if the file command exists, false otherwise.
+*/
+bool filecmd_rollout(int i);
+
 /**
     @brief Removes the file command to start an application if it exists.
 
@@ -91,6 +102,13 @@ void filecmd_remove_stop(int i);
 */
 void filecmd_remove_restart(int i);
 
+/**
+    @brief Removes the file command to restart the pool of an application one batch at a time if it exists.
+
+    @param i Index of the application.
+*/
+void filecmd_remove_rollout(int i);
+
 /**
     @brief Creates the file command to start an application if it does not exist.
 
@@ -39,6 +39,7 @@ const char *log_levels[] =
 };
 
 static pthread_mutex_t syslog_lock = PTHREAD_MUTEX_INITIALIZER; // mutex
+static volatile bool file_output = true; // runtime switch of the file log
 
 void syslog_mutex_lock()
 {
@@ -50,6 +51,11 @@ void syslog_mutex_unlock()
     pthread_mutex_unlock(&syslog_lock);
 }
 
+void log_file_output(bool enable)
+{
+    file_output = enable;
+}
+
 #if DEBUG_LOG && (DEBUG_LOG_LEVEL_ERROR || DEBUG_LOG_LEVEL_WARNING || DEBUG_LOG_LEVEL_INFO || DEBUG_LOG_LEVEL_DEBUG)
 
 #if DEBUG_LOG_TABLE_VIEW
@@ -134,7 +140,7 @@ void iLOG(const char *function, const char *location, log_priority_t type, const
     fflush(fp);
 #if DEBUG_LOG_LEVEL_FILE
 
-    if(type <= FILE_LOG_LEVEL)
+    if(file_output && type <= FILE_LOG_LEVEL)
     {
         static int file_check = 100;
 
@@ -151,7 +157,7 @@ void iLOG(const char *function, const char *location, log_priority_t type, const
             }
         }
 
-        fp = fopen(DEBUG_LOG_FILENAME, "a");
+        fp = fopen(DEBUG_LOG_FILENAME, "ae");
 
         if(fp != NULL)
         {
@@ -243,7 +249,7 @@ void iLOG(const char *function, const char *location, log_priority_t type, const
         fflush(fp);
 #if DEBUG_LOG_LEVEL_FILE
 
-        if(type <= FILE_LOG_LEVEL)
+        if(file_output && type <= FILE_LOG_LEVEL)
         {
             static int file_check = 100;
 
@@ -260,7 +266,7 @@ void iLOG(const char *function, const char *location, log_priority_t type, const
                 }
             }
 
-            fp = fopen(DEBUG_LOG_FILENAME, "a");
+            fp = fopen(DEBUG_LOG_FILENAME, "ae");
 
             if(fp != NULL)
             {
@@ -91,6 +91,13 @@ typedef enum
 
 void iLOG(const char *function, const char *location, log_priority_t type, const char *format, ...);
 
+/**
+    @brief Enables or disables the file log at runtime, it is enabled by default when DEBUG_LOG_LEVEL_FILE is 1.
+
+    @param enable true to write into DEBUG_LOG_FILENAME, false to log only into stdout/stderr.
+*/
+void log_file_output(bool enable);
+
 // LOG Levels
 // -----------------------------------------------------------------------------
 #if DEBUG_LOG && DEBUG_LOG_LEVEL_ERROR
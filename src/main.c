@@ -19,9 +19,19 @@
 */
 
 #include "server.h"
+#include "activation.h"
 #include "apps.h"
+#include "cgroup.h"
 #include "filecmd.h"
+#include "monitor.h"
+#include "phi.h"
+#include "placement.h"
+#include "rollout.h"
+#include "state.h"
+#include "upgrade.h"
 #include "stats.h"
+#include "trace.h"
+#include "zygote.h"
 #include "test.h"
 #include "log.h"
 #include "utils.h"
@@ -36,115 +46,6 @@
 
 #define SOCKET_TIMEOUT  500 // [ms] poll timeout to wait for a UDP message blocking
 
-void parse_commands(char *data, int length)
-{
-    switch(data[0])
-    {
-        case 'p': // pid heartbeat : p<pid> ? p1234
-        {
-            int n = parse_number(data, length, NULL);
-            LOGD("Heartbeat command received from pid %d : %s", n, data);
-
-            if(0 < n && INT32_MAX > n)
-            {
-                int i = find_pid(n);
-
-                if(i >= 0)
-                {
-                    time_t t = get_heartbeat_time(i);
-
-                    if(get_first_heartbeat(i))
-                    {
-                        if(t >= 0)
-                        {
-                            LOGD("%s heartbeat after %d seconds", get_app_name(i), t);
-                            stats_update_heartbeat_time(i, t);
-                        }
-                    }
-                    else
-                    {
-                        LOGD("%s first heartbeat after %d seconds", get_app_name(i), t);
-                        stats_update_first_heartbeat_time(i, t);
-                        set_first_heartbeat(i);
-                    }
-
-                    update_heartbeat_time(i);
-                }
-            }
-            else
-            {
-                LOGE("Invalid pid received, pid %d : %s", n, data);
-            }
-        }
-        break;
-#if 0 // feature disabled
-
-        case 'a': // stArt : a<name> ? aBot
-        {
-            LOGD("Start command received: %s", data);
-            char name[MAX_APP_NAME_LENGTH];
-            strncpy(name, &data[1], MAX_APP_NAME_LENGTH - 1);
-
-            for(int i = 0; i < get_app_count(); i++)
-            {
-                if(0 == strncmp(get_app_name(i), name, MAX_APP_NAME_LENGTH - 1))
-                {
-                    if(!is_application_started(i))
-                    {
-                        start_application(i);
-                        filecmd_remove_start(i);
-                    }
-                }
-            }
-        }
-        break;
-
-        case 'o': // stOp : o<name> ? oBot
-        {
-            LOGD("Stop command received: %s", data);
-            char name[MAX_APP_NAME_LENGTH];
-            strncpy(name, &data[1], MAX_APP_NAME_LENGTH - 1);
-
-            for(int i = 0; i < get_app_count(); i++)
-            {
-                if(0 == strncmp(get_app_name(i), name, MAX_APP_NAME_LENGTH - 1))
-                {
-                    if(is_application_running(i))
-                    {
-                        kill_application(i);
-                        filecmd_create_stop(i);
-                    }
-                }
-            }
-        }
-        break;
-
-        case 'r': // Restart : r<name> ? rBot
-        {
-            LOGD("Restart command received: %s", data);
-            char name[MAX_APP_NAME_LENGTH];
-            strncpy(name, &data[1], MAX_APP_NAME_LENGTH - 1);
-
-            for(int i = 0; i < get_app_count(); i++)
-            {
-                if(0 == strncmp(get_app_name(i), name, MAX_APP_NAME_LENGTH - 1))
-                {
-                    restart_application(i);
-                    filecmd_remove_restart(i);
-                }
-            }
-        }
-        break;
-#endif
-
-        default:
-        {
-            LOGE("Unknown command received : %s", data);
-        }
-        break;
-    }
-}
-
 //------------------------------------------------------------------
 
 extern char *optarg;
@@ -158,6 +59,8 @@ extern int opterr, optind;
 static volatile int kill_error = 10; // after 10 times SIGUSR1 the app exits forcefully
 static volatile bool main_alive = true; // terminate application
 static volatile int return_code = EXIT_NORMALLY;
+static volatile bool main_reload = false; // reload the ini file
+static volatile bool main_upgrade = false; // re-execute the binary in place
 
 // send signal INT to restart application
 void SIGINT_handler(int sig)
@@ -196,11 +99,69 @@ void SIGUSR1_handler(int sig)
     }
 }
 
-// rfu
+// send signal HUP to reload the ini file
+void SIGHUP_handler(int sig)
+{
+    UNUSED(sig);
+    main_reload = true;
+}
+
+// send signal USR2 to upgrade the application in place
 void SIGUSR2_handler(int sig)
 {
     UNUSED(sig);
-    LOGN("USR2 detected");
+    main_upgrade = true;
+}
+
+// Applies a reload of the ini file to the cgroups, statistics and placement of the applications
+static void reload_config(void)
+{
+    if(reload_ini_file())
+    {
+        LOGE("Reloading the ini file failed, the applications are not changed");
+        return;
+    }
+
+    for(int i = 0; i < get_app_count(); i++)
+    {
+        switch(get_app_change(i))
+        {
+            case APP_ADDED:
+                activation_open(i);
+                phi_reset(i);
+                stats_read_from_file(i);
+                cgroup_create(i, get_cpu_max(i), get_memory_max(i), get_io_weight(i));
+                trace_app_renamed(i);
+                trace_app_phase(i, TRACE_PHASE_START_DELAY);
+                break;
+
+            case APP_RESTARTED:
+                activation_close(i, true);
+
+                // Opened once the old process has released them otherwise
+                if(!is_application_stopping(i))
+                {
+                    activation_open(i);
+                }
+
+                phi_reset(i);
+                cgroup_update(i, get_cpu_max(i), get_memory_max(i), get_io_weight(i));
+                break;
+
+            case APP_LIMITS_CHANGED:
+                cgroup_update(i, get_cpu_max(i), get_memory_max(i), get_io_weight(i));
+                break;
+
+            case APP_REMOVED:
+                activation_close(i, true);
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    placement_start();
 }
 
 void usage(char *progname, int opt)
@@ -223,9 +184,11 @@ void help(char *progname)
             "- start<app>\n"
             "- stop<app>\n"
             "- restart<app>\n"
+            "- rollout<pool>\n"
             "- " FILECMD_STOPAPP "\n"
             "- " FILECMD_RESTARTAPP "\n"
-            "- " FILECMD_REBOOT "\n");
+            "- " FILECMD_REBOOT "\n"
+            "- " FILECMD_UPGRADE "\n");
     fprintf(stderr, GREEN "\nINI File example config:\n" RESET
             "[processWatchdog]\n"
             "udp_port = 12345\n"
@@ -266,7 +229,8 @@ int main(int argc, char *argv[])
     signal(SIGTERM, SIGINT_handler); // terminate
     signal(SIGQUIT, SIGQUIT_handler); // reboot
     signal(SIGUSR1, SIGUSR1_handler); // terminate
-    signal(SIGUSR2, SIGUSR2_handler); // rfu
+    signal(SIGUSR2, SIGUSR2_handler); // upgrade
+    signal(SIGHUP, SIGHUP_handler); // reload
 
     // Scan parameters
     while((opt = getopt(argc, argv, OPTSTR)) != EOF)
@@ -303,10 +267,12 @@ int main(int argc, char *argv[])
     }
 
     LOGN("%s started v:%s", APPNAME, VERSION);
+    upgrade_init(argv);
 
     // Read config
     if(read_ini_file())
     {
+        upgrade_rollback();
         exit(EXIT_NORMALLY);
     }
 
@@ -316,13 +282,72 @@ int main(int argc, char *argv[])
         stats_read_from_file(i);
     }
 
+    // Start lifecycle trace export
+    if(0 < strlen(get_trace_file()) && 0 == trace_start(get_trace_file(), upgrade_resuming()))
+    {
+        for(int i = 0; i < get_app_count(); i++)
+        {
+            trace_app_phase(i, TRACE_PHASE_START_DELAY);
+        }
+    }
+
+    // Adopt the applications left running by the previous watchdog or image
+    if(upgrade_resuming())
+    {
+        if(0 > upgrade_restore())
+        {
+            upgrade_rollback();
+        }
+    }
+    else if(0 < strlen(get_state_file()))
+    {
+        state_restore(get_state_file());
+    }
+
+    // Open the sockets passed to the applications, the adopted ones hand theirs over
+    activation_start();
+
+    // Place the applications in cgroups
+    if(0 == cgroup_start(get_cgroup_root()))
+    {
+        for(int i = 0; i < get_app_count(); i++)
+        {
+            cgroup_create(i, get_cpu_max(i), get_memory_max(i), get_io_weight(i));
+        }
+    }
+    else
+    {
+        for(int i = 0; i < get_app_count(); i++)
+        {
+            if(0 < strlen(get_cpu_max(i)) || 0 < strlen(get_memory_max(i)) || 0 < get_io_weight(i))
+            {
+                LOGW("cgroup limits of %s are not applied, applications run in process groups", get_app_name(i));
+            }
+        }
+    }
+
+    // Prepare the CPU and NUMA placement
+    placement_start();
+
     // data buffer
     char data[MAX_APP_CMD_LENGTH];
     int length;
+    int watch[UDP_MAX_WATCHED];
     // Start UDP server
     int socket;
 
-    if(udp_start(&socket, get_udp_port()))
+    if(upgrade_resuming())
+    {
+        socket = upgrade_socket();
+
+        if(udp_adopt(socket, get_udp_port()))
+        {
+            upgrade_rollback();
+            udp_stop(socket);
+            exit(EXIT_RESTART);
+        }
+    }
+    else if(udp_start(&socket, get_udp_port()))
     {
         LOGE("UDP start failed");
         udp_stop(socket);
@@ -332,8 +357,9 @@ int main(int argc, char *argv[])
     // Loop here until exit signal arrived
     while(main_alive)
     {
-        // Poll UDP messages
+        // Poll UDP messages, a connection to an application started on demand wakes up the poll too
         length = sizeof(data) - 1;
+        udp_watch(watch, monitor_sockets(watch, UDP_MAX_WATCHED));
 
         if(udp_poll(socket, SOCKET_TIMEOUT, data, &length))
         {
@@ -354,57 +380,10 @@ int main(int argc, char *argv[])
         }
 
         // Scan applications
-        for(int i = 0; i < get_app_count(); i++)
-        {
-            if(is_application_started(i))
-            {
-                // Update stats files periodically (15 mins)
-                if((get_uptime() % (15 * 60)) == 0)
-                {
-                    stats_write_to_file(i);
-                    stats_print_to_file(i);
-                }
+        monitor_applications();
 
-                if(!is_application_running(i))
-                {
-                    LOGE("Process %s has crashed, restarting", get_app_name(i));
-                    stats_crashed_at(i);
-                    restart_application(i);
-                }
-                else if(is_timeup(i))
-                {
-                    LOGE("Process %s has not sent a heartbeat in time, restarting", get_app_name(i));
-                    stats_heartbeat_reset_at(i);
-                    restart_application(i);
-                }
-                else if(filecmd_stop(i))
-                {
-                    LOGN("Process %s has stopped by file command", get_app_name(i));
-                    kill_application(i);
-                }
-                else if(filecmd_restart(i))
-                {
-                    LOGN("Process %s has restarted by file command", get_app_name(i));
-                    restart_application(i);
-                    filecmd_remove_restart(i);
-                }
-            }
-            else
-            {
-                if(!filecmd_stop(i) && (filecmd_start(i) || is_application_start_time(i)))
-                {
-                    start_application(i);
-
-                    if(is_application_started(i))
-                    {
-                        LOGN("Process %s has started", get_app_name(i));
-                        stats_started_at(i);
-                        filecmd_remove_start(i);
-                        filecmd_remove_restart(i);
-                    }
-                }
-            }
-        }
+        // The new image is healthy once it has scanned the applications
+        upgrade_commit();
 
         // Check for general purpose file commands
         if(filecmd_exists(FILECMD_STOPAPP))
@@ -426,29 +405,45 @@ int main(int argc, char *argv[])
             return_code = EXIT_REBOOT;
         }
 
-#if 0 // feature disabled
-
-        // Check if ini updated and re-read
-        if(is_ini_updated())
+        // Upgrade in place, a running rollout is finished first
+        if(!rollout_running() && (main_upgrade || filecmd_exists(FILECMD_UPGRADE)))
         {
-            if(read_ini_file())
-            {
-                exit(EXIT_RESTART);
-            }
+            main_upgrade = false;
+            upgrade_exec(socket);
         }
 
-#endif
+        // Check if ini updated and re-read, a running rollout is finished first
+        if((main_reload || is_ini_updated()) && !rollout_running())
+        {
+            main_reload = false;
+            reload_config();
+        }
     }
 
     LOGD("%s ending...", APPNAME);
     // Stop UDP server
     udp_stop(socket);
 
+    // Hand the running applications over to the next watchdog instead of stopping them
+    bool handover = (EXIT_RESTART == return_code && 0 < strlen(get_state_file()) && 0 < state_save(get_state_file()));
+
     for(int i = 0; i < get_app_count(); i++)
     {
+        // The processes of a removed application may still be terminating
+        if(is_application_removed(i) && !is_application_stopping(i))
+        {
+            continue;
+        }
+
         // Update stats files
         stats_write_to_file(i);
         stats_print_to_file(i);
+
+        if(handover && state_saved(i))
+        {
+            continue;
+        }
+
         // Kill running applications
         kill_application(i);
 
@@ -458,6 +453,10 @@ int main(int argc, char *argv[])
         }
     }
 
+    zygote_stop();
+    activation_stop(!handover);
+    cgroup_stop();
+    trace_stop();
     LOGN("%s ended with return code %d", APPNAME, return_code);
     return return_code;
 }
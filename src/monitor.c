@@ -0,0 +1,361 @@
+/**
+    @file monitor.c
+    @brief Process Watchdog Application Manager
+
+    The Process Watchdog application manages the processes listed in the configuration file.
+    It listens to a specified UDP port for heartbeat messages from these processes, which must
+    periodically send their PID. If any process stops running or fails to send its PID over UDP
+    within the expected interval, the Process Watchdog application will restart the process.
+
+    The application ensures high reliability and availability by continuously monitoring and
+    restarting processes as necessary. It also logs various statistics about the monitored
+    processes, including start times, crash times, and heartbeat intervals.
+
+    @date 2023-01-01
+    @version 1.0
+    @author by Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license GPL-3 License
+*/
+
+#include "monitor.h"
+#include "activation.h"
+#include "apps.h"
+#include "clock.h"
+#include "filecmd.h"
+#include "phi.h"
+#include "resource.h"
+#include "rollout.h"
+#include "stats.h"
+#include "log.h"
+#include "utils.h"
+#include "zygote.h"
+
+// Finds the value of a KEY=VALUE field of a heartbeat, e.g. p1234 ACTIVE=1, NULL if it is missing
+static const char *heartbeat_field(const char *data, const char *key)
+{
+    size_t length = strlen(key);
+    const char *field = strchr(data, ' ');
+
+    while(NULL != field)
+    {
+        field++;
+
+        if(0 == strncmp(field, key, length) && '=' == field[length])
+        {
+            return field + length + 1;
+        }
+
+        field = strchr(field, ' ');
+    }
+
+    return NULL;
+}
+
+// Checks a KEY=1 flag of a heartbeat
+static bool heartbeat_flag(const char *data, const char *key)
+{
+    const char *value = heartbeat_field(data, key);
+    return NULL != value && '1' == value[0];
+}
+
+// An application started on demand waits for a connection or a datagram on its sockets
+static bool is_activated(int i)
+{
+    return !is_on_demand(i) || 0 == activation_count(i) || activation_pending(i);
+}
+
+void parse_commands(char *data, int length)
+{
+    switch(data[0])
+    {
+        case 'p': // pid heartbeat : p<pid> ? p1234
+        {
+            int n = parse_number(data, length, NULL);
+            LOGD("Heartbeat command received from pid %d : %s", n, data);
+
+            if(0 < n && INT32_MAX > n)
+            {
+                int i = find_pid(n);
+
+                if(i >= 0)
+                {
+                    time_t t = get_heartbeat_time(i);
+
+                    if(get_first_heartbeat(i))
+                    {
+                        if(t >= 0)
+                        {
+                            LOGD("%s heartbeat after %d seconds", get_app_name(i), t);
+                            stats_update_heartbeat_time(i, t);
+                        }
+
+                        // A pause requested with NEXT is not a sample of the usual intervals
+                        if(0 < get_phi_threshold(i) && !is_next_heartbeat_requested(i))
+                        {
+                            phi_heartbeat(i, clock_ms() - get_heartbeat_ms(i));
+                        }
+                    }
+                    else if(!is_ready_notify(i) || heartbeat_flag(data, "READY"))
+                    {
+                        t = get_startup_time(i);
+                        LOGD("%s ready after %d seconds", get_app_name(i), t);
+                        stats_update_first_heartbeat_time(i, t);
+                        set_first_heartbeat(i);
+                    }
+                    else
+                    {
+                        LOGD("%s is starting, heartbeat after %d seconds", get_app_name(i), t);
+                    }
+
+                    update_heartbeat_time(i);
+                    const char *next = heartbeat_field(data, "NEXT");
+
+                    if(NULL != next)
+                    {
+                        set_next_heartbeat(i, strtol(next, NULL, 10));
+                    }
+
+                    if(heartbeat_flag(data, "ACTIVE"))
+                    {
+                        update_activity_time(i);
+                    }
+                }
+                else if(0 <= (i = find_spare(n)) && (!is_ready_notify(i) || heartbeat_flag(data, "READY")))
+                {
+                    LOGD("Spare of %s is ready", get_app_name(i));
+                    set_spare_ready(i);
+                }
+            }
+            else
+            {
+                LOGE("Invalid pid received, pid %d : %s", n, data);
+            }
+        }
+        break;
+#if 0 // feature disabled
+
+        case 'a': // stArt : a<name> ? aBot
+        {
+            LOGD("Start command received: %s", data);
+            char name[MAX_APP_NAME_LENGTH];
+            strncpy(name, &data[1], MAX_APP_NAME_LENGTH - 1);
+
+            for(int i = 0; i < get_app_count(); i++)
+            {
+                if(0 == strncmp(get_app_name(i), name, MAX_APP_NAME_LENGTH - 1))
+                {
+                    if(!is_application_started(i))
+                    {
+                        start_application(i);
+                        filecmd_remove_start(i);
+                    }
+                }
+            }
+        }
+        break;
+
+        case 'o': // stOp : o<name> ? oBot
+        {
+            LOGD("Stop command received: %s", data);
+            char name[MAX_APP_NAME_LENGTH];
+            strncpy(name, &data[1], MAX_APP_NAME_LENGTH - 1);
+
+            for(int i = 0; i < get_app_count(); i++)
+            {
+                if(0 == strncmp(get_app_name(i), name, MAX_APP_NAME_LENGTH - 1))
+                {
+                    if(is_application_running(i))
+                    {
+                        stop_application(i, STOP_HALT);
+                        filecmd_create_stop(i);
+                    }
+                }
+            }
+        }
+        break;
+
+        case 'r': // Restart : r<name> ? rBot
+        {
+            LOGD("Restart command received: %s", data);
+            char name[MAX_APP_NAME_LENGTH];
+            strncpy(name, &data[1], MAX_APP_NAME_LENGTH - 1);
+
+            for(int i = 0; i < get_app_count(); i++)
+            {
+                if(0 == strncmp(get_app_name(i), name, MAX_APP_NAME_LENGTH - 1))
+                {
+                    restart_application(i);
+                    filecmd_remove_restart(i);
+                }
+            }
+        }
+        break;
+#endif
+
+        default:
+        {
+            LOGE("Unknown command received : %s", data);
+        }
+        break;
+    }
+}
+
+void monitor_applications(void)
+{
+    const char *limit;
+    resource_sample(get_sample_interval());
+
+    for(int i = 0; i < get_app_count(); i++)
+    {
+        if(is_application_removed(i) && !is_application_stopping(i))
+        {
+            continue;
+        }
+
+        zygote_update(i);
+
+        // Stopped without waiting for a restart, a rollout or a reload, continued once its processes have exited
+        if(is_application_stopping(i))
+        {
+            update_stop(i);
+            continue;
+        }
+
+        update_spare(i);
+
+        if(is_application_started(i))
+        {
+            // Update stats files periodically (15 mins)
+            if((clock_uptime() % (15 * 60)) == 0)
+            {
+                stats_write_to_file(i);
+                stats_print_to_file(i);
+            }
+
+            if(is_restart_pending(i))
+            {
+                if(filecmd_stop(i))
+                {
+                    LOGN("Process %s has stopped by file command", get_app_name(i));
+                    cancel_restart(i);
+                }
+                else if(is_restart_time(i))
+                {
+                    start_application(i);
+
+                    if(!is_application_running(i))
+                    {
+                        schedule_restart(i);
+                    }
+                }
+            }
+            else if(!is_application_running(i))
+            {
+                if(is_crash_loop(i))
+                {
+                    LOGD("Process %s has crashed, restarting", get_app_name(i));
+                }
+                else
+                {
+                    LOGE("Process %s has crashed, restarting", get_app_name(i));
+                }
+
+                stats_crashed_at(i);
+
+                if(!promote_spare(i))
+                {
+                    schedule_restart(i);
+                }
+            }
+            else if(is_timeup(i))
+            {
+                LOGE("Process %s has not sent a heartbeat in time, restarting", get_app_name(i));
+                stats_heartbeat_reset_at(i);
+
+                if(!promote_spare(i))
+                {
+                    schedule_restart(i);
+                }
+            }
+            else if(is_ready_late(i))
+            {
+                // A spare is started once the application is ready, there is none to promote
+                LOGE("Process %s has not become ready within %d seconds, restarting", get_app_name(i), get_ready_timeout(i));
+                stats_heartbeat_reset_at(i);
+                schedule_restart(i);
+            }
+            else if(NULL != (limit = resource_limit_exceeded(i)))
+            {
+                LOGE("Process %s has exceeded its %s limit, restarting", get_app_name(i), limit);
+                stats_resource_reset_at(i);
+
+                if(!promote_spare(i))
+                {
+                    schedule_restart(i);
+                }
+            }
+            else if(0 < activation_count(i) && is_idle(i))
+            {
+                LOGN("Process %s has been idle for %d seconds, stopping until the next connection", get_app_name(i),
+                     get_idle_timeout(i));
+                stop_application(i, STOP_HALT);
+            }
+            else if(filecmd_stop(i))
+            {
+                LOGN("Process %s has stopped by file command", get_app_name(i));
+                stop_application(i, STOP_HALT);
+            }
+            else if(filecmd_restart(i))
+            {
+                LOGN("Process %s has restarted by file command", get_app_name(i));
+                restart_application(i);
+                filecmd_remove_restart(i);
+            }
+            else
+            {
+                update_restart_backoff(i);
+            }
+        }
+        else
+        {
+            if(!filecmd_stop(i) && (filecmd_start(i) || (is_application_start_time(i) && is_activated(i))))
+            {
+                start_application(i);
+
+                if(is_application_started(i))
+                {
+                    LOGN("Process %s has started%s", get_app_name(i), is_on_demand(i) ? " on demand" : "");
+                    stats_started_at(i);
+                    filecmd_remove_start(i);
+                    filecmd_remove_restart(i);
+                }
+                else
+                {
+                    schedule_restart(i);
+                }
+            }
+        }
+    }
+
+    // Rolling restarts requested by file command
+    rollout_update();
+}
+
+int monitor_sockets(int *fds, int max)
+{
+    int count = 0;
+
+    for(int i = 0; i < get_app_count() && count < max; i++)
+    {
+        if(!is_application_removed(i) && is_on_demand(i) && !is_application_started(i) && !filecmd_stop(i) &&
+                is_application_start_time(i))
+        {
+            count += activation_fds(i, fds + count, max - count);
+        }
+    }
+
+    // A reply or the exit of a zygote wakes up the loop too
+    count += zygote_fds(fds + count, max - count);
+    return count;
+}
@@ -0,0 +1,60 @@
+/**
+    @file monitor.h
+    @brief Process Watchdog Application Manager
+
+    The Process Watchdog application manages the processes listed in the configuration file.
+    It listens to a specified UDP port for heartbeat messages from these processes, which must
+    periodically send their PID. If any process stops running or fails to send its PID over UDP
+    within the expected interval, the Process Watchdog application will restart the process.
+
+    The application ensures high reliability and availability by continuously monitoring and
+    restarting processes as necessary. It also logs various statistics about the monitored
+    processes, including start times, crash times, and heartbeat intervals.
+
+    @date 2023-01-01
+    @version 1.0
+    @author by Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license GPL-3 License
+*/
+
+#ifndef MONITOR_H
+#define MONITOR_H
+
+/**
+    @file monitor.h
+    @brief Supervisor logic of the main loop : heartbeat commands and the application scan.
+*/
+
+/**
+    @brief Parses and executes a command received over UDP, e.g. the heartbeat p<pid>.
+
+    A heartbeat may carry KEY=VALUE fields after the PID separated by spaces, ACTIVE=1 reports
+    that the application has served requests since its previous heartbeat and READY=1 that an
+    application with readiness notify has completed its initialisation. NEXT=<ms> requests the
+    time until the next heartbeat, bounded by heartbeat_max.
+
+    @param data Null terminated command.
+    @param length Length of the command.
+*/
+void parse_commands(char *data, int length);
+
+/**
+    @brief Scans the applications once, starts, restarts or stops them as needed.
+
+    Called by the main loop after every poll of the UDP server.
+*/
+void monitor_applications(void);
+
+/**
+    @brief Gets the sockets of the applications waiting to be started on demand and the control
+    sockets of the zygotes, the main loop wakes up when a connection, a datagram or a reply is
+    queued on them.
+
+    @param fds Array to store the file descriptors.
+    @param max Size of the array.
+    @return Number of the file descriptors stored.
+*/
+int monitor_sockets(int *fds, int max);
+
+#endif // MONITOR_H
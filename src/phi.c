@@ -0,0 +1,89 @@
+/**
+    @file phi.c
+    @brief Process Watchdog Application Manager
+
+    The Process Watchdog application manages the processes listed in the configuration file.
+    It listens to a specified UDP port for heartbeat messages from these processes, which must
+    periodically send their PID. If any process stops running or fails to send its PID over UDP
+    within the expected interval, the Process Watchdog application will restart the process.
+
+    The application ensures high reliability and availability by continuously monitoring and
+    restarting processes as necessary. It also logs various statistics about the monitored
+    processes, including start times, crash times, and heartbeat intervals.
+
+    @date 2023-01-01
+    @version 1.0
+    @author by Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license GPL-3 License
+*/
+
+#include "phi.h"
+#include "apps.h"
+
+#include <stdint.h>
+#include <math.h>
+
+static uint32_t samples[MAX_APPS][PHI_WINDOW]; // ring buffers of the intervals
+static int heads[MAX_APPS];
+static int counts[MAX_APPS];
+static uint64_t sums[MAX_APPS]; // of the intervals in the window, exact
+static uint64_t squares[MAX_APPS]; // of the squares of the intervals in the window, exact
+
+void phi_reset(int i)
+{
+    heads[i] = 0;
+    counts[i] = 0;
+    sums[i] = 0;
+    squares[i] = 0;
+}
+
+void phi_heartbeat(int i, clk_t interval)
+{
+    uint32_t x = (interval < UINT32_MAX) ? (uint32_t)interval : UINT32_MAX;
+
+    if(counts[i] == PHI_WINDOW)
+    {
+        uint32_t old = samples[i][heads[i]];
+        sums[i] -= old;
+        squares[i] -= (uint64_t)old * old;
+    }
+    else
+    {
+        counts[i]++;
+    }
+
+    samples[i][heads[i]] = x;
+    sums[i] += x;
+    squares[i] += (uint64_t)x * x;
+    heads[i] = (heads[i] + 1) % PHI_WINDOW;
+}
+
+double phi_value(int i, clk_t elapsed)
+{
+    if(counts[i] < PHI_MIN_SAMPLES)
+    {
+        return 0;
+    }
+
+    double mean = (double)sums[i] / counts[i];
+    double variance = (double)squares[i] / counts[i] - mean * mean;
+    double stddev = (variance > 0) ? sqrt(variance) : 0;
+
+    if(stddev < PHI_MIN_STDDEV)
+    {
+        stddev = PHI_MIN_STDDEV;
+    }
+
+    // Logistic approximation of the normal distribution, bounded to stay finite
+    double y = ((double)elapsed - mean) / stddev;
+    y = (y > 20) ? 20 : ((y < -20) ? -20 : y);
+    double e = exp(-y * (1.5976 + 0.070566 * y * y));
+
+    if((double)elapsed > mean)
+    {
+        return -log10(e / (1.0 + e));
+    }
+
+    return -log10(1.0 - 1.0 / (1.0 + e));
+}
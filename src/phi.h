@@ -0,0 +1,66 @@
+/**
+    @file phi.h
+    @brief Process Watchdog Application Manager
+
+    The Process Watchdog application manages the processes listed in the configuration file.
+    It listens to a specified UDP port for heartbeat messages from these processes, which must
+    periodically send their PID. If any process stops running or fails to send its PID over UDP
+    within the expected interval, the Process Watchdog application will restart the process.
+
+    The application ensures high reliability and availability by continuously monitoring and
+    restarting processes as necessary. It also logs various statistics about the monitored
+    processes, including start times, crash times, and heartbeat intervals.
+
+    @date 2023-01-01
+    @version 1.0
+    @author by Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license GPL-3 License
+*/
+
+#ifndef PHI_H
+#define PHI_H
+
+#include "clock.h"
+
+/**
+    @file phi.h
+    @brief Phi accrual failure detector learned from the heartbeats of every application.
+
+    The intervals between the heartbeats of a running application are kept in a sliding
+    window, the suspicion that it has failed grows with the time since its last heartbeat
+    relative to their mean and standard deviation: phi = -log10(P(interval > elapsed)) with a
+    normal distribution. A phi of 1 means a 10% chance of a false suspicion, 2 means 1%, 3
+    means 0.1% and so on. An application heartbeating regularly is suspected shortly after
+    its usual interval, a jittery one only well after it.
+*/
+
+#define PHI_WINDOW 100 /**< Number of the intervals between heartbeats kept for every application. */
+#define PHI_MIN_SAMPLES 10 /**< Number of intervals needed before phi is computed. */
+#define PHI_MIN_STDDEV 100 /**< Minimum standard deviation of the intervals, for the applications heartbeating like a clock (milliseconds). */
+
+/**
+    @brief Clears the intervals learned for the specified application.
+
+    @param i Index of the application.
+*/
+void phi_reset(int i);
+
+/**
+    @brief Adds an interval between two heartbeats of the specified application to its window.
+
+    @param i Index of the application.
+    @param interval Time between the heartbeats (milliseconds).
+*/
+void phi_heartbeat(int i, clk_t interval);
+
+/**
+    @brief Computes the suspicion level of the specified application.
+
+    @param i Index of the application.
+    @param elapsed Time since the last heartbeat of the application (milliseconds).
+    @return Phi, 0 until PHI_MIN_SAMPLES intervals are learned.
+*/
+double phi_value(int i, clk_t elapsed);
+
+#endif // PHI_H
@@ -0,0 +1,523 @@
+/**
+    @file placement.c
+    @brief Process Watchdog Application Manager
+
+    The Process Watchdog application manages the processes listed in the configuration file.
+    It listens to a specified UDP port for heartbeat messages from these processes, which must
+    periodically send their PID. If any process stops running or fails to send its PID over UDP
+    within the expected interval, the Process Watchdog application will restart the process.
+
+    The application ensures high reliability and availability by continuously monitoring and
+    restarting processes as necessary. It also logs various statistics about the monitored
+    processes, including start times, crash times, and heartbeat intervals.
+
+    @date 2023-01-01
+    @version 1.0
+    @author by Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license GPL-3 License
+*/
+
+#include "placement.h"
+#include "apps.h"
+#include "log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/ioprio.h>
+#include <linux/mempolicy.h>
+
+#ifndef SCHED_BATCH
+#define SCHED_BATCH 3
+#endif
+#ifndef SCHED_IDLE
+#define SCHED_IDLE 5
+#endif
+
+#define MASK_BITS (8 * sizeof(unsigned long)) /**< Bits in a word of a mask. */
+
+/**
+    @brief Set of CPUs or NUMA nodes in the layout of the kernel.
+*/
+typedef struct
+{
+    unsigned long bits[MAX_CPUS / MASK_BITS]; /**< Bit n is set if CPU or node n is in the set. */
+} Mask_t;
+
+/**
+    @brief Placement and scheduling class of an application, a setting is skipped if its flag is false.
+*/
+typedef struct
+{
+    bool has_cpus; /**< The CPU affinity is set. */
+    Mask_t cpus; /**< CPU affinity. */
+    bool has_nodes; /**< The NUMA memory policy is set. */
+    int numa_mode; /**< NUMA memory policy, MPOL_BIND, MPOL_PREFERRED or MPOL_INTERLEAVE. */
+    Mask_t nodes; /**< NUMA nodes of the memory policy. */
+    bool has_nice; /**< The nice value is set. */
+    int nice; /**< Nice value. */
+    bool has_ioprio; /**< The I/O priority is set. */
+    int ioprio; /**< I/O scheduling class and level, see ioprio_set(2). */
+    bool has_sched; /**< The scheduling policy is set. */
+    int sched_policy; /**< Scheduling policy. */
+    int sched_priority; /**< Static priority of SCHED_FIFO and SCHED_RR. */
+} Placement_t;
+
+static Placement_t placement[MAX_APPS];
+static Mask_t online_cpus; // CPUs of the system
+static int node_ids[MAX_NUMA_NODES]; // NUMA nodes with CPUs
+static Mask_t node_cpus[MAX_NUMA_NODES]; // online CPUs of every node in node_ids
+static int node_count;
+static bool cpus_saved; // affinity of the watchdog to restore after the spawn
+static Mask_t saved_cpus;
+static bool nodes_saved; // memory policy of the watchdog to restore after the spawn
+static int saved_mode;
+static Mask_t saved_nodes;
+
+static void mask_set(Mask_t *mask, int n)
+{
+    mask->bits[n / MASK_BITS] |= 1UL << (n % MASK_BITS);
+}
+
+static bool mask_isset(const Mask_t *mask, int n)
+{
+    return 0 != (mask->bits[n / MASK_BITS] & (1UL << (n % MASK_BITS)));
+}
+
+static int mask_count(const Mask_t *mask)
+{
+    int count = 0;
+
+    for(int n = 0; n < MAX_CPUS; n++)
+    {
+        count += mask_isset(mask, n) ? 1 : 0;
+    }
+
+    return count;
+}
+
+// Returns the n-th set bit of the mask, -1 if there are less
+static int mask_nth(const Mask_t *mask, int nth)
+{
+    for(int n = 0; n < MAX_CPUS; n++)
+    {
+        if(mask_isset(mask, n) && 0 == nth--)
+        {
+            return n;
+        }
+    }
+
+    return -1;
+}
+
+// Parses a list like "0-3,8,10-11" into the mask, returns 0 on success
+static int parse_list(const char *list, Mask_t *mask, int max)
+{
+    char *end;
+    memset(mask, 0, sizeof(*mask));
+
+    while('\0' != *list && '\n' != *list)
+    {
+        long first = strtol(list, &end, 10);
+        long last = first;
+
+        if(end == list)
+        {
+            return -1;
+        }
+
+        if('-' == *end)
+        {
+            list = end + 1;
+            last = strtol(list, &end, 10);
+
+            if(end == list)
+            {
+                return -1;
+            }
+        }
+
+        if(first < 0 || last < first || max <= last)
+        {
+            return -1;
+        }
+
+        for(long n = first; n <= last; n++)
+        {
+            mask_set(mask, (int)n);
+        }
+
+        list = (',' == *end) ? end + 1 : end;
+
+        if(' ' == *list)
+        {
+            list++;
+        }
+    }
+
+    return 0;
+}
+
+static int read_list(const char *path, Mask_t *mask, int max)
+{
+    char line[1024];
+    FILE *fp = fopen(path, "re");
+
+    if(NULL == fp)
+    {
+        return -1;
+    }
+
+    char *ret = fgets(line, sizeof(line), fp);
+    fclose(fp);
+    return (NULL == ret) ? -1 : parse_list(line, mask, max);
+}
+
+// Reads the online CPUs and the NUMA nodes with CPUs, a system without NUMA support is one node
+static void read_topology(void)
+{
+    char path[64];
+    Mask_t nodes;
+    node_count = 0;
+
+    if(0 != read_list("/sys/devices/system/cpu/online", &online_cpus, MAX_CPUS))
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        memset(&online_cpus, 0, sizeof(online_cpus));
+
+        for(long n = 0; n < cpus && n < MAX_CPUS; n++)
+        {
+            mask_set(&online_cpus, (int)n);
+        }
+    }
+
+    if(0 == read_list("/sys/devices/system/node/online", &nodes, MAX_NUMA_NODES))
+    {
+        for(int node = 0; node < MAX_NUMA_NODES; node++)
+        {
+            Mask_t *cpus = &node_cpus[node_count];
+            snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+
+            if(!mask_isset(&nodes, node) || 0 != read_list(path, cpus, MAX_CPUS))
+            {
+                continue;
+            }
+
+            for(size_t w = 0; w < MAX_CPUS / MASK_BITS; w++)
+            {
+                cpus->bits[w] &= online_cpus.bits[w];
+            }
+
+            if(0 < mask_count(cpus))
+            {
+                node_ids[node_count++] = node;
+            }
+        }
+    }
+
+    if(0 == node_count)
+    {
+        node_ids[0] = 0;
+        node_cpus[0] = online_cpus;
+        node_count = 1;
+    }
+
+    LOGD("%d online CPUs in %d NUMA nodes", mask_count(&online_cpus), node_count);
+}
+
+static int parse_numa_policy(const char *policy)
+{
+    if(0 == strlen(policy) || 0 == strcmp(policy, "bind"))
+    {
+        return MPOL_BIND;
+    }
+    else if(0 == strcmp(policy, "preferred"))
+    {
+        return MPOL_PREFERRED;
+    }
+    else if(0 == strcmp(policy, "interleave"))
+    {
+        return MPOL_INTERLEAVE;
+    }
+
+    return -1;
+}
+
+// Parses "realtime[:level]", "best-effort[:level]" or "idle"
+static int parse_ionice(const char *ionice, int *ioprio)
+{
+    const char *colon = strchr(ionice, ':');
+    size_t length = (NULL != colon) ? (size_t)(colon - ionice) : strlen(ionice);
+    int level = (NULL != colon) ? atoi(colon + 1) : IOPRIO_NORM;
+    int class;
+
+    if(0 == strncmp(ionice, "realtime", length) && 8 == length)
+    {
+        class = IOPRIO_CLASS_RT;
+    }
+    else if(0 == strncmp(ionice, "best-effort", length) && 11 == length)
+    {
+        class = IOPRIO_CLASS_BE;
+    }
+    else if(0 == strncmp(ionice, "idle", length) && 4 == length)
+    {
+        class = IOPRIO_CLASS_IDLE;
+        level = 0;
+    }
+    else
+    {
+        return -1;
+    }
+
+    if(level < 0 || IOPRIO_NR_LEVELS <= level)
+    {
+        return -1;
+    }
+
+    *ioprio = IOPRIO_PRIO_VALUE(class, level);
+    return 0;
+}
+
+// Parses "other", "batch", "idle", "fifo:priority" or "rr:priority"
+static int parse_sched_policy(const char *sched, int *policy, int *priority)
+{
+    const char *colon = strchr(sched, ':');
+    size_t length = (NULL != colon) ? (size_t)(colon - sched) : strlen(sched);
+    *priority = (NULL != colon) ? atoi(colon + 1) : 0;
+
+    if(0 == strncmp(sched, "other", length) && 5 == length)
+    {
+        *policy = SCHED_OTHER;
+    }
+    else if(0 == strncmp(sched, "batch", length) && 5 == length)
+    {
+        *policy = SCHED_BATCH;
+    }
+    else if(0 == strncmp(sched, "idle", length) && 4 == length)
+    {
+        *policy = SCHED_IDLE;
+    }
+    else if(0 == strncmp(sched, "fifo", length) && 4 == length)
+    {
+        *policy = SCHED_FIFO;
+    }
+    else if(0 == strncmp(sched, "rr", length) && 2 == length)
+    {
+        *policy = SCHED_RR;
+    }
+    else
+    {
+        return -1;
+    }
+
+    if(*priority < sched_get_priority_min(*policy) || sched_get_priority_max(*policy) < *priority)
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+// Gives the application the next CPU, the applications are spread over the nodes first
+static void assign_cpu(int i, int nth)
+{
+    int node = nth % node_count;
+    Mask_t *cpus = &node_cpus[node];
+    int cpu = mask_nth(cpus, (nth / node_count) % mask_count(cpus));
+    placement[i].has_cpus = true;
+    mask_set(&placement[i].cpus, cpu);
+    LOGI("Process %s placed on CPU %d of NUMA node %d", get_app_name(i), cpu, node_ids[node]);
+}
+
+// Selects the nodes of the CPUs the application runs on
+static void assign_nodes(int i)
+{
+    for(int node = 0; node < node_count; node++)
+    {
+        for(size_t w = 0; w < MAX_CPUS / MASK_BITS; w++)
+        {
+            if(0 != (node_cpus[node].bits[w] & placement[i].cpus.bits[w]))
+            {
+                mask_set(&placement[i].nodes, node_ids[node]);
+                placement[i].has_nodes = true;
+                break;
+            }
+        }
+    }
+}
+
+int placement_start(void)
+{
+    int count = 0;
+    int spread = 0;
+    memset(placement, 0, sizeof(placement));
+    read_topology();
+
+    for(int i = 0; i < get_app_count(); i++)
+    {
+        if(is_application_removed(i))
+        {
+            continue;
+        }
+
+        Placement_t *p = &placement[i];
+        const char *cpus = get_cpu_affinity(i);
+        const char *nodes = get_numa_nodes(i);
+
+        if(0 == strcmp(cpus, PLACEMENT_AUTO))
+        {
+            assign_cpu(i, spread++);
+        }
+        else if(0 < strlen(cpus))
+        {
+            p->has_cpus = (0 == parse_list(cpus, &p->cpus, MAX_CPUS));
+
+            if(!p->has_cpus)
+            {
+                LOGE("Invalid cpu_affinity of %s : %s", get_app_name(i), cpus);
+            }
+        }
+
+        if(0 == strcmp(nodes, PLACEMENT_AUTO))
+        {
+            if(p->has_cpus)
+            {
+                assign_nodes(i);
+            }
+            else
+            {
+                LOGW("numa_nodes of %s is auto without a cpu_affinity, ignored", get_app_name(i));
+            }
+        }
+        else if(0 < strlen(nodes))
+        {
+            p->has_nodes = (0 == parse_list(nodes, &p->nodes, MAX_NUMA_NODES));
+
+            if(!p->has_nodes)
+            {
+                LOGE("Invalid numa_nodes of %s : %s", get_app_name(i), nodes);
+            }
+        }
+
+        p->numa_mode = parse_numa_policy(get_numa_policy(i));
+
+        if(p->numa_mode < 0)
+        {
+            LOGE("Invalid numa_policy of %s : %s", get_app_name(i), get_numa_policy(i));
+            p->has_nodes = false;
+        }
+
+        if(NICE_INHERIT != get_nice(i))
+        {
+            p->has_nice = true;
+            p->nice = get_nice(i);
+        }
+
+        if(0 < strlen(get_ionice(i)))
+        {
+            p->has_ioprio = (0 == parse_ionice(get_ionice(i), &p->ioprio));
+
+            if(!p->has_ioprio)
+            {
+                LOGE("Invalid ionice of %s : %s", get_app_name(i), get_ionice(i));
+            }
+        }
+
+        if(0 < strlen(get_sched_policy(i)))
+        {
+            p->has_sched = (0 == parse_sched_policy(get_sched_policy(i), &p->sched_policy, &p->sched_priority));
+
+            if(!p->has_sched)
+            {
+                LOGE("Invalid sched_policy of %s : %s", get_app_name(i), get_sched_policy(i));
+            }
+        }
+
+        if(p->has_cpus || p->has_nodes || p->has_nice || p->has_ioprio || p->has_sched)
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+void placement_begin(int i)
+{
+    Placement_t *p = &placement[i];
+
+    if(p->has_cpus)
+    {
+        cpus_saved = (0 < syscall(SYS_sched_getaffinity, 0, sizeof(saved_cpus), &saved_cpus));
+
+        if(0 != syscall(SYS_sched_setaffinity, 0, sizeof(p->cpus), &p->cpus))
+        {
+            LOGW("CPU affinity of %s cannot be set : %s", get_app_name(i), strerror(errno));
+            p->has_cpus = false;
+        }
+    }
+
+    if(p->has_nodes)
+    {
+        nodes_saved = (0 == syscall(SYS_get_mempolicy, &saved_mode, &saved_nodes, MAX_CPUS, NULL, 0));
+
+        if(0 != syscall(SYS_set_mempolicy, p->numa_mode, &p->nodes, MAX_CPUS))
+        {
+            LOGW("NUMA memory policy of %s cannot be set : %s", get_app_name(i), strerror(errno));
+            p->has_nodes = false;
+        }
+    }
+}
+
+void placement_end(int i, int pid)
+{
+    Placement_t *p = &placement[i];
+
+    if(cpus_saved)
+    {
+        syscall(SYS_sched_setaffinity, 0, sizeof(saved_cpus), &saved_cpus);
+        cpus_saved = false;
+    }
+
+    if(nodes_saved)
+    {
+        syscall(SYS_set_mempolicy, saved_mode, &saved_nodes, MAX_CPUS);
+        nodes_saved = false;
+    }
+
+    if(pid <= 0)
+    {
+        return;
+    }
+
+    // The settings failing for lack of privileges are logged once and dropped
+    if(p->has_sched)
+    {
+        struct sched_param param = { .sched_priority = p->sched_priority };
+
+        if(0 != sched_setscheduler(pid, p->sched_policy, &param))
+        {
+            LOGW("Scheduling policy of %s cannot be set : %s", get_app_name(i), strerror(errno));
+            p->has_sched = false;
+        }
+    }
+
+    if(p->has_nice && 0 != setpriority(PRIO_PROCESS, pid, p->nice))
+    {
+        LOGW("Nice value of %s cannot be set : %s", get_app_name(i), strerror(errno));
+        p->has_nice = false;
+    }
+
+    if(p->has_ioprio && 0 != syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, pid, p->ioprio))
+    {
+        LOGW("I/O priority of %s cannot be set : %s", get_app_name(i), strerror(errno));
+        p->has_ioprio = false;
+    }
+}
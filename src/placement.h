@@ -0,0 +1,64 @@
+/**
+    @file placement.h
+    @brief Process Watchdog Application Manager
+
+    The Process Watchdog application manages the processes listed in the configuration file.
+    It listens to a specified UDP port for heartbeat messages from these processes, which must
+    periodically send their PID. If any process stops running or fails to send its PID over UDP
+    within the expected interval, the Process Watchdog application will restart the process.
+
+    The application ensures high reliability and availability by continuously monitoring and
+    restarting processes as necessary. It also logs various statistics about the monitored
+    processes, including start times, crash times, and heartbeat intervals.
+
+    @date 2023-01-01
+    @version 1.0
+    @author by Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license GPL-3 License
+*/
+
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+/**
+    @file placement.h
+    @brief CPU and NUMA placement and scheduling class of the applications.
+
+    The CPU affinity and the NUMA memory policy are set on the watchdog around the spawn
+    of an application, so the new process inherits them before it runs any code, and are
+    restored afterwards. The nice value, the I/O priority and the scheduling policy are set
+    on the new process, the watchdog could not always restore its own ones. The automatic
+    placement reads the topology from /sys/devices/system and spreads the applications
+    round robin over the NUMA nodes and over the CPUs of every node.
+*/
+
+#define MAX_CPUS 1024 /**< Maximum supported number of CPUs. */
+#define MAX_NUMA_NODES 64 /**< Maximum supported number of NUMA nodes. */
+#define PLACEMENT_AUTO "auto" /**< Value of cpu_affinity and numa_nodes selecting the automatic placement. */
+
+/**
+    @brief Reads the CPU topology and prepares the placement of all the applications.
+
+    @return Number of the applications with a placement.
+*/
+int placement_start(void);
+
+/**
+    @brief Sets the CPU affinity and the NUMA memory policy of the specified application on the
+    calling thread, to be inherited by the process spawned next.
+
+    @param i Index of the application.
+*/
+void placement_begin(int i);
+
+/**
+    @brief Restores the CPU affinity and the NUMA memory policy of the calling thread and applies
+    the nice value, the I/O priority and the scheduling policy to the spawned process.
+
+    @param i Index of the application.
+    @param pid Process ID of the spawned process, 0 or less if the spawn failed.
+*/
+void placement_end(int i, int pid);
+
+#endif // PLACEMENT_H
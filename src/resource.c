@@ -0,0 +1,265 @@
+/**
+    @file resource.c
+    @brief Process Watchdog Application Manager
+
+    The Process Watchdog application manages the processes listed in the configuration file.
+    It listens to a specified UDP port for heartbeat messages from these processes, which must
+    periodically send their PID. If any process stops running or fails to send its PID over UDP
+    within the expected interval, the Process Watchdog application will restart the process.
+
+    The application ensures high reliability and availability by continuously monitoring and
+    restarting processes as necessary. It also logs various statistics about the monitored
+    processes, including start times, crash times, and heartbeat intervals.
+
+    @date 2023-01-01
+    @version 1.0
+    @author by Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license GPL-3 License
+*/
+
+#include "resource.h"
+#include "apps.h"
+#include "clock.h"
+#include "stats.h"
+#include "log.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/resource.h>
+
+/**
+    @brief Sampler state of an application.
+*/
+typedef struct
+{
+    int pid; /**< Process the files belong to, 0 if none. */
+    int stat_fd; /**< /proc/<pid>/stat, -1 if not open. */
+    int statm_fd; /**< /proc/<pid>/statm, -1 if not open. */
+    int io_fd; /**< /proc/<pid>/io, -1 if not open or not permitted. */
+    clk_t sampled_at; /**< Monotonic time of the last sample (milliseconds). */
+    uint64_t cpu_ticks; /**< User and system CPU time at the last sample (clock ticks). */
+    uint64_t read_bytes; /**< Bytes read from storage at the last sample. */
+    uint64_t write_bytes; /**< Bytes written to storage at the last sample. */
+    uint64_t rss_kb; /**< Resident set size (KB). */
+    int cpu_pct; /**< CPU usage in the last interval (percent of one core). */
+    clk_t cpu_over_at; /**< Monotonic time since the CPU usage is over the limit, 0 if not (milliseconds). */
+} Resource_t;
+
+static Resource_t res[MAX_APPS];
+static clk_t last_sample_ms;
+static long page_kb;
+static long clock_ticks;
+
+static int open_proc(int pid, const char *name)
+{
+    char path[48];
+    snprintf(path, sizeof(path), "/proc/%d/%s", pid, name);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if(fd < 0 && EMFILE == errno)
+    {
+        // Three files per application, raise the soft limit of open files up to the hard limit
+        struct rlimit rl;
+
+        if(0 == getrlimit(RLIMIT_NOFILE, &rl) && rl.rlim_cur < rl.rlim_max)
+        {
+            rl.rlim_cur = rl.rlim_max;
+
+            if(0 == setrlimit(RLIMIT_NOFILE, &rl))
+            {
+                fd = open(path, O_RDONLY | O_CLOEXEC);
+            }
+        }
+    }
+
+    return fd;
+}
+
+static void close_fd(int *fd)
+{
+    if(0 <= *fd)
+    {
+        close(*fd);
+        *fd = -1;
+    }
+}
+
+static void resource_close(int i)
+{
+    if(0 == res[i].pid)
+    {
+        return; // nothing opened
+    }
+
+    close_fd(&res[i].stat_fd);
+    close_fd(&res[i].statm_fd);
+    close_fd(&res[i].io_fd);
+    res[i].pid = 0;
+}
+
+static void resource_open(int i, int pid)
+{
+    Resource_t *r = &res[i];
+    resource_close(i);
+    memset(r, 0, sizeof(Resource_t));
+    r->pid = pid; // also when the files cannot be opened, the process is not retried
+    r->stat_fd = open_proc(pid, "stat");
+    r->statm_fd = open_proc(pid, "statm");
+    r->io_fd = open_proc(pid, "io");
+
+    if(r->stat_fd < 0 || r->statm_fd < 0)
+    {
+        LOGD("Resource usage of %s is not sampled, error : %d - %s", get_app_name(i), errno, strerror(errno));
+    }
+}
+
+static int read_fd(int fd, char *buf, size_t size)
+{
+    ssize_t n = pread(fd, buf, size - 1, 0);
+
+    if(n <= 0)
+    {
+        return -1;
+    }
+
+    buf[n] = 0;
+    return 0;
+}
+
+// pid (comm) state ppid pgrp session tty_nr tpgid flags minflt cminflt majflt cmajflt utime stime ...
+static int parse_stat(const char *buf, uint64_t *ticks)
+{
+    const char *p = strrchr(buf, ')');
+    unsigned long long utime, stime;
+
+    if(NULL == p || 2 != sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &utime, &stime))
+    {
+        return -1;
+    }
+
+    *ticks = utime + stime;
+    return 0;
+}
+
+static uint64_t parse_io_field(const char *buf, const char *name)
+{
+    const char *p = strstr(buf, name);
+    return NULL != p ? strtoull(p + strlen(name), NULL, 10) : 0;
+}
+
+static void sample_app(int i, clk_t now)
+{
+    Resource_t *r = &res[i];
+    char buf[512];
+    uint64_t ticks, pages = 0, rss_pages = 0, read_bytes = 0, write_bytes = 0;
+
+    if(read_fd(r->stat_fd, buf, sizeof(buf)) || parse_stat(buf, &ticks))
+    {
+        resource_close(i); // exited, the files are reopened for the next process
+        return;
+    }
+
+    if(0 == read_fd(r->statm_fd, buf, sizeof(buf)))
+    {
+        sscanf(buf, "%llu %llu", (unsigned long long *)&pages, (unsigned long long *)&rss_pages);
+    }
+
+    if(0 <= r->io_fd && 0 == read_fd(r->io_fd, buf, sizeof(buf)))
+    {
+        read_bytes = parse_io_field(buf, "\nread_bytes: ");
+        write_bytes = parse_io_field(buf, "\nwrite_bytes: ");
+    }
+
+    r->rss_kb = rss_pages * page_kb;
+
+    if(0 < r->sampled_at && now > r->sampled_at)
+    {
+        clk_t elapsed = now - r->sampled_at;
+        r->cpu_pct = (int)((ticks - r->cpu_ticks) * 100000 / (clock_ticks * elapsed));
+        stats_update_resources(i, r->rss_kb, r->cpu_pct, (read_bytes - r->read_bytes) * 1000 / elapsed,
+                               (write_bytes - r->write_bytes) * 1000 / elapsed);
+    }
+
+    r->sampled_at = now;
+    r->cpu_ticks = ticks;
+    r->read_bytes = read_bytes;
+    r->write_bytes = write_bytes;
+}
+
+void resource_sample(int interval)
+{
+    clk_t now = clock_ms();
+
+    if(0 >= interval || now - last_sample_ms < (clk_t)interval * 1000)
+    {
+        return;
+    }
+
+    last_sample_ms = now;
+
+    if(0 == page_kb)
+    {
+        page_kb = sysconf(_SC_PAGESIZE) / 1024;
+        clock_ticks = sysconf(_SC_CLK_TCK);
+    }
+
+    for(int i = 0; i < get_app_count(); i++)
+    {
+        int pid = get_app_pid(i);
+
+        if(0 >= pid)
+        {
+            resource_close(i);
+            continue;
+        }
+
+        if(pid != res[i].pid)
+        {
+            resource_open(i, pid);
+        }
+
+        if(0 <= res[i].stat_fd && 0 <= res[i].statm_fd)
+        {
+            sample_app(i, now);
+        }
+    }
+}
+
+const char *resource_limit_exceeded(int i)
+{
+    Resource_t *r = &res[i];
+
+    if(0 >= r->pid || r->pid != get_app_pid(i) || 0 == r->sampled_at)
+    {
+        return NULL;
+    }
+
+    if(0 < get_max_rss(i) && r->rss_kb > (uint64_t)get_max_rss(i) * 1024)
+    {
+        return "memory";
+    }
+
+    if(0 < get_max_cpu(i) && r->cpu_pct >= get_max_cpu(i))
+    {
+        if(0 == r->cpu_over_at)
+        {
+            r->cpu_over_at = r->sampled_at;
+        }
+        else if(r->sampled_at - r->cpu_over_at >= (clk_t)get_max_cpu_duration(i) * 1000)
+        {
+            return "CPU";
+        }
+    }
+    else
+    {
+        r->cpu_over_at = 0;
+    }
+
+    return NULL;
+}
@@ -0,0 +1,52 @@
+/**
+    @file resource.h
+    @brief Process Watchdog Application Manager
+
+    The Process Watchdog application manages the processes listed in the configuration file.
+    It listens to a specified UDP port for heartbeat messages from these processes, which must
+    periodically send their PID. If any process stops running or fails to send its PID over UDP
+    within the expected interval, the Process Watchdog application will restart the process.
+
+    The application ensures high reliability and availability by continuously monitoring and
+    restarting processes as necessary. It also logs various statistics about the monitored
+    processes, including start times, crash times, and heartbeat intervals.
+
+    @date 2023-01-01
+    @version 1.0
+    @author by Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license GPL-3 License
+*/
+
+#ifndef RESOURCE_H
+#define RESOURCE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+    @file resource.h
+    @brief Resource usage sampling of the supervised processes from /proc.
+
+    The memory, CPU and disk I/O usage of the running applications are sampled once per
+    sample_interval. The /proc/<pid>/stat, statm and io files of every application are kept
+    open and re-read with pread, so a sample costs three system calls per process. The
+    samples are recorded in the statistics and checked against the per-app limits.
+*/
+
+/**
+    @brief Samples the resource usage of all running applications if the sample interval has elapsed.
+
+    @param interval Sample interval (seconds), 0 disables the sampling.
+*/
+void resource_sample(int interval);
+
+/**
+    @brief Checks the last samples of the specified application against its limits.
+
+    @param i Index of the application.
+    @return Name of the exceeded limit, NULL if the application is within its limits.
+*/
+const char *resource_limit_exceeded(int i);
+
+#endif // RESOURCE_H
@@ -0,0 +1,224 @@
+/**
+    @file rollout.c
+    @brief Process Watchdog Application Manager
+
+    The Process Watchdog application manages the processes listed in the configuration file.
+    It listens to a specified UDP port for heartbeat messages from these processes, which must
+    periodically send their PID. If any process stops running or fails to send its PID over UDP
+    within the expected interval, the Process Watchdog application will restart the process.
+
+    The application ensures high reliability and availability by continuously monitoring and
+    restarting processes as necessary. It also logs various statistics about the monitored
+    processes, including start times, crash times, and heartbeat intervals.
+
+    @date 2023-01-01
+    @version 1.0
+    @author by Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license GPL-3 License
+*/
+
+#include "rollout.h"
+#include "apps.h"
+#include "clock.h"
+#include "filecmd.h"
+#include "stats.h"
+#include "log.h"
+
+#include <string.h>
+
+/**
+    @brief State of an instance in the rollout.
+*/
+typedef enum
+{
+    ROLLOUT_PENDING = 0, /**< Not restarted yet. */
+    ROLLOUT_STOPPING, /**< Stopped, waiting for the monitor to start it again. */
+    ROLLOUT_RESTARTING, /**< Restarted, waiting for its first heartbeat. */
+    ROLLOUT_DONE, /**< Restarted and ready, or skipped. */
+    ROLLOUT_FAILED /**< Crashed or missed its first heartbeat after the restart. */
+} RolloutState_t;
+
+/**
+    @brief Running rolling restart of a pool.
+*/
+typedef struct
+{
+    bool running; /**< A rollout is running. */
+    int first; /**< Index of the application the rollout was requested for. */
+    int count; /**< Number of instances of the pool. */
+    int members[MAX_APPS]; /**< Indexes of the instances of the pool. */
+    int batch; /**< Maximum number of instances restarting at a time. */
+    int max_failures; /**< Number of failures aborting the rollout. */
+    int restarted; /**< Number of instances restarted and ready. */
+    int failures; /**< Number of instances failed after the restart. */
+    clk_t started_ms; /**< Monotonic time when the rollout began (milliseconds). */
+    RolloutState_t state[MAX_APPS]; /**< State of every instance, in the order of members. */
+} Rollout_t;
+
+static Rollout_t rollout;
+
+static const char *group_name(int i)
+{
+    return (0 < get_instance_count(i)) ? get_pool_name(i) : get_app_name(i);
+}
+
+int rollout_start(int i)
+{
+    if(rollout.running)
+    {
+        return 1;
+    }
+
+    memset(&rollout, 0, sizeof(rollout));
+    rollout.running = true;
+    rollout.first = i;
+
+    for(int n = 0; n < get_app_count(); n++)
+    {
+        if(n == i || (0 < get_instance_count(i) && !is_application_removed(n) && 0 == strcmp(get_pool_name(n), get_pool_name(i))))
+        {
+            rollout.members[rollout.count++] = n;
+        }
+    }
+
+    rollout.batch = (0 < get_rollout_batch(i)) ? get_rollout_batch(i) : 1;
+    rollout.max_failures = get_rollout_max_failures(i);
+    rollout.started_ms = clock_ms();
+    LOGN("Rollout of %s has begun, %d instances, %d at a time", group_name(i), rollout.count, rollout.batch);
+    return 0;
+}
+
+bool rollout_running(void)
+{
+    return rollout.running;
+}
+
+static void rollout_finish(bool aborted)
+{
+    const char *name = group_name(rollout.first);
+    clk_t elapsed = clock_ms() - rollout.started_ms;
+
+    if(aborted)
+    {
+        LOGE("Rollout of %s has been aborted after %d failures, %d of %d instances restarted in %llu ms",
+             name, rollout.failures, rollout.restarted, rollout.count, (unsigned long long)elapsed);
+    }
+    else
+    {
+        LOGN("Rollout of %s has completed, %d of %d instances restarted, %d failed in %llu ms",
+             name, rollout.restarted, rollout.count, rollout.failures, (unsigned long long)elapsed);
+    }
+
+    rollout.running = false;
+}
+
+void rollout_update(void)
+{
+    if(!rollout.running)
+    {
+        for(int i = 0; i < get_app_count(); i++)
+        {
+            if(!is_application_removed(i) && 0 == get_instance(i) && filecmd_rollout(i))
+            {
+                filecmd_remove_rollout(i);
+                rollout_start(i);
+                break;
+            }
+        }
+
+        if(!rollout.running)
+        {
+            return;
+        }
+    }
+
+    int restarting = 0;
+    bool pending = false;
+
+    // Wait for the first heartbeat of the restarted instances, the monitor restarts the failed ones
+    for(int n = 0; n < rollout.count; n++)
+    {
+        int i = rollout.members[n];
+
+        if(ROLLOUT_STOPPING == rollout.state[n])
+        {
+            // The monitor schedules the restart once the process has exited
+            if(!is_application_started(i))
+            {
+                rollout.state[n] = ROLLOUT_DONE; // stopped by file command meanwhile
+            }
+            else if(is_application_stopping(i) || is_restart_pending(i))
+            {
+                restarting++;
+            }
+            else
+            {
+                rollout.state[n] = ROLLOUT_RESTARTING;
+                restarting++;
+            }
+
+            continue;
+        }
+
+        if(ROLLOUT_RESTARTING != rollout.state[n])
+        {
+            pending |= (ROLLOUT_PENDING == rollout.state[n]);
+            continue;
+        }
+
+        if(is_restart_pending(i) || !is_application_running(i))
+        {
+            LOGW("Rollout of %s : %s has failed after the restart", group_name(rollout.first), get_app_name(i));
+            rollout.state[n] = ROLLOUT_FAILED;
+            rollout.failures++;
+            stats_rollout_failed(i);
+        }
+        else if(is_application_ready(i))
+        {
+            rollout.state[n] = ROLLOUT_DONE;
+            rollout.restarted++;
+            LOGN("Rollout of %s : %s is ready, %d of %d instances restarted", group_name(rollout.first),
+                 get_app_name(i), rollout.restarted, rollout.count);
+        }
+        else
+        {
+            restarting++;
+        }
+    }
+
+    if(0 < rollout.max_failures && rollout.failures >= rollout.max_failures)
+    {
+        rollout_finish(true);
+        return;
+    }
+
+    if(!pending && 0 == restarting)
+    {
+        rollout_finish(false);
+        return;
+    }
+
+    // Restart the next instances, the stopped and not yet started ones start with the new version anyway
+    for(int n = 0; n < rollout.count && restarting < rollout.batch; n++)
+    {
+        int i = rollout.members[n];
+
+        if(ROLLOUT_PENDING != rollout.state[n])
+        {
+            continue;
+        }
+
+        if(!is_application_started(i) || is_restart_pending(i) || filecmd_stop(i))
+        {
+            rollout.state[n] = ROLLOUT_DONE;
+            continue;
+        }
+
+        LOGN("Rollout of %s : restarting %s", group_name(rollout.first), get_app_name(i));
+        stop_application(i, STOP_RESTART);
+        stats_rollout_at(i);
+        rollout.state[n] = ROLLOUT_STOPPING;
+        restarting++;
+    }
+}
@@ -0,0 +1,60 @@
+/**
+    @file rollout.h
+    @brief Process Watchdog Application Manager
+
+    The Process Watchdog application manages the processes listed in the configuration file.
+    It listens to a specified UDP port for heartbeat messages from these processes, which must
+    periodically send their PID. If any process stops running or fails to send its PID over UDP
+    within the expected interval, the Process Watchdog application will restart the process.
+
+    The application ensures high reliability and availability by continuously monitoring and
+    restarting processes as necessary. It also logs various statistics about the monitored
+    processes, including start times, crash times, and heartbeat intervals.
+
+    @date 2023-01-01
+    @version 1.0
+    @author by Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license GPL-3 License
+*/
+
+#ifndef ROLLOUT_H
+#define ROLLOUT_H
+
+#include <stdbool.h>
+
+/**
+    @file rollout.h
+    @brief Rolling restart of the instances of a pool.
+
+    At most rollout_batch instances are restarted at a time, the next ones only once the
+    restarted instances have sent their first heartbeat, so the pool keeps serving during
+    a deploy. A restarted instance which crashes or misses its first heartbeat is a failure,
+    the rollout is aborted when rollout_max_failures is reached and the instances not
+    restarted yet keep running. One rollout runs at a time, requested by the rollout<pool>
+    file command, a single application is a pool of one.
+*/
+
+/**
+    @brief Begins the rolling restart of the pool of the specified application.
+
+    @param i Index of an application of the pool.
+    @return 0 if the rollout has begun, 1 if another rollout is running.
+*/
+int rollout_start(int i);
+
+/**
+    @brief Checks if a rolling restart is running.
+
+    @return true if a rollout is running, false otherwise.
+*/
+bool rollout_running(void);
+
+/**
+    @brief Begins the rollouts requested by file command and advances the running one.
+
+    Called by the main loop after the application scan.
+*/
+void rollout_update(void);
+
+#endif // ROLLOUT_H
@@ -18,6 +18,8 @@
     @license GPL-3 License
 */
 
+#include "server.h"
+#include "clock.h"
 #include "log.h"
 
 #include <stdio.h>
@@ -25,6 +27,7 @@
 #include <stdbool.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <errno.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -32,13 +35,14 @@
 #include <poll.h>
 #include <signal.h>
 
-static struct pollfd pfd;
+static struct pollfd pfd[1 + UDP_MAX_WATCHED]; // the UDP socket first, then the watched descriptors
+static int watched;
 
 int udp_start(int *socketfd, int port)
 {
     struct sockaddr_in si_me;
     // create a UDP socket
-    *socketfd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    *socketfd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, IPPROTO_UDP);
 
     if(*socketfd == -1)
     {
@@ -72,13 +76,41 @@ int udp_start(int *socketfd, int port)
     signal(SIGPIPE, SIG_IGN);
     LOGI("UDP server started on port %d", port);
     // set up the pollfd structure for listening on the socket
-    pfd.fd = *socketfd;
-    pfd.events = POLLIN;
-    pfd.revents = 0;
+    pfd[0].fd = *socketfd;
+    pfd[0].events = POLLIN;
+    pfd[0].revents = 0;
+    watched = 0;
     return 0;
 }
 
-static int udp_pollp(int socketfd, struct pollfd *pfd, int timeout, char *data, int *len)
+int udp_adopt(int socketfd, int port)
+{
+    struct sockaddr_in si_me;
+    socklen_t slen = sizeof(si_me);
+    int type = 0;
+    socklen_t tlen = sizeof(type);
+
+    // The socket must still be the UDP socket bound to the port of the ini file
+    if(0 > socketfd || 0 != getsockopt(socketfd, SOL_SOCKET, SO_TYPE, &type, &tlen) || SOCK_DGRAM != type ||
+            0 != getsockname(socketfd, (struct sockaddr *)&si_me, &slen) || AF_INET != si_me.sin_family ||
+            port != ntohs(si_me.sin_port))
+    {
+        LOGE("Socket %d handed over is not a UDP socket on port %d", socketfd, port);
+        return 1;
+    }
+
+    fcntl(socketfd, F_SETFD, FD_CLOEXEC);
+    signal(SIGCHLD, SIG_IGN);
+    signal(SIGPIPE, SIG_IGN);
+    LOGI("UDP server taken over on port %d", port);
+    pfd[0].fd = socketfd;
+    pfd[0].events = POLLIN;
+    pfd[0].revents = 0;
+    watched = 0;
+    return 0;
+}
+
+static int udp_pollp(int socketfd, struct pollfd *pfd, int nfds, int timeout, char *data, int *len)
 {
     struct sockaddr_in si_other;
     int slen = sizeof(si_other), recv_len, data_len;
@@ -86,13 +118,14 @@ static int udp_pollp(int socketfd, struct pollfd *pfd, int timeout, char *data,
     *len = 0;
 
     // call poll() to wait for events on the socket
-    if(poll(pfd, 1, timeout) == -1)
+    if(poll(pfd, nfds, timeout) == -1)
     {
-        if(errno != EINTR) // Interrupted system call
+        if(errno == EINTR) // Interrupted system call, e.g. by SIGHUP asking for a reload
         {
-            LOGE("poll error, error : %d - %s", errno, strerror(errno));
+            return 0;
         }
 
+        LOGE("poll error, error : %d - %s", errno, strerror(errno));
         return 1;
     }
 
@@ -133,9 +166,31 @@ static int udp_pollp(int socketfd, struct pollfd *pfd, int timeout, char *data,
     return 0;
 }
 
+int udp_watch(const int *fds, int count)
+{
+    watched = (count < UDP_MAX_WATCHED) ? count : UDP_MAX_WATCHED;
+
+    for(int n = 0; n < watched; n++)
+    {
+        pfd[1 + n].fd = fds[n];
+        pfd[1 + n].events = POLLIN;
+        pfd[1 + n].revents = 0;
+    }
+
+    return watched;
+}
+
 int udp_poll(int socketfd, int timeout, char *data, int *len)
 {
-    return udp_pollp(socketfd, &pfd, timeout, data, len);
+    if(clock_simulated())
+    {
+        // Nothing arrives in a simulation, the poll timeout only advances the clock
+        *len = 0;
+        clock_sleep_ms(timeout);
+        return 0;
+    }
+
+    return udp_pollp(socketfd, pfd, 1 + watched, timeout, data, len);
 }
 
 void udp_stop(int socketfd)
@@ -26,6 +26,8 @@
     @brief Functions for managing UDP server operations.
 */
 
+#define UDP_MAX_WATCHED 64 /**< Maximum number of other file descriptors waking up the poll of the UDP server. */
+
 /**
     @brief Starts a UDP server on the specified port.
 
@@ -35,6 +37,26 @@
 */
 int udp_start(int *socketfd, int port);
 
+/**
+    @brief Takes over the socket of a UDP server started by the previous image of the watchdog,
+    the datagrams queued on it meanwhile are received.
+
+    @param socketfd The socket file descriptor inherited across execve().
+    @param port The port number the socket must be bound to.
+    @return 0 on success, else on failure.
+*/
+int udp_adopt(int socketfd, int port);
+
+/**
+    @brief Sets the other file descriptors the poll of the UDP server returns on when they become readable,
+    they are not read. Replaces the ones set before.
+
+    @param fds The file descriptors.
+    @param count The number of file descriptors, at most UDP_MAX_WATCHED are watched.
+    @return The number of file descriptors watched.
+*/
+int udp_watch(const int *fds, int count);
+
 /**
     @brief Polls the UDP server for incoming data.
 
@@ -0,0 +1,295 @@
+/**
+    @file state.c
+    @brief Process Watchdog Application Manager
+
+    The Process Watchdog application manages the processes listed in the configuration file.
+    It listens to a specified UDP port for heartbeat messages from these processes, which must
+    periodically send their PID. If any process stops running or fails to send its PID over UDP
+    within the expected interval, the Process Watchdog application will restart the process.
+
+    The application ensures high reliability and availability by continuously monitoring and
+    restarting processes as necessary. It also logs various statistics about the monitored
+    processes, including start times, crash times, and heartbeat intervals.
+
+    @date 2023-01-01
+    @version 1.0
+    @author by Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license GPL-3 License
+*/
+
+#include "state.h"
+#include "activation.h"
+#include "apps.h"
+#include "clock.h"
+#include "log.h"
+#include "utils.h"
+#include "zygote.h"
+
+#include <stdio.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+#define STATE_MAGIC "processWatchdog-state" /**< First word of the state file. */
+
+static bool saved[MAX_APPS];
+
+// Writes the sockets of the applications, inherited by the new image of an upgrade in place
+static void write_sockets(FILE *fp)
+{
+    int fds[MAX_LISTEN_FDS];
+
+    for(int i = 0; i < get_app_count(); i++)
+    {
+        int count = is_application_removed(i) ? 0 : activation_fds(i, fds, MAX_LISTEN_FDS);
+
+        // socket fd index name, also of the applications stopped or activated on demand
+        for(int k = 0; k < count; k++)
+        {
+            fprintf(fp, "%s %d %d %s\n", STATE_SOCKET, fds[k], k, get_app_name(i));
+        }
+    }
+}
+
+// Writes the running applications and the pending restarts, returns their number
+static int write_state(FILE *fp, bool sockets)
+{
+    int count = 0;
+    memset(saved, 0, sizeof(saved));
+    fprintf(fp, "%s %d\n", STATE_MAGIC, STATE_VERSION);
+
+    for(int i = 0; i < get_app_count(); i++)
+    {
+        unsigned long long start_time = 0;
+
+        if(is_application_removed(i))
+        {
+            continue;
+        }
+
+        // The warm spares are not handed over, the next watchdog starts its own
+        stop_spare(i);
+        zygote_wait(i); // the PID of a process being forked is known once the zygote replies
+
+        // A process being stopped is killed by this watchdog, the next one starts the application again
+        if(!is_application_started(i) || is_application_stopping(i))
+        {
+            continue;
+        }
+
+        if(!is_restart_pending(i))
+        {
+            if(!is_application_running(i) || 0 == (start_time = process_start_time(get_app_pid(i))))
+            {
+                continue; // crashed, the next watchdog starts it
+            }
+        }
+
+        // pid pgid start_time first_heartbeat heartbeat_age backoff_level restart_delay name
+        fprintf(fp, "%d %d %llu %d %llu %d %llu %s\n", is_restart_pending(i) ? 0 : get_app_pid(i), get_app_pgid(i), start_time,
+                get_first_heartbeat(i) ? 1 : 0, (unsigned long long)(clock_ms() - get_heartbeat_ms(i)), get_backoff_level(i),
+                (unsigned long long)get_restart_delay(i), get_app_name(i));
+        saved[i] = true;
+        count++;
+    }
+
+    if(sockets)
+    {
+        write_sockets(fp);
+    }
+
+    return count;
+}
+
+static int find_app(const char *name)
+{
+    for(int i = 0; i < get_app_count(); i++)
+    {
+        if(!is_application_removed(i) && !is_application_started(i) && 0 == strcmp(get_app_name(i), name))
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+// Records a socket handed over by the previous image
+static void read_socket(const char *line)
+{
+    int fd, k, n = 0;
+
+    if(2 != sscanf(line, "%*s %d %d %n", &fd, &k, &n) || 0 == n)
+    {
+        LOGW("Invalid socket in the state : %s", line);
+        return;
+    }
+
+    for(int i = 0; i < get_app_count(); i++)
+    {
+        if(!is_application_removed(i) && 0 == strcmp(get_app_name(i), &line[n]))
+        {
+            activation_inherit(i, k, fd);
+            return;
+        }
+    }
+
+    LOGW("Socket %d of %s is not in the ini file anymore, closing it", fd, &line[n]);
+    close(fd);
+}
+
+// Adopts the saved applications, returns their number, the sockets are only valid in a handover across execve()
+static int read_state(FILE *fp, const char *name, bool sockets)
+{
+    char line[MAX_APP_CMD_LENGTH];
+    char magic[32];
+    int version = 0;
+    int count = 0;
+
+    if(NULL == fgets(line, sizeof(line), fp) || 2 != sscanf(line, "%31s %d", magic, &version) ||
+            0 != strcmp(magic, STATE_MAGIC) || STATE_VERSION != version)
+    {
+        LOGW("State in %s is not supported, the applications are started again", name);
+        return 0;
+    }
+
+    while(NULL != fgets(line, sizeof(line), fp))
+    {
+        int pid, pgid, first_heartbeat, backoff_level, n = 0;
+        unsigned long long start_time, heartbeat_age, restart_delay;
+        line[strcspn(line, "\n")] = 0;
+
+        if(0 == strncmp(line, STATE_SOCKET " ", strlen(STATE_SOCKET) + 1))
+        {
+            if(sockets)
+            {
+                read_socket(line);
+            }
+            else
+            {
+                LOGW("Socket in %s is ignored : %s", name, line);
+            }
+
+            continue;
+        }
+
+        if(7 != sscanf(line, "%d %d %llu %d %llu %d %llu %n", &pid, &pgid, &start_time, &first_heartbeat, &heartbeat_age,
+                       &backoff_level, &restart_delay, &n) || 0 == n)
+        {
+            LOGW("Invalid line in %s : %s", name, line);
+            continue;
+        }
+
+        int i = find_app(&line[n]);
+
+        if(0 > i)
+        {
+            if(0 < pid && start_time == process_start_time(pid))
+            {
+                LOGW("Process %s (PID %d) is not in the ini file anymore, terminating it", &line[n], pid);
+                kill((0 < pgid) ? -pgid : pid, SIGTERM);
+            }
+        }
+        else if(0 == pid)
+        {
+            resume_restart(i, restart_delay, backoff_level);
+            count++;
+        }
+        else if(0 == adopt_application(i, pid, pgid, start_time, 0 != first_heartbeat, heartbeat_age, backoff_level))
+        {
+            count++;
+        }
+    }
+
+    LOGN("%d processes are adopted from %s", count, name);
+    return count;
+}
+
+int state_save(const char *path)
+{
+    char tmp[PATH_MAX];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *fp = fopen(tmp, "we");
+
+    if(NULL == fp)
+    {
+        LOGE("Error opening state file %s : %s", tmp, strerror(errno));
+        return -1;
+    }
+
+    int count = write_state(fp, false);
+
+    // The file is complete or missing, never partially written
+    if(0 != fflush(fp) || 0 != fsync(fileno(fp)) || 0 != fclose(fp) || 0 != rename(tmp, path))
+    {
+        LOGE("Error writing state file %s : %s", path, strerror(errno));
+        unlink(tmp);
+        memset(saved, 0, sizeof(saved));
+        return -1;
+    }
+
+    LOGN("%d processes are handed over to the next watchdog in %s", count, path);
+    return count;
+}
+
+int state_save_fd(int fd)
+{
+    int count = -1;
+    FILE *fp = fdopen(dup(fd), "w");
+
+    if(NULL != fp)
+    {
+        count = write_state(fp, true);
+
+        if(0 != fclose(fp))
+        {
+            count = -1;
+        }
+    }
+
+    if(0 > count || 0 != lseek(fd, 0, SEEK_SET))
+    {
+        LOGE("Error writing state : %s", strerror(errno));
+        memset(saved, 0, sizeof(saved));
+        return -1;
+    }
+
+    return count;
+}
+
+bool state_saved(int i)
+{
+    return saved[i];
+}
+
+int state_restore(const char *path)
+{
+    FILE *fp = fopen(path, "re");
+
+    if(NULL == fp)
+    {
+        return 0;
+    }
+
+    int count = read_state(fp, path, false);
+    fclose(fp);
+    unlink(path);
+    return count;
+}
+
+int state_restore_fd(int fd)
+{
+    int count = 0;
+    FILE *fp = (0 == lseek(fd, 0, SEEK_SET)) ? fdopen(dup(fd), "r") : NULL;
+
+    if(NULL == fp)
+    {
+        LOGE("Error reading state : %s", strerror(errno));
+        return -1;
+    }
+
+    count = read_state(fp, "the previous image", true);
+    fclose(fp);
+    return count;
+}
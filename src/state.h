@@ -0,0 +1,83 @@
+/**
+    @file state.h
+    @brief Process Watchdog Application Manager
+
+    The Process Watchdog application manages the processes listed in the configuration file.
+    It listens to a specified UDP port for heartbeat messages from these processes, which must
+    periodically send their PID. If any process stops running or fails to send its PID over UDP
+    within the expected interval, the Process Watchdog application will restart the process.
+
+    The application ensures high reliability and availability by continuously monitoring and
+    restarting processes as necessary. It also logs various statistics about the monitored
+    processes, including start times, crash times, and heartbeat intervals.
+
+    @date 2023-01-01
+    @version 1.0
+    @author by Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license GPL-3 License
+*/
+
+#ifndef STATE_H
+#define STATE_H
+
+#include <stdbool.h>
+
+/**
+    @file state.h
+    @brief Handover of the running applications to the next watchdog.
+
+    When the watchdog exits to be restarted, the PIDs, process groups, start times and
+    heartbeat state of the running applications and the backoff of the pending restarts
+    are written to the state file and the applications are left running. The next watchdog reads the file once at startup and
+    adopts the processes which are still the saved ones, verified by pidfd and start time,
+    the others are started as usual. The file is removed after it is read, so a crash
+    later never adopts stale processes.
+*/
+
+#define STATE_VERSION 2 /**< Version of the state file format. */
+#define STATE_SOCKET "socket" /**< First word of the lines of the sockets handed over across execve(), older images skip them as invalid. */
+
+/**
+    @brief Writes the running applications into the state file.
+
+    @param path Path of the state file.
+    @return Number of the applications saved, -1 on error.
+*/
+int state_save(const char *path);
+
+/**
+    @brief Writes the running applications into a file descriptor, e.g. a memfd handed over across execve().
+
+    The sockets of all the applications are written too, the caller makes them inheritable.
+
+    @param fd File descriptor, it is rewound to the beginning afterwards.
+    @return Number of the applications saved, -1 on error.
+*/
+int state_save_fd(int fd);
+
+/**
+    @brief Checks if the specified application is saved into the state file and must be left running.
+
+    @param i Index of the application.
+    @return true if the application is handed over, false otherwise.
+*/
+bool state_saved(int i);
+
+/**
+    @brief Adopts the applications saved in the state file by the previous watchdog and removes the file.
+
+    @param path Path of the state file.
+    @return Number of the applications adopted.
+*/
+int state_restore(const char *path);
+
+/**
+    @brief Adopts the applications saved into a file descriptor by the previous image of the watchdog.
+
+    @param fd File descriptor written by state_save_fd().
+    @return Number of the applications adopted, -1 on error.
+*/
+int state_restore_fd(int fd);
+
+#endif // STATE_H
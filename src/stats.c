@@ -19,14 +19,16 @@
 */
 
 #include "apps.h"
+#include "clock.h"
 #include "log.h"
+#include "trace.h"
 #include "utils.h"
 
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
 
-#define STATS_MAGIC ((uint32_t)0xA50FAA55)
+#define STATS_MAGIC ((uint32_t)0xA50FAA56) // changed whenever the layout of Statistic_t changes
 
 /**
     @brief Structure that holds data for each application.
@@ -47,11 +49,128 @@ typedef struct
     size_t heartbeat_count; /**< Number of heartbeats received. */
     size_t heartbeat_count_old; /**< Number of old heartbeats received. */
     size_t heartbeat_reset_count; /**< Number of restarts due to late heartbeats. */
+    time_t crash_loop_at; /**< Time when the application entered a crash loop (epoch). */
+    size_t crash_loop_count; /**< Number of crash loops. */
+    time_t resource_reset_at; /**< Time when the application was restarted due to a resource limit (epoch). */
+    size_t resource_reset_count; /**< Number of restarts due to resource limits. */
+    uint64_t max_rss_kb; /**< Maximum resident set size (KB). */
+    int max_cpu_pct; /**< Maximum CPU usage in a sample interval (percent of one core). */
+    size_t leftover_count; /**< Number of processes left running by the application. */
+    time_t rollout_at; /**< Time when the application was last restarted by a rollout (epoch). */
+    size_t rollout_count; /**< Number of restarts by rollouts. */
+    size_t rollout_failure_count; /**< Number of failures after a restart by a rollout. */
+    time_t promoted_at; /**< Time when the warm spare of the application was last promoted (epoch). */
+    size_t promotion_count; /**< Number of failures taken over by the warm spare. */
     uint32_t magic; /**< Magic value indicating initialization (STATS_MAGIC when struct is initialized). */
 } Statistic_t;
 
 static Statistic_t stats[MAX_APPS]; // statistics for the apps
 
+#define LATENCY_BUCKETS 24 /**< Number of log2 histogram buckets, the last one covers >= 2^23 ms. */
+
+/**
+    @brief Distribution of a measured interval in milliseconds.
+*/
+typedef struct
+{
+    size_t count; /**< Number of samples. */
+    clk_t sum; /**< Sum of the samples (milliseconds). */
+    clk_t min; /**< Minimum sample (milliseconds). */
+    clk_t max; /**< Maximum sample (milliseconds). */
+    size_t buckets[LATENCY_BUCKETS]; /**< Bucket k counts the samples in [2^k, 2^(k+1)) ms, bucket 0 also counts 0 ms. */
+} Histogram_t;
+
+/**
+    @brief Restart latency measurements of an application, kept in memory since the watchdog started.
+*/
+typedef struct
+{
+    Histogram_t detection; /**< Failure to detection intervals. */
+    Histogram_t respawn; /**< Detection to respawn intervals. */
+    Histogram_t recovery; /**< Respawn to first heartbeat intervals. */
+    clk_t detected_at; /**< Monotonic time of the last failure detection (milliseconds). */
+    clk_t respawned_at; /**< Monotonic time of the last respawn (milliseconds). */
+    clk_t down_at; /**< Monotonic time of the first unrecovered failure (milliseconds). */
+    clk_t downtime; /**< Total time spent between failures and recoveries (milliseconds). */
+    clk_t observed_at; /**< Monotonic time of the first start (milliseconds). */
+    size_t recovery_count; /**< Number of completed recoveries. */
+    bool down; /**< Flag indicating that a failure has not recovered yet. */
+} Latency_t;
+
+static Latency_t latency[MAX_APPS]; // restart latency measurements for the apps
+
+/**
+    @brief Last resource usage sample of an application.
+*/
+typedef struct
+{
+    uint64_t rss_kb; /**< Resident set size (KB). */
+    int cpu_pct; /**< CPU usage (percent of one core). */
+    uint64_t read_bps; /**< Storage read rate (bytes per second). */
+    uint64_t write_bps; /**< Storage write rate (bytes per second). */
+} Usage_t;
+
+static Usage_t usage[MAX_APPS]; // last resource usage samples of the apps
+
+static void histogram_add(Histogram_t *h, clk_t ms)
+{
+    int k = 0;
+
+    while(k < LATENCY_BUCKETS - 1 && ((clk_t)2 << k) <= ms)
+    {
+        k++;
+    }
+
+    h->buckets[k]++;
+    h->sum += ms;
+
+    if(0 == h->count || ms < h->min)
+    {
+        h->min = ms;
+    }
+
+    if(ms > h->max)
+    {
+        h->max = ms;
+    }
+
+    h->count++;
+}
+
+static clk_t histogram_percentile(const Histogram_t *h, int percent)
+{
+    size_t rank = (h->count * percent + 99) / 100;
+    size_t seen = 0;
+
+    for(int k = 0; k < LATENCY_BUCKETS; k++)
+    {
+        seen += h->buckets[k];
+
+        if(0 < rank && seen >= rank)
+        {
+            clk_t upper = ((clk_t)2 << k) - 1;
+            return upper < h->max ? upper : h->max;
+        }
+    }
+
+    return h->max;
+}
+
+static void latency_failed_at(int index, clk_t failedAt)
+{
+    Latency_t *l = &latency[index];
+    clk_t now = clock_ms();
+    l->detected_at = now;
+    l->respawned_at = 0;
+    histogram_add(&l->detection, (now > failedAt && 0 < failedAt) ? now - failedAt : 0);
+
+    if(!l->down)
+    {
+        l->down = true;
+        l->down_at = (0 < failedAt && failedAt < now) ? failedAt : now;
+    }
+}
+
 static void clearHeartbeatCount(int index)
 {
     stats[index].heartbeat_count_old = stats[index].heartbeat_count;
@@ -60,27 +179,130 @@ static void clearHeartbeatCount(int index)
 
 void stats_started_at(int index)
 {
-    stats[index].started_at = time(NULL);
+    if(0 == latency[index].observed_at)
+    {
+        latency[index].observed_at = clock_ms();
+    }
+
+    stats[index].started_at = clock_time();
     stats[index].start_count++;
     clearHeartbeatCount(index);
 }
 
 void stats_crashed_at(int index)
 {
-    stats[index].crashed_at = time(NULL);
+    stats[index].crashed_at = clock_time();
     stats[index].crash_count++;
     clearHeartbeatCount(index);
+    latency_failed_at(index, get_alive_time(index));
+    trace_app_event(index, "crash");
 }
 
 void stats_heartbeat_reset_at(int index)
 {
-    stats[index].heartbeat_reset_at = time(NULL);
+    stats[index].heartbeat_reset_at = clock_time();
     stats[index].heartbeat_reset_count++;
     clearHeartbeatCount(index);
+    latency_failed_at(index, get_heartbeat_ms(index));
+    trace_app_event(index, "timeout");
+}
+
+void stats_crash_loop_at(int index)
+{
+    stats[index].crash_loop_at = clock_time();
+    stats[index].crash_loop_count++;
+    trace_app_event(index, "crash loop");
+}
+
+void stats_resource_reset_at(int index)
+{
+    stats[index].resource_reset_at = clock_time();
+    stats[index].resource_reset_count++;
+    clearHeartbeatCount(index);
+    latency_failed_at(index, clock_ms());
+    trace_app_event(index, "resource limit");
+}
+
+void stats_rollout_at(int index)
+{
+    stats[index].rollout_at = clock_time();
+    stats[index].rollout_count++;
+    trace_app_event(index, "rollout");
+}
+
+void stats_rollout_failed(int index)
+{
+    stats[index].rollout_failure_count++;
+    trace_app_event(index, "rollout failed");
+}
+
+void stats_promoted_at(int index)
+{
+    Latency_t *l = &latency[index];
+    clk_t now = clock_ms();
+    stats[index].promoted_at = clock_time();
+    stats[index].promotion_count++;
+    clearHeartbeatCount(index);
+
+    // The spare has already sent its first heartbeat, the failure recovers with the promotion
+    if(l->down)
+    {
+        histogram_add(&l->respawn, now - l->detected_at);
+        histogram_add(&l->recovery, 0);
+        l->downtime += now - l->down_at;
+        l->recovery_count++;
+        l->down = false;
+    }
+
+    l->respawned_at = now;
+    trace_app_event(index, "spare promoted");
+}
+
+void stats_leftover_processes(int index, int count)
+{
+    stats[index].leftover_count += count;
+    trace_app_event(index, "leftover processes");
+}
+
+void stats_update_resources(int index, uint64_t rss_kb, int cpu_pct, uint64_t read_bps, uint64_t write_bps)
+{
+    usage[index].rss_kb = rss_kb;
+    usage[index].cpu_pct = cpu_pct;
+    usage[index].read_bps = read_bps;
+    usage[index].write_bps = write_bps;
+
+    if(rss_kb > stats[index].max_rss_kb)
+    {
+        stats[index].max_rss_kb = rss_kb;
+    }
+
+    if(cpu_pct > stats[index].max_cpu_pct)
+    {
+        stats[index].max_cpu_pct = cpu_pct;
+    }
+}
+
+void stats_respawned_at(int index)
+{
+    Latency_t *l = &latency[index];
+    clk_t now = clock_ms();
+
+    if(0 == l->observed_at)
+    {
+        l->observed_at = now;
+    }
+
+    if(l->down && 0 == l->respawned_at)
+    {
+        histogram_add(&l->respawn, now - l->detected_at);
+    }
+
+    l->respawned_at = now;
 }
 
 void stats_update_heartbeat_time(int index, time_t heartbeatTime)
 {
+    trace_app_event(index, "heartbeat");
     stats[index].heartbeat_count++;
     // Calculate average heartbeat time
     stats[index].avg_heartbeat_time = ((stats[index].avg_heartbeat_time * (stats[index].heartbeat_count - 1)) + heartbeatTime) / stats[index].heartbeat_count;
@@ -101,6 +323,28 @@ void stats_update_heartbeat_time(int index, time_t heartbeatTime)
 void stats_update_first_heartbeat_time(int index, time_t heartbeatTime)
 {
     int start_count = stats[index].start_count + stats[index].crash_count + stats[index].heartbeat_reset_count;
+    trace_app_phase(index, TRACE_PHASE_RUNNING);
+
+    if(latency[index].down)
+    {
+        Latency_t *l = &latency[index];
+        clk_t now = clock_ms();
+
+        if(0 < l->respawned_at)
+        {
+            histogram_add(&l->recovery, now - l->respawned_at);
+        }
+
+        l->downtime += now - l->down_at;
+        l->recovery_count++;
+        l->down = false;
+    }
+    // The statistics may have been reset since the start
+    if(0 >= start_count)
+    {
+        start_count = 1;
+    }
+
     // Calculate average first heartbeat time
     stats[index].avg_first_heartbeat_time = ((stats[index].avg_first_heartbeat_time * (start_count - 1)) + heartbeatTime) / start_count;
 
@@ -133,11 +377,132 @@ static char *printDate(const time_t *t)
     return ts;
 }
 
+static void print_histogram(FILE *fp, const char *title, const Histogram_t *h, bool distribution)
+{
+    if(0 == h->count)
+    {
+        fprintf(fp, "%s: no samples\n", title);
+        return;
+    }
+
+    fprintf(fp, "%s: count %zu, avg %llu ms, min %llu ms, p50 %llu ms, p90 %llu ms, p99 %llu ms, max %llu ms\n",
+            title, h->count, (unsigned long long)(h->sum / h->count), (unsigned long long)h->min,
+            (unsigned long long)histogram_percentile(h, 50), (unsigned long long)histogram_percentile(h, 90),
+            (unsigned long long)histogram_percentile(h, 99), (unsigned long long)h->max);
+
+    if(!distribution)
+    {
+        return;
+    }
+
+    for(int k = 0; k < LATENCY_BUCKETS; k++)
+    {
+        if(0 < h->buckets[k])
+        {
+            fprintf(fp, "  %8llu - %8llu ms : %zu\n", k ? (unsigned long long)1 << k : 0ULL,
+                    ((unsigned long long)2 << k) - 1, h->buckets[k]);
+        }
+    }
+}
+
+void stats_print_latency(int index, FILE *fp, bool distribution)
+{
+    Latency_t *l = &latency[index];
+    clk_t now = clock_ms();
+    clk_t downtime = l->downtime + (l->down ? now - l->down_at : 0);
+    clk_t observed = 0 < l->observed_at ? now - l->observed_at : 0;
+    print_histogram(fp, "Failure to detection", &l->detection, distribution);
+    print_histogram(fp, "Detection to respawn", &l->respawn, distribution);
+    print_histogram(fp, "Respawn to first heartbeat", &l->recovery, distribution);
+
+    if(0 < l->recovery_count)
+    {
+        fprintf(fp, "MTTR: %llu ms\n", (unsigned long long)(l->downtime / l->recovery_count));
+    }
+    else
+    {
+        fprintf(fp, "MTTR: no recoveries\n");
+    }
+
+    if(0 < observed)
+    {
+        fprintf(fp, "Availability: %.3f %%\n", 100.0 * (double)(observed - (downtime < observed ? downtime : observed)) / (double)observed);
+    }
+    else
+    {
+        fprintf(fp, "Availability: not started\n");
+    }
+}
+
+// Prints the totals of the instances of the pool of the application to stats_<pool>.log
+static void stats_print_pool_to_file(int index)
+{
+    char filename[MAX_APP_NAME_LENGTH * 2];
+    const char *pool = get_pool_name(index);
+    Statistic_t total;
+    Usage_t current;
+    int count = 0;
+    memset(&total, 0, sizeof(total));
+    memset(&current, 0, sizeof(current));
+
+    for(int i = 0; i < get_app_count(); i++)
+    {
+        if(is_application_removed(i) || 0 != strcmp(get_pool_name(i), pool))
+        {
+            continue;
+        }
+
+        count++;
+        total.start_count += stats[i].start_count;
+        total.crash_count += stats[i].crash_count;
+        total.heartbeat_reset_count += stats[i].heartbeat_reset_count;
+        total.crash_loop_count += stats[i].crash_loop_count;
+        total.resource_reset_count += stats[i].resource_reset_count;
+        total.leftover_count += stats[i].leftover_count;
+        total.rollout_count += stats[i].rollout_count;
+        total.rollout_failure_count += stats[i].rollout_failure_count;
+        total.promotion_count += stats[i].promotion_count;
+        total.heartbeat_count += stats[i].heartbeat_count;
+        current.rss_kb += usage[i].rss_kb;
+        current.cpu_pct += usage[i].cpu_pct;
+        current.read_bps += usage[i].read_bps;
+        current.write_bps += usage[i].write_bps;
+    }
+
+    sprintf(filename, "stats_%s.log", pool);
+    FILE *fp = fopen(filename, "we");
+
+    if(fp == NULL)
+    {
+        LOGE("Error opening file %s", filename);
+        return;
+    }
+
+    fprintf(fp, "Statistics for pool %s:\n", pool);
+    fprintf(fp, "Instances: %d\n", count);
+    fprintf(fp, "Start count: %zu\n", total.start_count);
+    fprintf(fp, "Crash count: %zu\n", total.crash_count);
+    fprintf(fp, "Heartbeat reset count: %zu\n", total.heartbeat_reset_count);
+    fprintf(fp, "Crash loop count: %zu\n", total.crash_loop_count);
+    fprintf(fp, "Resource limit reset count: %zu\n", total.resource_reset_count);
+    fprintf(fp, "Leftover process count: %zu\n", total.leftover_count);
+    fprintf(fp, "Rollout count: %zu\n", total.rollout_count);
+    fprintf(fp, "Rollout failure count: %zu\n", total.rollout_failure_count);
+    fprintf(fp, "Spare promotion count: %zu\n", total.promotion_count);
+    fprintf(fp, "Memory: %llu KB\n", (unsigned long long)current.rss_kb);
+    fprintf(fp, "CPU: %d%%\n", current.cpu_pct);
+    fprintf(fp, "Disk I/O: read %llu B/s, write %llu B/s\n", (unsigned long long)current.read_bps,
+            (unsigned long long)current.write_bps);
+    fprintf(fp, "Heartbeat count: %zu\n", total.heartbeat_count);
+    fclose(fp);
+    LOGD("Statistics for pool %s printed to %s", pool, filename);
+}
+
 void stats_print_to_file(int index)
 {
     char filename[MAX_APP_NAME_LENGTH * 2];
     sprintf(filename, "stats_%s.log", get_app_name(index));
-    FILE *fp = fopen(filename, "w");
+    FILE *fp = fopen(filename, "we");
 
     if(fp == NULL)
     {
@@ -152,6 +517,21 @@ void stats_print_to_file(int index)
     fprintf(fp, "Start count: %zu\n", stats[index].start_count);
     fprintf(fp, "Crash count: %zu\n", stats[index].crash_count);
     fprintf(fp, "Heartbeat reset count: %zu\n", stats[index].heartbeat_reset_count);
+    fprintf(fp, "Crash loop at: %s\n", printDate(&stats[index].crash_loop_at));
+    fprintf(fp, "Crash loop count: %zu\n", stats[index].crash_loop_count);
+    fprintf(fp, "Resource limit reset at: %s\n", printDate(&stats[index].resource_reset_at));
+    fprintf(fp, "Resource limit reset count: %zu\n", stats[index].resource_reset_count);
+    fprintf(fp, "Leftover process count: %zu\n", stats[index].leftover_count);
+    fprintf(fp, "Rollout at: %s\n", printDate(&stats[index].rollout_at));
+    fprintf(fp, "Rollout count: %zu\n", stats[index].rollout_count);
+    fprintf(fp, "Rollout failure count: %zu\n", stats[index].rollout_failure_count);
+    fprintf(fp, "Spare promoted at: %s\n", printDate(&stats[index].promoted_at));
+    fprintf(fp, "Spare promotion count: %zu\n", stats[index].promotion_count);
+    fprintf(fp, "Memory: %llu KB, maximum %llu KB\n", (unsigned long long)usage[index].rss_kb,
+            (unsigned long long)stats[index].max_rss_kb);
+    fprintf(fp, "CPU: %d%%, maximum %d%%\n", usage[index].cpu_pct, stats[index].max_cpu_pct);
+    fprintf(fp, "Disk I/O: read %llu B/s, write %llu B/s\n", (unsigned long long)usage[index].read_bps,
+            (unsigned long long)usage[index].write_bps);
     fprintf(fp, "Heartbeat count: %zu\n", stats[index].heartbeat_count);
     fprintf(fp, "Heartbeat count old: %zu\n", stats[index].heartbeat_count_old);
     fprintf(fp, "Average first heartbeat time: %lld seconds\n", (long long)stats[index].avg_first_heartbeat_time);
@@ -160,9 +540,16 @@ void stats_print_to_file(int index)
     fprintf(fp, "Average heartbeat time: %lld seconds\n", (long long)stats[index].avg_heartbeat_time);
     fprintf(fp, "Maximum heartbeat time: %lld seconds\n", (long long)stats[index].max_heartbeat_time);
     fprintf(fp, "Minimum heartbeat time: %lld seconds\n", (long long)stats[index].min_heartbeat_time);
+    stats_print_latency(index, fp, false);
     fprintf(fp, "Magic: %X\n", stats[index].magic);
     fclose(fp);
     LOGD("Statistics for App %d printed to %s", index, filename);
+
+    // The pool totals are printed with the last instance
+    if(0 < get_instance_count(index) && get_instance(index) == get_instance_count(index) - 1)
+    {
+        stats_print_pool_to_file(index);
+    }
 }
 
 static void resetStatisticsFile(int index)
@@ -187,14 +574,30 @@ void stats_read_from_file(int index)
 {
     char filename[MAX_APP_NAME_LENGTH * 2];
     sprintf(filename, "stats_%s.raw", get_app_name(index));
+    // The index may have been used by an application removed from the ini file
+    memset(&stats[index], 0, sizeof(stats[index]));
+    memset(&latency[index], 0, sizeof(latency[index]));
+    memset(&usage[index], 0, sizeof(usage[index]));
 
     if(!f_exist(filename))
     {
+        stats[index].magic = STATS_MAGIC;
         stats_write_to_file(index);
+        return;
+    }
+
+    // A file of another size or layout is reset, f_read terminates the data it read
+    char raw[sizeof(Statistic_t) + 1];
+    int size = f_size(filename);
+
+    if(sizeof(Statistic_t) == (size_t)size && sizeof(Statistic_t) < (size_t)f_read(filename, raw, sizeof(Statistic_t)))
+    {
+        memcpy(&stats[index], raw, sizeof(Statistic_t));
     }
     else
     {
-        f_read(filename, (char *)&stats[index], sizeof(Statistic_t));
-        resetStatisticsFile(index);
+        LOGN("Statistic file %s has been reset - size %d is %zu", get_app_name(index), size, sizeof(Statistic_t));
     }
+
+    resetStatisticsFile(index);
 }
@@ -21,6 +21,9 @@
 #ifndef STATS_H
 #define STATS_H
 
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include <time.h>
 
 /**
@@ -51,6 +54,71 @@ void stats_crashed_at(int index);
 */
 void stats_heartbeat_reset_at(int index);
 
+/**
+    @brief Updates the statistics for when the application entered a crash loop.
+
+    @param index Index of the application.
+*/
+void stats_crash_loop_at(int index);
+
+/**
+    @brief Updates the statistics for when the application was restarted due to a resource limit.
+
+    @param index Index of the application.
+*/
+void stats_resource_reset_at(int index);
+
+/**
+    @brief Updates the statistics when the application is restarted by a rollout.
+
+    @param index Index of the application.
+*/
+void stats_rollout_at(int index);
+
+/**
+    @brief Updates the statistics when the application fails after its restart by a rollout.
+
+    @param index Index of the application.
+*/
+void stats_rollout_failed(int index);
+
+/**
+    @brief Updates the statistics when the warm spare of the application takes over its failure.
+
+    @param index Index of the application.
+*/
+void stats_promoted_at(int index);
+
+/**
+    @brief Updates the statistics for the processes left running by the application.
+
+    @param index Index of the application.
+    @param count Number of processes left.
+*/
+void stats_leftover_processes(int index, int count);
+
+/**
+    @brief Records a resource usage sample of the application.
+
+    @param index Index of the application.
+    @param rss_kb Resident set size (KB).
+    @param cpu_pct CPU usage in the sample interval (percent of one core).
+    @param read_bps Storage read rate (bytes per second).
+    @param write_bps Storage write rate (bytes per second).
+*/
+void stats_update_resources(int index, uint64_t rss_kb, int cpu_pct, uint64_t read_bps, uint64_t write_bps);
+
+/**
+    @brief Updates the restart latency measurements when the application has been spawned.
+
+    The failure to detection interval is recorded by stats_crashed_at() and stats_heartbeat_reset_at(),
+    the detection to respawn interval by this function and the respawn to first heartbeat interval
+    by stats_update_first_heartbeat_time().
+
+    @param index Index of the application.
+*/
+void stats_respawned_at(int index);
+
 /**
     @brief Updates the statistics for the heartbeat time of the application.
 
@@ -69,6 +137,15 @@ void stats_update_first_heartbeat_time(int index, time_t heartbeatTime);
 
 // File operations functions
 
+/**
+    @brief Prints the restart latency distributions, MTTR and availability of the application.
+
+    @param index Index of the application.
+    @param fp Output stream.
+    @param distribution true to print the histogram buckets as well.
+*/
+void stats_print_latency(int index, FILE *fp, bool distribution);
+
 /**
     @brief Prints the statistics to a human-readable file.
 
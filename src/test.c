@@ -19,11 +19,23 @@
 */
 
 #include "apps.h"
+#include "activation.h"
 #include "server.h"
+#include "clock.h"
 #include "filecmd.h"
+#include "monitor.h"
+#include "stats.h"
+#include "phi.h"
+#include "state.h"
+#include "trace.h"
 #include "log.h"
 #include "utils.h"
 
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
 /* internal macros */
 #define cmp(x)  if(0 == strcmp(testname, x))
 #define chk(x)  printf("%s\n", false != x() ? "Success" : "Fail!");
@@ -66,6 +78,1003 @@ void test_delay()
     printf("Waited\t\t%d ms\nMeasured\t%llu ms\n", ms, t);
 }
 
+void test_trace()
+{
+    const char *path = "/tmp/processWatchdog_trace_test.json";
+
+    if(read_ini_file())
+    {
+        printf("Error on reading the ini\n");
+        return;
+    }
+
+    if(trace_start(path, false))
+    {
+        printf("Error on starting the trace\n");
+        return;
+    }
+
+    for(int i = 0; i < get_app_count(); i++)
+    {
+        trace_app_phase(i, TRACE_PHASE_START_DELAY);
+        delay_ms(10);
+        trace_app_phase(i, TRACE_PHASE_STARTING);
+        delay_ms(20);
+        trace_app_phase(i, TRACE_PHASE_RUNNING);
+
+        for(int n = 0; n < 5; n++)
+        {
+            delay_ms(5);
+            trace_app_event(i, "heartbeat");
+        }
+
+        trace_app_event(i, "timeout");
+        trace_app_phase(i, TRACE_PHASE_STOPPING);
+        delay_ms(10);
+        trace_app_phase(i, TRACE_PHASE_NONE);
+    }
+
+    trace_stop();
+    printf("Trace of %d apps written into %s (%d bytes)\n", get_app_count(), path, f_size(path));
+}
+
+void test_heartbeat()
+{
+    // Stand-in child : sends p<pid> to the udp_port of the ini file every second until killed
+    struct sockaddr_in addr;
+    char data[32];
+    int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+
+    if(read_ini_file() || sockfd < 0)
+    {
+        printf("Error on reading the ini or creating the socket\n");
+        return;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(get_udp_port());
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    int len = snprintf(data, sizeof(data), "p%d", getpid());
+
+    while(1)
+    {
+        sendto(sockfd, data, len, 0, (struct sockaddr *)&addr, sizeof(addr));
+        delay(1);
+    }
+}
+
+void test_restart_latency()
+{
+    const char *ini = "restart_latency.ini";
+    const int rounds = 10;
+    char cfg[MAX_APP_CMD_LENGTH * 2];
+    char exe[MAX_APP_CMD_LENGTH] = {0};
+    char data[MAX_APP_CMD_LENGTH];
+    int socket, length;
+
+    if(readlink("/proc/self/exe", exe, sizeof(exe) - 1) < 0)
+    {
+        printf("Error on resolving the executable\n");
+        return;
+    }
+
+    // The stand-in child is this executable running the heartbeat test
+    snprintf(cfg, sizeof(cfg), "[processWatchdog]\nudp_port = 12399\nnWdtApps = 1\n"
+             "1_name = LatencyProbe\n1_start_delay = 0\n1_heartbeat_delay = 10\n1_heartbeat_interval = 5\n"
+             "1_cmd = %s -i %s -t heartbeat\n", exe, ini);
+    f_write(ini, cfg, strlen(cfg));
+
+    if(set_ini_file((char *)ini) || read_ini_file() || udp_start(&socket, get_udp_port()))
+    {
+        printf("Error on preparing the test\n");
+        f_remove(ini);
+        return;
+    }
+
+    start_application(0);
+    stats_started_at(0);
+
+    for(int n = 0; n <= rounds; n++)
+    {
+        // Wait for the first heartbeat of the new instance
+        clk_t t = time_ms();
+
+        while(!get_first_heartbeat(0) && elapsed_ms(t) < 10000)
+        {
+            length = sizeof(data) - 1;
+
+            if(0 == udp_poll(socket, 100, data, &length) && 0 < length && 'p' == data[0])
+            {
+                if(parse_number(data, length, NULL) == get_app_pid(0))
+                {
+                    stats_update_first_heartbeat_time(0, get_heartbeat_time(0));
+                    set_first_heartbeat(0);
+                    update_heartbeat_time(0);
+                }
+            }
+        }
+
+        if(!get_first_heartbeat(0))
+        {
+            printf("No heartbeat from the stand-in child\n");
+            break;
+        }
+
+        if(n == rounds)
+        {
+            break;
+        }
+
+        // Crash it after a random uptime and detect it like the main loop does
+        delay_ms(50 + rand() % 200);
+        kill(get_app_pid(0), SIGKILL);
+
+        while(is_application_running(0))
+        {
+            delay_ms(10 + rand() % 40);
+        }
+
+        stats_crashed_at(0);
+        restart_application(0);
+        printf("Restart %d/%d done\n", n + 1, rounds);
+    }
+
+    kill_application(0);
+    udp_stop(socket);
+    printf("\nRestart latency of %s:\n", get_app_name(0));
+    stats_print_latency(0, stdout, true);
+    f_remove(ini);
+}
+
+/**
+    @brief Scripted behaviour of a simulated child.
+*/
+typedef struct
+{
+    const char *name; /**< Name of the application. */
+    int startup; /**< Time until the first heartbeat (seconds). */
+    int heartbeat_every; /**< Heartbeat period (seconds). */
+    int crash_every; /**< Crash after this uptime (seconds), 0 never. */
+    int hang_after; /**< Stop sending heartbeats after this uptime (seconds), 0 never. */
+    bool ignore_sigterm; /**< Survive SIGTERM, only SIGKILL stops it. */
+    int start_delay; /**< start_delay in the ini (seconds). */
+    const char *depends_on; /**< depends_on in the ini, NULL if none. */
+    const char *ini; /**< Other keys of the application in the ini, one "key = value" per line, NULL if none. */
+    int ready_after; /**< Uptime from which the heartbeats carry READY=1 (seconds), 0 never. */
+    int next; /**< Time requested with NEXT=<ms> in every heartbeat, the next one is sent a second earlier (seconds), 0 never. */
+    int jitter; /**< Deviation of the heartbeat period, up to this percent either way (deterministic), 0 none. */
+} SimScript_t;
+
+/**
+    @brief State of a simulated child.
+*/
+typedef struct
+{
+    int pid; /**< Fake process ID. */
+    bool alive; /**< Flag indicating the child is running. */
+    bool stopped; /**< Flag indicating the child is paused with SIGSTOP. */
+    clk_t stopped_at; /**< Virtual time of the pause (milliseconds). */
+    clk_t spawned_at; /**< Virtual time of the spawn, moved by the time spent paused (milliseconds). */
+    clk_t next_heartbeat; /**< Virtual time of the next heartbeat (milliseconds). */
+    clk_t last_heartbeat; /**< Virtual time of the last heartbeat (milliseconds). */
+    uint32_t seed; /**< State of the jitter generator. */
+    int spawns; /**< Number of spawns. */
+} SimChild_t;
+
+#define SIM_PID_BASE 100000000 // fake PIDs, far above pid_max
+#define SIM_MAX_APPS 8
+
+static const SimScript_t *sim_scripts;
+static int sim_apps;
+static SimChild_t sim_children[2 * SIM_MAX_APPS]; // the spare of the application i runs in i + SIM_MAX_APPS
+static int sim_pid_counter;
+static int sim_checks; // checks of the running simulation
+static int sim_passed;
+
+static SimChild_t *sim_find(int pid)
+{
+    for(int i = 0; i < sim_apps; i++)
+    {
+        if(sim_children[i].pid == pid && 0 < pid)
+        {
+            return &sim_children[i];
+        }
+
+        if(sim_children[i + SIM_MAX_APPS].pid == pid && 0 < pid)
+        {
+            return &sim_children[i + SIM_MAX_APPS];
+        }
+    }
+
+    return NULL;
+}
+
+static int sim_spawn(int i)
+{
+    // A spare is spawned while the application is running
+    SimChild_t *c = sim_children[i].alive ? &sim_children[i + SIM_MAX_APPS] : &sim_children[i];
+
+    if(c->alive)
+    {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    c->pid = SIM_PID_BASE + ++sim_pid_counter;
+    c->alive = true;
+    c->stopped = false;
+    c->spawned_at = clock_ms();
+    c->next_heartbeat = c->spawned_at + sim_scripts[i].startup * 1000;
+    c->seed = (uint32_t)c->pid;
+    c->spawns++;
+    return c->pid;
+}
+
+static int sim_kill(int pid, int sig)
+{
+    SimChild_t *c = sim_find(pid);
+
+    if(NULL == c || !c->alive)
+    {
+        errno = ESRCH;
+        return -1;
+    }
+
+    if(SIGKILL == sig || (SIGTERM == sig && !sim_scripts[(c - sim_children) % SIM_MAX_APPS].ignore_sigterm))
+    {
+        c->alive = false;
+    }
+    else if(SIGSTOP == sig && !c->stopped)
+    {
+        c->stopped = true;
+        c->stopped_at = clock_ms();
+    }
+    else if(SIGCONT == sig && c->stopped)
+    {
+        // A paused child neither runs towards its crash nor sends heartbeats
+        c->stopped = false;
+        c->spawned_at += clock_ms() - c->stopped_at;
+        c->next_heartbeat += clock_ms() - c->stopped_at;
+    }
+
+    return 0;
+}
+
+static int sim_wait(int pid, int *status, int options)
+{
+    SimChild_t *c = sim_find(pid);
+    UNUSED(options);
+
+    if(NULL == c || !c->alive)
+    {
+        *status = 0; // exited
+        errno = ECHILD;
+        return -1;
+    }
+
+    *status = 0xffff; // continued, still running
+    return pid;
+}
+
+static void sim_remove_stats(void)
+{
+    for(int i = 0; i < get_app_count(); i++)
+    {
+        char fname[MAX_APP_NAME_LENGTH * 2];
+        snprintf(fname, sizeof(fname), "stats_%s.raw", get_app_name(i));
+        f_exist(fname) ? f_remove(fname) : (void)0;
+        snprintf(fname, sizeof(fname), "stats_%s.log", get_app_name(i));
+        f_exist(fname) ? f_remove(fname) : (void)0;
+    }
+}
+
+// Writes the ini of the scripted children and switches to the simulated clock and processes
+static bool sim_start(const char *ini, const SimScript_t *scripts, int count)
+{
+    static const ProcessOps_t sim_ops = { sim_spawn, sim_kill, sim_wait };
+    char cfg[4096], *p = cfg;
+    sim_scripts = scripts;
+    sim_apps = count;
+    sim_checks = 0;
+    sim_passed = 0;
+    memset(sim_children, 0, sizeof(sim_children));
+    p += sprintf(p, "[processWatchdog]\nudp_port = 12398\nnWdtApps = %d\n", count);
+
+    for(int i = 0; i < count; i++)
+    {
+        p += sprintf(p, "%d_name = %s\n%d_start_delay = %d\n%d_heartbeat_delay = 60\n%d_heartbeat_interval = 30\n",
+                     i + 1, scripts[i].name, i + 1, scripts[i].start_delay, i + 1, i + 1);
+
+        if(NULL != scripts[i].depends_on)
+        {
+            p += sprintf(p, "%d_depends_on = %s\n", i + 1, scripts[i].depends_on);
+        }
+
+        for(const char *key = scripts[i].ini; NULL != key && '\0' != *key; key += strcspn(key, "\n"), key += ('\n' == *key))
+        {
+            p += sprintf(p, "%d_%.*s\n", i + 1, (int)strcspn(key, "\n"), key);
+        }
+
+        p += sprintf(p, "%d_cmd = /bin/false\n", i + 1);
+    }
+
+    f_write(ini, cfg, strlen(cfg));
+    clock_simulate(true);
+    set_process_ops(&sim_ops);
+
+    if(set_ini_file((char *)ini) || read_ini_file() || count > get_app_count())
+    {
+        printf("Error on preparing the simulation\n");
+        set_process_ops(NULL);
+        clock_simulate(false);
+        f_remove(ini);
+        return false;
+    }
+
+    // The statistics files of a previous run are not read
+    sim_remove_stats();
+
+    for(int i = 0; i < get_app_count(); i++)
+    {
+        stats_read_from_file(i);
+    }
+
+    return true;
+}
+
+// One iteration of the main loop with scripted children
+static void sim_step(void)
+{
+    char data[64];
+    int length;
+    clk_t now = clock_ms();
+
+    for(int k = 0; k < 2 * sim_apps; k++)
+    {
+        int i = (k < sim_apps) ? k : k - sim_apps + SIM_MAX_APPS;
+        SimChild_t *c = &sim_children[i];
+        const SimScript_t *s = &sim_scripts[i % SIM_MAX_APPS];
+        clk_t uptime = now - c->spawned_at;
+
+        if(!c->alive || c->stopped)
+        {
+            continue;
+        }
+
+        if(0 < s->crash_every && uptime >= (clk_t)s->crash_every * 1000)
+        {
+            c->alive = false;
+        }
+        else if(now >= c->next_heartbeat && (0 == s->hang_after || uptime < (clk_t)s->hang_after * 1000))
+        {
+            length = snprintf(data, sizeof(data), "p%d", c->pid);
+
+            if(0 < s->ready_after && uptime >= (clk_t)s->ready_after * 1000)
+            {
+                length += snprintf(&data[length], sizeof(data) - length, " READY=1");
+            }
+
+            if(0 < s->next)
+            {
+                length += snprintf(&data[length], sizeof(data) - length, " NEXT=%d", s->next * 1000);
+            }
+
+            parse_commands(data, length);
+            c->last_heartbeat = now;
+            c->next_heartbeat += (0 < s->next ? s->next - 1 : s->heartbeat_every) * 1000; // late ones are queued like datagrams
+
+            if(0 < s->jitter)
+            {
+                c->seed = c->seed * 1103515245 + 12345;
+                c->next_heartbeat += ((int)(c->seed >> 16) % (2 * s->jitter + 1) - s->jitter) * s->heartbeat_every * 10;
+            }
+        }
+    }
+
+    length = sizeof(data) - 1;
+    udp_poll(-1, 500, data, &length);
+    monitor_applications();
+}
+
+// Prints the result of a check of the running simulation
+static void sim_check(const char *what, bool ok)
+{
+    printf("%-56s %s\n", what, ok ? "Success" : "Fail!");
+    sim_checks++;
+    sim_passed += ok ? 1 : 0;
+}
+
+// Prints the statistics of the application to stats_<name>.log and reads them into text
+static bool sim_stats_text(int i, char *text, int size)
+{
+    char fname[MAX_APP_NAME_LENGTH * 2];
+    snprintf(fname, sizeof(fname), "stats_%s.log", get_app_name(i));
+    stats_print_to_file(i);
+    int length = f_size(fname);
+    text[0] = '\0';
+    return 0 < length && length < size && length < f_read(fname, text, length);
+}
+
+// Returns the longest failure to detection interval of the application, 0 if none (milliseconds)
+static clk_t sim_max_detection(int i)
+{
+    char text[4096];
+    const char *line = sim_stats_text(i, text, sizeof(text)) ? strstr(text, "Failure to detection: count ") : NULL;
+    const char *max = (NULL != line) ? strstr(line, ", max ") : NULL;
+
+    if(NULL == max || NULL != memchr(line, '\n', max - line))
+    {
+        return 0;
+    }
+
+    return (clk_t)strtoull(max + 6, NULL, 10);
+}
+
+static void sim_stop(const char *ini)
+{
+    if(0 < sim_checks)
+    {
+        printf("%d of %d checks passed\n", sim_passed, sim_checks);
+    }
+
+    sim_remove_stats();
+    set_process_ops(NULL);
+    clock_simulate(false);
+    f_remove(ini);
+}
+
+void test_simulate()
+{
+    static const SimScript_t scripts[] =
+    {
+        { "SimCrash", 5, 10, 180, 0, false, 5, NULL, NULL, 0, 0, 0 },
+        { "SimHang", 20, 10, 0, 3600, true, 10, NULL, NULL, 0, 0, 0 },
+        { "SimSteady", 5, 10, 0, 0, false, 15, NULL, NULL, 0, 0, 0 },
+        { "SimCrashLoop", 1, 10, 1, 0, false, 20, NULL, NULL, 0, 0, 0 },
+    };
+    const char *ini = "simulate.ini";
+    const int hours = 24;
+
+    if(!sim_start(ini, scripts, sizeof(scripts) / sizeof(scripts[0])))
+    {
+        return;
+    }
+
+    clk_t wall = time_ms();
+    clk_t end = clock_ms() + (clk_t)hours * 3600 * 1000;
+
+    while(clock_ms() < end)
+    {
+        sim_step();
+    }
+
+    wall = elapsed_ms(wall);
+    printf("\nSimulated %d hours in %llu ms (%.0fx real time)\n", hours, (unsigned long long)wall,
+           (double)hours * 3600 * 1000 / (double)(wall ? wall : 1));
+
+    for(int i = 0; i < get_app_count(); i++)
+    {
+        printf("\n%s spawned %d times\n", get_app_name(i), sim_children[i].spawns);
+        stats_print_latency(i, stdout, false);
+    }
+
+    // A crash is seen by the next scan, a hang once the heartbeat interval has passed
+    printf("\n");
+    sim_check("SimSteady spawned once", 1 == sim_children[2].spawns);
+
+    for(int i = 0; i < get_app_count(); i++)
+    {
+        char what[128];
+        clk_t bound = (clk_t)(0 < scripts[i].hang_after ? 30 * 1000 : 0) + 500;
+        clk_t detection = sim_max_detection(i);
+
+        if(0 == scripts[i].crash_every && 0 == scripts[i].hang_after)
+        {
+            continue;
+        }
+
+        snprintf(what, sizeof(what), "%s failures detected within %llu ms", get_app_name(i), (unsigned long long)bound);
+        sim_check(what, 0 < detection && detection <= bound);
+    }
+
+    sim_stop(ini);
+}
+
+void test_boot()
+{
+    // Database <- Broker <- Api <- Ui and an independent Metrics, critical path 8 + 3 + 4 + 2 = 17 s
+    static const SimScript_t scripts[] =
+    {
+        { "Database", 8, 5, 0, 0, false, 0, NULL, NULL, 0, 0, 0 },
+        { "Broker", 3, 5, 0, 0, false, 0, "Database", NULL, 0, 0, 0 },
+        { "Api", 4, 5, 0, 0, false, 0, "Database, Broker", NULL, 0, 0, 0 },
+        { "Ui", 2, 5, 0, 0, false, 0, "Api", NULL, 0, 0, 0 },
+        { "Metrics", 1, 5, 0, 0, false, 2, NULL, NULL, 0, 0, 0 },
+    };
+    const int count = sizeof(scripts) / sizeof(scripts[0]);
+    const char *ini = "boot.ini";
+    clk_t ready[SIM_MAX_APPS] = {0};
+    int booted = 0;
+
+    if(!sim_start(ini, scripts, count))
+    {
+        return;
+    }
+
+    clk_t start = clock_ms();
+
+    while(booted < count && clock_ms() - start < 120 * 1000)
+    {
+        sim_step();
+
+        for(int i = 0; i < count; i++)
+        {
+            if(0 == ready[i] && is_application_ready(i))
+            {
+                ready[i] = clock_ms() - start;
+                booted++;
+            }
+        }
+    }
+
+    for(int i = 0; i < count; i++)
+    {
+        printf("%-10s spawned at %6llu ms, ready at %6llu ms\n", scripts[i].name,
+               (unsigned long long)(sim_children[i].spawned_at - start), (unsigned long long)ready[i]);
+    }
+
+    printf("%d of %d apps booted in %llu ms, critical path 17000 ms\n", booted, count,
+           (unsigned long long)(clock_ms() - start));
+    sim_stop(ini);
+}
+
+void test_readiness()
+{
+    // Service heartbeats from 2 s but is ready at 20 s only, Client depends on it, Stuck never becomes ready
+    static const SimScript_t scripts[] =
+    {
+        { "Service", 2, 2, 0, 0, false, 0, NULL, "readiness = notify", 20, 0, 0 },
+        { "Client", 1, 2, 0, 0, false, 0, "Service", NULL, 0, 0, 0 },
+        { "Stuck", 2, 2, 0, 0, false, 0, NULL, "readiness = notify\nready_timeout = 30", 0, 0, 0 },
+    };
+    const char *ini = "readiness.ini";
+    bool early = false;
+    clk_t ready = 0, spawned = 0, respawned = 0;
+
+    if(!sim_start(ini, scripts, sizeof(scripts) / sizeof(scripts[0])))
+    {
+        return;
+    }
+
+    clk_t start = clock_ms();
+
+    while(clock_ms() - start < 60 * 1000)
+    {
+        sim_step();
+        clk_t uptime = clock_ms() - sim_children[0].spawned_at;
+
+        // Heartbeats without READY=1 keep it alive but do not make it ready
+        early |= (0 < sim_children[0].spawns && uptime < 20 * 1000 && is_application_ready(0));
+
+        if(0 == ready && is_application_ready(0))
+        {
+            ready = uptime;
+        }
+
+        if(0 == spawned && 0 < sim_children[1].spawns)
+        {
+            spawned = sim_children[1].spawned_at - sim_children[0].spawned_at;
+        }
+
+        if(0 == respawned && 1 < sim_children[2].spawns)
+        {
+            respawned = sim_children[2].spawned_at - start;
+        }
+    }
+
+    printf("Service ready at %llu ms, Client spawned at %llu ms, Stuck respawned at %llu ms\n", (unsigned long long)ready,
+           (unsigned long long)spawned, (unsigned long long)respawned);
+    sim_check("not ready on the heartbeats before READY=1", !early);
+    sim_check("ready on the first heartbeat with READY=1", 20 * 1000 <= ready && ready < 23 * 1000);
+    sim_check("dependent started once READY=1 is received", ready <= spawned && spawned < ready + 1000);
+    sim_check("not restarted while starting", 1 == sim_children[0].spawns);
+    sim_check("restarted when not ready within ready_timeout", 30 * 1000 <= respawned && respawned < 32 * 1000);
+    sim_stop(ini);
+}
+
+void test_next_heartbeat()
+{
+    // Pauses longer than heartbeat_interval (30 s), honoured up to heartbeat_max only
+    static const SimScript_t scripts[] =
+    {
+        { "Compaction", 5, 10, 0, 0, false, 0, NULL, "heartbeat_max = 120", 0, 90, 0 },
+        { "Overlong", 5, 10, 0, 0, false, 0, NULL, "heartbeat_max = 60", 0, 100, 0 },
+    };
+    const char *ini = "next_heartbeat.ini";
+    clk_t first = 0, restarted = 0;
+
+    if(!sim_start(ini, scripts, sizeof(scripts) / sizeof(scripts[0])))
+    {
+        return;
+    }
+
+    clk_t start = clock_ms();
+
+    while(clock_ms() - start < 30 * 60 * 1000)
+    {
+        sim_step();
+
+        if(0 == first && 0 < sim_children[1].spawns)
+        {
+            first = sim_children[1].spawned_at;
+        }
+
+        if(0 == restarted && 1 < sim_children[1].spawns)
+        {
+            restarted = sim_children[1].spawned_at - first;
+        }
+    }
+
+    printf("Compaction spawned %d times, Overlong restarted after %llu ms\n", sim_children[0].spawns,
+           (unsigned long long)restarted);
+    sim_check("NEXT longer than heartbeat_interval is honoured", 1 == sim_children[0].spawns);
+    sim_check("NEXT longer than heartbeat_max is cut to heartbeat_max", 65 * 1000 <= restarted && restarted < 67 * 1000);
+    sim_stop(ini);
+}
+
+void test_phi()
+{
+    // Every 10 s with 20% jitter, then a gap from 600 s, suspected well before heartbeat_interval (30 s)
+    static const SimScript_t scripts[] =
+    {
+        { "Jittery", 5, 10, 0, 600, false, 0, NULL, "phi_threshold = 8", 0, 0, 20 },
+    };
+    const char *ini = "phi.ini";
+    clk_t detected = 0;
+    int i;
+
+    if(!sim_start(ini, scripts, sizeof(scripts) / sizeof(scripts[0])))
+    {
+        return;
+    }
+
+    // Detector alone, on the slot of the application before it is started
+    phi_reset(0);
+
+    for(i = 0; i < PHI_MIN_SAMPLES - 1; i++)
+    {
+        phi_heartbeat(0, 10000);
+    }
+
+    sim_check("no suspicion before PHI_MIN_SAMPLES intervals", 0 == phi_value(0, 60000));
+    phi_heartbeat(0, 10000);
+    double on_time = phi_value(0, 10000), late = phi_value(0, 10000 + 3 * PHI_MIN_STDDEV);
+    sim_check("PHI_MIN_STDDEV keeps a regular one finite", 0 < on_time && on_time < 1 && 2 < late && late < 4);
+    sim_check("threshold crossed as the silence grows", late < phi_value(0, 10000 + 6 * PHI_MIN_STDDEV));
+
+    for(i = 0; i < PHI_WINDOW; i++)
+    {
+        phi_heartbeat(0, 20000);
+    }
+
+    // The window only holds the 20 s intervals now, its deviation is back to the minimum
+    late = phi_value(0, 20000 + 3 * PHI_MIN_STDDEV);
+    sim_check("window slides to the recent intervals", phi_value(0, 20000) < 1 && 2 < late && late < 4);
+    phi_reset(0);
+
+    clk_t start = clock_ms();
+
+    while(clock_ms() - start < 15 * 60 * 1000 && 0 == detected)
+    {
+        sim_step();
+
+        if(1 < sim_children[0].spawns || (0 < sim_children[0].spawns && !sim_children[0].alive))
+        {
+            detected = clock_ms() - sim_children[0].last_heartbeat;
+        }
+    }
+
+    // Stopped on the first suspicion, so an early one shows as an earlier last heartbeat
+    clk_t uptime = sim_children[0].last_heartbeat - sim_children[0].spawned_at;
+    printf("Jittery suspected %llu ms after its last heartbeat at %llu ms of uptime\n", (unsigned long long)detected,
+           (unsigned long long)uptime);
+    sim_check("not suspected under jitter", 1 == sim_children[0].spawns && 590 * 1000 <= uptime);
+    sim_check("suspected after a gap before heartbeat_interval", 12 * 1000 < detected && detected < 30 * 1000);
+    sim_stop(ini);
+}
+
+void test_stats()
+{
+    static const SimScript_t scripts[] =
+    {
+        { "Recorder", 2, 5, 60, 0, false, 0, NULL, NULL, 0, 0, 0 },
+    };
+    const char *ini = "stats.ini";
+    const char *raw = "stats_Recorder.raw";
+    // The last resource sample and the restart latencies are kept in memory only
+    static const char *volatile_lines[] = { "Memory:", "CPU:", "Disk I/O:", "Failure to", "Detection to", "Respawn to", "MTTR:", "Availability:" };
+    char before[4096], after[4096], line[256];
+    bool kept = true;
+
+    if(!sim_start(ini, scripts, sizeof(scripts) / sizeof(scripts[0])))
+    {
+        return;
+    }
+
+    clk_t start = clock_ms();
+
+    while(clock_ms() - start < 5 * 60 * 1000)
+    {
+        sim_step();
+    }
+
+    // The events recorded by the later features, persisted with the crashes and heartbeats
+    stats_crash_loop_at(0);
+    stats_resource_reset_at(0);
+    stats_rollout_at(0);
+    stats_rollout_failed(0);
+    stats_promoted_at(0);
+    stats_leftover_processes(0, 3);
+    stats_update_resources(0, 2048, 50, 0, 0);
+    sim_stats_text(0, before, sizeof(before));
+    sim_check("fields counted", NULL != strstr(before, "Crash loop count: 1\n") &&
+              NULL != strstr(before, "Resource limit reset count: 1\n") && NULL != strstr(before, "Rollout count: 1\n") &&
+              NULL != strstr(before, "Rollout failure count: 1\n") && NULL != strstr(before, "Spare promotion count: 1\n") &&
+              NULL != strstr(before, "Leftover process count: 3\n") && NULL != strstr(before, "maximum 2048 KB\n") &&
+              NULL != strstr(before, "maximum 50%\n") && NULL == strstr(before, "Crash count: 0\n"));
+    stats_write_to_file(0);
+
+    // Changed after the write, the read must bring back the written values
+    stats_crashed_at(0);
+    stats_promoted_at(0);
+    stats_rollout_failed(0);
+    stats_leftover_processes(0, 1);
+    stats_read_from_file(0);
+    sim_stats_text(0, after, sizeof(after));
+
+    for(const char *p = before; '\0' != *p; p += strcspn(p, "\n"), p += ('\n' == *p))
+    {
+        bool persisted = true;
+        snprintf(line, sizeof(line), "%.*s", (int)strcspn(p, "\n") + 1, p);
+
+        for(size_t k = 0; k < sizeof(volatile_lines) / sizeof(volatile_lines[0]); k++)
+        {
+            persisted &= (0 != strncmp(line, volatile_lines[k], strlen(volatile_lines[k])));
+        }
+
+        kept &= (!persisted || NULL != strstr(after, line));
+    }
+
+    sim_check("all fields written and read back", kept && NULL != strstr(after, "maximum 2048 KB\n"));
+
+    // A truncated file and a file of another layout are reset
+    f_write(raw, before, 16);
+    stats_read_from_file(0);
+    sim_stats_text(0, after, sizeof(after));
+    sim_check("truncated file reset", NULL != strstr(after, "Crash count: 0\n") &&
+              NULL != strstr(after, "Spare promotion count: 0\n"));
+    stats_crashed_at(0);
+    stats_write_to_file(0);
+    int size = f_size(raw);
+    memset(after, 0xA5, sizeof(after));
+    f_write(raw, after, size);
+    stats_read_from_file(0);
+    sim_stats_text(0, after, sizeof(after));
+    sim_check("file with another magic reset", 0 < size && NULL != strstr(after, "Crash count: 0\n"));
+    sim_stop(ini);
+}
+
+void test_handover()
+{
+    // Steady is handed over running, Flapping while waiting for its restart
+    static const SimScript_t scripts[] =
+    {
+        { "Steady", 2, 5, 0, 0, false, 0, NULL, NULL, 0, 0, 0 },
+        { "Flapping", 1, 5, 1, 0, false, 0, NULL, "restart_backoff = 10", 0, 0, 0 },
+    };
+    const char *ini = "handover.ini";
+    const char *path = "handover.state";
+    char line[256];
+
+    if(!sim_start(ini, scripts, sizeof(scripts) / sizeof(scripts[0])))
+    {
+        return;
+    }
+
+    clk_t start = clock_ms();
+
+    while(clock_ms() - start < 120 * 1000 && !(get_first_heartbeat(0) && is_restart_pending(1) && 0 < get_backoff_level(1)))
+    {
+        sim_step();
+    }
+
+    int level = get_backoff_level(1);
+    uint64_t delay = get_restart_delay(1);
+    int saved = state_save(path);
+
+    // The simulated PIDs have no start time to verify, Steady stands for the test itself from here
+    FILE *fp = fopen(path, "ae");
+
+    if(NULL != fp)
+    {
+        fprintf(fp, "%d 0 %llu 1 %llu 0 0 %s\n", getpid(), process_start_time(getpid()),
+                (unsigned long long)(clock_ms() - get_heartbeat_ms(0)), get_app_name(0));
+        fclose(fp);
+    }
+
+    sim_children[0].pid = getpid();
+    sim_children[0].next_heartbeat = clock_ms() + 5 * 1000;
+
+    // The next watchdog
+    read_ini_file();
+    int restored = state_restore(path);
+    sim_check("only the verifiable processes saved", 1 == saved);
+    // The restart time is kept non-zero with 1 ms
+    sim_check("restarting one resumed with its backoff", is_restart_pending(1) && level == get_backoff_level(1) &&
+              get_restart_delay(1) <= delay + 1);
+    sim_check("running one adopted", 2 == restored && getpid() == get_app_pid(0) && get_first_heartbeat(0));
+    sim_check("state file removed once read", !f_exist(path));
+    start = clock_ms();
+
+    while(clock_ms() - start < 60 * 1000)
+    {
+        sim_step();
+    }
+
+    sim_check("adopted one kept running", 1 == sim_children[0].spawns && getpid() == get_app_pid(0));
+
+    // A process started after the save is not the saved one
+    snprintf(line, sizeof(line), "%s %d\n%d 0 %llu 1 0 0 0 %s\n", "processWatchdog-state", STATE_VERSION, getpid(),
+             process_start_time(getpid()) + 1, get_app_name(0));
+    f_write(path, line, strlen(line));
+    sim_children[0].pid = 0;
+    read_ini_file();
+    sim_check("other process with the same PID not adopted", 0 == state_restore(path) && !is_application_started(0));
+    sim_stop(ini);
+}
+
+void test_warm_spare()
+{
+    // Crashes after every 2 minutes of running, a paused spare takes over
+    static const SimScript_t scripts[] =
+    {
+        { "Primary", 5, 5, 120, 0, false, 0, NULL, "warm_spare = 1", 0, 0, 0 },
+    };
+    const char *ini = "warm_spare.ini";
+    char text[4096], promotions[64];
+    int last = 0, promoted = 0, restarted = 0;
+    bool paused = false;
+
+    if(!sim_start(ini, scripts, sizeof(scripts) / sizeof(scripts[0])))
+    {
+        return;
+    }
+
+    clk_t start = clock_ms();
+
+    while(clock_ms() - start < 10 * 60 * 1000)
+    {
+        int spare = 0;
+
+        for(int k = 0; k < 2; k++)
+        {
+            const SimChild_t *c = &sim_children[k * SIM_MAX_APPS];
+            spare = (c->alive && c->stopped) ? c->pid : spare;
+        }
+
+        paused |= (0 < spare && is_spare_ready(0));
+        sim_step();
+        int pid = get_app_pid(0);
+
+        if(0 < pid && pid != last)
+        {
+            promoted += (pid == spare) ? 1 : 0;
+            restarted += (0 < last && pid != spare) ? 1 : 0;
+            last = pid;
+        }
+    }
+
+    sim_stats_text(0, text, sizeof(text));
+    const char *mttr = strstr(text, "MTTR: ");
+    snprintf(promotions, sizeof(promotions), "Spare promotion count: %d\n", promoted);
+    printf("Primary spawned %d times, %d promotions, %d restarts\n",
+           sim_children[0].spawns + sim_children[SIM_MAX_APPS].spawns, promoted, restarted);
+    sim_check("spare paused after its first heartbeat", paused);
+    sim_check("crashes taken over by the spare", 3 <= promoted && 0 == restarted);
+    sim_check("promotions counted in the statistics", NULL != strstr(text, promotions));
+    sim_check("recovered within an iteration of the main loop", NULL != mttr && strtoull(mttr + 6, NULL, 10) < 1000);
+    sim_stop(ini);
+}
+
+// Sends a datagram or connects to the socket, then checks that only it is pending activation
+static void activation_queue(int fd, int type, const struct sockaddr *addr, socklen_t length, const char *what)
+{
+    char data[8];
+    int client = socket(addr->sa_family, type, 0);
+    bool sent = (0 <= client) && (SOCK_DGRAM == type ? 0 < sendto(client, "x", 1, 0, addr, length) : 0 == connect(client, addr, length));
+    bool pending = sent && activation_pending(0);
+    bool taken = false;
+
+    // The queued connection or datagram is taken like the application would
+    if(pending && SOCK_DGRAM == type)
+    {
+        taken = (0 < recv(fd, data, sizeof(data), 0));
+    }
+    else if(pending)
+    {
+        int connection = accept(fd, NULL, NULL);
+        taken = (0 <= connection);
+
+        if(taken)
+        {
+            close(connection);
+        }
+    }
+
+    if(0 <= client)
+    {
+        close(client);
+    }
+
+    sim_check(what, taken && !activation_pending(0));
+}
+
+void test_activation()
+{
+    const char *ini = "activation.ini";
+    const char *path = "/tmp/processWatchdog_activation.sock";
+    char cfg[1024];
+    int fds[MAX_LISTEN_FDS], type[MAX_LISTEN_FDS];
+    socklen_t size = sizeof(int);
+    struct sockaddr_in in;
+    struct sockaddr_un un;
+
+    snprintf(cfg, sizeof(cfg), "[processWatchdog]\nudp_port = 12398\nnWdtApps = 1\n"
+             "1_name = Activated\n1_start_delay = 0\n1_heartbeat_delay = 10\n1_heartbeat_interval = 5\n"
+             "1_listen = udp:127.0.0.1:18124, unixgram:%s, tcp:127.0.0.1:18125\n1_activation = on_demand\n"
+             "1_cmd = /bin/false\n", path);
+    f_write(ini, cfg, strlen(cfg));
+    sim_checks = 0;
+    sim_passed = 0;
+
+    if(set_ini_file((char *)ini) || read_ini_file() || 3 != activation_open(0))
+    {
+        printf("Error on opening the sockets\n");
+        activation_close(0, true);
+        f_remove(ini);
+        return;
+    }
+
+    for(int k = 0; k < activation_fds(0, fds, MAX_LISTEN_FDS); k++)
+    {
+        getsockopt(fds[k], SOL_SOCKET, SO_TYPE, &type[k], &size);
+    }
+
+    sim_check("udp and unixgram sockets are datagram sockets", SOCK_DGRAM == type[0] && SOCK_DGRAM == type[1]);
+    sim_check("tcp socket is a stream socket", SOCK_STREAM == type[2]);
+    sim_check("nothing pending before the first datagram", !activation_pending(0));
+
+    memset(&in, 0, sizeof(in));
+    in.sin_family = AF_INET;
+    in.sin_addr.s_addr = inet_addr("127.0.0.1");
+    in.sin_port = htons(18124);
+    activation_queue(fds[0], SOCK_DGRAM, (struct sockaddr *)&in, sizeof(in), "activated by a udp datagram");
+    memset(&un, 0, sizeof(un));
+    un.sun_family = AF_UNIX;
+    strcpy(un.sun_path, path);
+    activation_queue(fds[1], SOCK_DGRAM, (struct sockaddr *)&un, sizeof(un), "activated by a unixgram datagram");
+    in.sin_port = htons(18125);
+    activation_queue(fds[2], SOCK_STREAM, (struct sockaddr *)&in, sizeof(in), "activated by a tcp connection");
+
+    activation_close(0, true);
+    sim_check("unixgram path removed with its socket", !f_exist(path));
+    printf("%d of %d checks passed\n", sim_passed, sim_checks);
+    f_remove(ini);
+}
+
 void test_exit_normal()
 {
     printf("Exit normal\n");
@@ -121,6 +1130,54 @@ void test(char *testname)
     {
         test_delay();
     }
+    cmp("trace")
+    {
+        test_trace();
+    }
+    cmp("heartbeat")
+    {
+        test_heartbeat();
+    }
+    cmp("restart_latency")
+    {
+        test_restart_latency();
+    }
+    cmp("simulate")
+    {
+        test_simulate();
+    }
+    cmp("boot")
+    {
+        test_boot();
+    }
+    cmp("readiness")
+    {
+        test_readiness();
+    }
+    cmp("next_heartbeat")
+    {
+        test_next_heartbeat();
+    }
+    cmp("phi")
+    {
+        test_phi();
+    }
+    cmp("stats")
+    {
+        test_stats();
+    }
+    cmp("handover")
+    {
+        test_handover();
+    }
+    cmp("warm_spare")
+    {
+        test_warm_spare();
+    }
+    cmp("activation")
+    {
+        test_activation();
+    }
     cmp("exit_normal")
     {
         test_exit_normal();
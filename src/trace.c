@@ -0,0 +1,356 @@
+/**
+    @file trace.c
+    @brief Process Watchdog Application Manager
+
+    The Process Watchdog application manages the processes listed in the configuration file.
+    It listens to a specified UDP port for heartbeat messages from these processes, which must
+    periodically send their PID. If any process stops running or fails to send its PID over UDP
+    within the expected interval, the Process Watchdog application will restart the process.
+
+    The application ensures high reliability and availability by continuously monitoring and
+    restarting processes as necessary. It also logs various statistics about the monitored
+    processes, including start times, crash times, and heartbeat intervals.
+
+    @date 2023-01-01
+    @version 1.0
+    @author by Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license GPL-3 License
+*/
+
+#include "trace.h"
+#include "apps.h"
+#include "clock.h"
+#include "log.h"
+#include "utils.h"
+
+#include <pthread.h>
+
+/**
+    @brief Structure representing a buffered trace event.
+*/
+typedef struct
+{
+    clk_t ts; /**< Monotonic timestamp of the event (milliseconds). */
+    int app; /**< Index of the application. */
+    char ph; /**< Chrome trace event type: B, E, i or M. */
+    char name[MAX_APP_NAME_LENGTH]; /**< Name of the event, copied as the application can be renamed before the flush. */
+} TraceEvent_t;
+
+static const char *phase_names[TRACE_PHASE_MAX] =
+{
+    "none",
+    "start_delay",
+    "spawn->first heartbeat",
+    "running",
+    "stopping",
+    "restart backoff"
+};
+
+static TraceEvent_t events[TRACE_BUFFER_SIZE]; // filled by the main loop
+static TraceEvent_t flushing[TRACE_BUFFER_SIZE]; // owned by the flush thread
+static int event_count;
+static size_t dropped_count;
+static trace_phase_t phases[MAX_APPS];
+static bool named[MAX_APPS];
+
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t trace_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t flush_thread;
+static volatile bool running;
+static FILE *fp;
+static bool first_event;
+static int wdt_pid;
+
+static void push(int i, char ph, const char *name)
+{
+    pthread_mutex_lock(&trace_lock);
+
+    if(event_count < TRACE_BUFFER_SIZE)
+    {
+        events[event_count].ts = clock_ms();
+        events[event_count].app = i;
+        events[event_count].ph = ph;
+        snprintf(events[event_count].name, sizeof(events[event_count].name), "%s", name);
+        event_count++;
+
+        if(event_count >= TRACE_BUFFER_SIZE / 2)
+        {
+            pthread_cond_signal(&trace_cond);
+        }
+    }
+    else
+    {
+        dropped_count++;
+    }
+
+    pthread_mutex_unlock(&trace_lock);
+}
+
+// Writes the string quoted and escaped for JSON
+static void write_string(const char *str)
+{
+    fputc('"', fp);
+
+    for(const unsigned char *c = (const unsigned char *)str; '\0' != *c; c++)
+    {
+        if('"' == *c || '\\' == *c)
+        {
+            fprintf(fp, "\\%c", *c);
+        }
+        else if(0x20 > *c)
+        {
+            fprintf(fp, "\\u%04x", *c);
+        }
+        else
+        {
+            fputc(*c, fp);
+        }
+    }
+
+    fputc('"', fp);
+}
+
+static void write_event(const TraceEvent_t *e)
+{
+    fprintf(fp, "%s", first_event ? "\n" : ",\n");
+    first_event = false;
+
+    switch(e->ph)
+    {
+        case 'M':
+            fprintf(fp, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":", wdt_pid, e->app + 1);
+            write_string(e->name);
+            fprintf(fp, "}}");
+            break;
+
+        case 'i':
+            fprintf(fp, "{\"name\":");
+            write_string(e->name);
+            fprintf(fp, ",\"ph\":\"i\",\"s\":\"t\",\"ts\":%llu,\"pid\":%d,\"tid\":%d}",
+                    (unsigned long long)e->ts * 1000, wdt_pid, e->app + 1);
+            break;
+
+        default:
+            fprintf(fp, "{\"name\":");
+            write_string(e->name);
+            fprintf(fp, ",\"ph\":\"%c\",\"ts\":%llu,\"pid\":%d,\"tid\":%d}",
+                    e->ph, (unsigned long long)e->ts * 1000, wdt_pid, e->app + 1);
+            break;
+    }
+}
+
+static void flush(void)
+{
+    int count;
+    size_t dropped;
+    pthread_mutex_lock(&trace_lock);
+    count = event_count;
+    dropped = dropped_count;
+    memcpy(flushing, events, count * sizeof(TraceEvent_t));
+    event_count = 0;
+    dropped_count = 0;
+    pthread_mutex_unlock(&trace_lock);
+
+    for(int n = 0; n < count; n++)
+    {
+        write_event(&flushing[n]);
+    }
+
+    if(dropped > 0)
+    {
+        LOGW("%zu trace events dropped, buffer is full", dropped);
+    }
+
+    fflush(fp);
+}
+
+static void *flush_loop(void *arg)
+{
+    UNUSED(arg);
+
+    while(running)
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_sec += TRACE_FLUSH_INTERVAL / 1000;
+        ts.tv_nsec += (TRACE_FLUSH_INTERVAL % 1000) * 1000000L;
+
+        if(ts.tv_nsec >= 1000000000L)
+        {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+
+        pthread_mutex_lock(&trace_lock);
+
+        if(running && event_count < TRACE_BUFFER_SIZE / 2)
+        {
+            pthread_cond_timedwait(&trace_cond, &trace_lock, &ts);
+        }
+
+        pthread_mutex_unlock(&trace_lock);
+        flush();
+    }
+
+    return NULL;
+}
+
+// Reopens the trace written before an upgrade, positioned before its closing bracket, returns NULL if it is empty
+static FILE *reopen(const char *path)
+{
+    char tail[4] = {0};
+    FILE *f = fopen(path, "r+e");
+
+    if(NULL == f)
+    {
+        return NULL;
+    }
+
+    if(0 != fseek(f, 0, SEEK_END) || 0 >= ftell(f))
+    {
+        fclose(f);
+        return NULL;
+    }
+
+    long size = ftell(f);
+
+    if(size >= 3 && 0 == fseek(f, -3, SEEK_END) && 3 == fread(tail, 1, 3, f) && 0 == strcmp(tail, "\n]\n"))
+    {
+        size -= 3;
+
+        if(0 != ftruncate(fileno(f), size))
+        {
+            LOGW("Trace file %s cannot be truncated : %s", path, strerror(errno));
+        }
+    }
+
+    fseek(f, size, SEEK_SET);
+    return f;
+}
+
+int trace_start(const char *path, bool append)
+{
+    if(running)
+    {
+        return 0;
+    }
+
+    fp = append ? reopen(path) : NULL;
+    bool appended = (NULL != fp);
+
+    if(!appended)
+    {
+        fp = fopen(path, "we");
+    }
+
+    if(NULL == fp)
+    {
+        LOGE("Error opening trace file %s : %s", path, strerror(errno));
+        return 1;
+    }
+
+    wdt_pid = getpid();
+    event_count = 0;
+    dropped_count = 0;
+    memset(phases, 0, sizeof(phases));
+    memset(named, 0, sizeof(named));
+
+    if(!appended)
+    {
+        fprintf(fp, "[");
+        fprintf(fp, "\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"processWatchdog\"}}", wdt_pid);
+    }
+
+    first_event = false;
+    running = true;
+
+    if(0 != pthread_create(&flush_thread, NULL, flush_loop, NULL))
+    {
+        LOGE("Error starting trace flush thread");
+        running = false;
+        fclose(fp);
+        fp = NULL;
+        return 1;
+    }
+
+    LOGI("Trace export %s into %s", appended ? "continued" : "started", path);
+    return 0;
+}
+
+void trace_stop(void)
+{
+    if(!running)
+    {
+        return;
+    }
+
+    for(int i = 0; i < MAX_APPS; i++)
+    {
+        trace_app_phase(i, TRACE_PHASE_NONE);
+    }
+
+    pthread_mutex_lock(&trace_lock);
+    running = false;
+    pthread_cond_signal(&trace_cond);
+    pthread_mutex_unlock(&trace_lock);
+    pthread_join(flush_thread, NULL);
+    flush();
+    fprintf(fp, "\n]\n");
+    fclose(fp);
+    fp = NULL;
+    LOGI("Trace export stopped");
+}
+
+bool trace_enabled(void)
+{
+    return running;
+}
+
+static void name_track(int i)
+{
+    if(!named[i])
+    {
+        named[i] = true;
+        push(i, 'M', get_app_name(i));
+    }
+}
+
+void trace_app_phase(int i, trace_phase_t phase)
+{
+    if(!running || phases[i] == phase)
+    {
+        return;
+    }
+
+    name_track(i);
+
+    if(TRACE_PHASE_NONE != phases[i])
+    {
+        push(i, 'E', phase_names[phases[i]]);
+    }
+
+    if(TRACE_PHASE_NONE != phase)
+    {
+        push(i, 'B', phase_names[phase]);
+    }
+
+    phases[i] = phase;
+}
+
+void trace_app_renamed(int i)
+{
+    trace_app_phase(i, TRACE_PHASE_NONE);
+    named[i] = false;
+}
+
+void trace_app_event(int i, const char *name)
+{
+    if(!running)
+    {
+        return;
+    }
+
+    name_track(i);
+    push(i, 'i', name);
+}
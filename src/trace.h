@@ -0,0 +1,100 @@
+/**
+    @file trace.h
+    @brief Process Watchdog Application Manager
+
+    The Process Watchdog application manages the processes listed in the configuration file.
+    It listens to a specified UDP port for heartbeat messages from these processes, which must
+    periodically send their PID. If any process stops running or fails to send its PID over UDP
+    within the expected interval, the Process Watchdog application will restart the process.
+
+    The application ensures high reliability and availability by continuously monitoring and
+    restarting processes as necessary. It also logs various statistics about the monitored
+    processes, including start times, crash times, and heartbeat intervals.
+
+    @date 2023-01-01
+    @version 1.0
+    @author by Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license GPL-3 License
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+
+/**
+    @file trace.h
+    @brief Process lifecycle timeline export in Chrome Trace Event JSON format.
+
+    Every application is shown as a separate track. Spans cover the lifecycle phases
+    and instant events mark heartbeats, timeouts and crashes. The events are buffered
+    in memory and written to the file by a background thread, so the output can be
+    loaded into chrome://tracing or ui.perfetto.dev.
+*/
+
+#define TRACE_BUFFER_SIZE 4096 /**< Maximum number of events buffered between two flushes. */
+#define TRACE_FLUSH_INTERVAL 1000 /**< Period of the background flush (milliseconds). */
+
+/**
+    @brief Lifecycle phases of an application, each one is shown as a span.
+*/
+typedef enum
+{
+    TRACE_PHASE_NONE = 0, /**< No span is open. */
+    TRACE_PHASE_START_DELAY, /**< Waiting for the start delay to elapse. */
+    TRACE_PHASE_STARTING, /**< Spawned, waiting for the first heartbeat. */
+    TRACE_PHASE_RUNNING, /**< Sending heartbeats. */
+    TRACE_PHASE_STOPPING, /**< Termination escalation in progress. */
+    TRACE_PHASE_BACKOFF, /**< Waiting for a scheduled restart. */
+    TRACE_PHASE_MAX
+} trace_phase_t;
+
+/**
+    @brief Opens the trace file and starts the background flush thread.
+
+    @param path Path of the trace file, it is overwritten unless append is set.
+    @param append Continue the trace written before an upgrade, it is overwritten if it is missing or empty.
+    @return 0 on success, else on failure.
+*/
+int trace_start(const char *path, bool append);
+
+/**
+    @brief Closes all open spans, flushes the buffered events and closes the trace file.
+*/
+void trace_stop(void);
+
+/**
+    @brief Checks if the trace export is running.
+
+    @return true if the events are recorded, false otherwise.
+*/
+bool trace_enabled(void);
+
+/**
+    @brief Moves the specified application into a new lifecycle phase.
+
+    The span of the previous phase is closed and the span of the new one is opened.
+
+    @param i Index of the application.
+    @param phase New phase, TRACE_PHASE_NONE only closes the current span.
+*/
+void trace_app_phase(int i, trace_phase_t phase);
+
+/**
+    @brief Closes the span of the specified application and names its track again on the next event,
+    its index is used by another application after a reload of the ini file.
+
+    @param i Index of the application.
+*/
+void trace_app_renamed(int i);
+
+/**
+    @brief Marks an instant event on the track of the specified application.
+
+    @param i Index of the application.
+    @param name Name of the event, copied into the buffered event.
+*/
+void trace_app_event(int i, const char *name);
+
+#endif // TRACE_H
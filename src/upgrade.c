@@ -0,0 +1,305 @@
+/**
+    @file upgrade.c
+    @brief Process Watchdog Application Manager
+
+    The Process Watchdog application manages the processes listed in the configuration file.
+    It listens to a specified UDP port for heartbeat messages from these processes, which must
+    periodically send their PID. If any process stops running or fails to send its PID over UDP
+    within the expected interval, the Process Watchdog application will restart the process.
+
+    The application ensures high reliability and availability by continuously monitoring and
+    restarting processes as necessary. It also logs various statistics about the monitored
+    processes, including start times, crash times, and heartbeat intervals.
+
+    @date 2023-01-01
+    @version 1.0
+    @author by Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license GPL-3 License
+*/
+
+#include "upgrade.h"
+#include "activation.h"
+#include "apps.h"
+#include "log.h"
+#include "state.h"
+#include "stats.h"
+#include "trace.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+
+#define DELETED_SUFFIX " (deleted)" // of /proc/self/exe when the binary is replaced
+
+static char exe_path[PATH_MAX]; // binary executed by an upgrade
+static char **args;
+static int state_fd = -1;
+static int socket_fd = -1;
+static int rollback_fd = -1; // previous binary, -1 after a rollback
+static bool resuming;
+static char rollback_path[64]; // /proc/self/fd/N of the previous binary
+static char rollback_env[64]; // UPGRADE_ENV=... for the previous binary
+static char **rollback_envp; // environment of the previous binary, prepared for the signal handler
+static const int fatal_signals[] = { SIGALRM, SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+
+// Executes the previous binary with the state handed over, only async-signal-safe calls are made
+static void exec_rollback(void)
+{
+    sigset_t mask;
+    fcntl(state_fd, F_SETFD, 0);
+    fcntl(socket_fd, F_SETFD, 0);
+    activation_inheritable(true);
+    // The signal mask is inherited across execve()
+    sigemptyset(&mask);
+    sigprocmask(SIG_SETMASK, &mask, NULL);
+    execve(rollback_path, args, rollback_envp);
+    int err = errno;
+    fcntl(state_fd, F_SETFD, FD_CLOEXEC);
+    fcntl(socket_fd, F_SETFD, FD_CLOEXEC);
+    activation_inheritable(false);
+    errno = err;
+}
+
+// The new image has missed its commit deadline or crashed before it
+static void rollback_handler(int sig)
+{
+    static const char msg[] = "The new image has not committed the upgrade, rolling back to the previous one\n";
+
+    if(write(STDERR_FILENO, msg, sizeof(msg) - 1) < 0)
+    {
+        // nothing to report to
+    }
+
+    exec_rollback();
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+// Prepares the rollback and arms it on the commit deadline and on the fatal signals
+static void arm_rollback(void)
+{
+    extern char **environ;
+    struct sigaction sa;
+    int count = 0;
+
+    while(NULL != environ[count])
+    {
+        count++;
+    }
+
+    snprintf(rollback_path, sizeof(rollback_path), "/proc/self/fd/%d", rollback_fd);
+    snprintf(rollback_env, sizeof(rollback_env), "%s=%d %d -1", UPGRADE_ENV, state_fd, socket_fd);
+    rollback_envp = malloc((count + 2) * sizeof(char *));
+
+    if(NULL == rollback_envp)
+    {
+        return;
+    }
+
+    memcpy(rollback_envp, environ, count * sizeof(char *));
+    rollback_envp[count] = rollback_env;
+    rollback_envp[count + 1] = NULL;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = rollback_handler;
+    sa.sa_flags = SA_RESETHAND;
+
+    for(size_t k = 0; k < sizeof(fatal_signals) / sizeof(fatal_signals[0]); k++)
+    {
+        sigaction(fatal_signals[k], &sa, NULL);
+    }
+}
+
+static void disarm_rollback(void)
+{
+    alarm(0);
+
+    for(size_t k = 0; k < sizeof(fatal_signals) / sizeof(fatal_signals[0]); k++)
+    {
+        signal(fatal_signals[k], SIG_DFL);
+    }
+
+    free(rollback_envp);
+    rollback_envp = NULL;
+}
+
+void upgrade_init(char *argv[])
+{
+    const char *env = getenv(UPGRADE_ENV);
+    ssize_t length = readlink("/proc/self/exe", exe_path, sizeof(exe_path) - 1);
+    args = argv;
+
+    if(0 < length)
+    {
+        exe_path[length] = 0;
+        size_t suffix = strlen(DELETED_SUFFIX);
+
+        // Started by a rollback, the next upgrade executes the binary installed at the path
+        if((size_t)length > suffix && 0 == strcmp(&exe_path[length - suffix], DELETED_SUFFIX))
+        {
+            exe_path[length - suffix] = 0;
+        }
+    }
+    else
+    {
+        snprintf(exe_path, sizeof(exe_path), "%s", argv[0]);
+    }
+
+    if(NULL != env)
+    {
+        resuming = (3 == sscanf(env, "%d %d %d", &state_fd, &socket_fd, &rollback_fd) && 0 <= state_fd && 0 <= socket_fd);
+
+        if(!resuming)
+        {
+            LOGE("Invalid %s : %s", UPGRADE_ENV, env);
+        }
+
+        // Not inherited by the applications
+        fcntl(state_fd, F_SETFD, FD_CLOEXEC);
+        fcntl(rollback_fd, F_SETFD, FD_CLOEXEC);
+
+        // A rollback executes /proc/self/fd/N, which names the process N
+        char name[PATH_MAX];
+        snprintf(name, sizeof(name), "%s", exe_path);
+        prctl(PR_SET_NAME, basename(name), 0, 0, 0);
+
+        unsetenv(UPGRADE_ENV);
+
+        if(resuming && 0 <= rollback_fd)
+        {
+            arm_rollback();
+        }
+    }
+}
+
+bool upgrade_resuming(void)
+{
+    return resuming;
+}
+
+int upgrade_socket(void)
+{
+    return socket_fd;
+}
+
+int upgrade_restore(void)
+{
+    return state_restore_fd(state_fd);
+}
+
+int upgrade_exec(int socket)
+{
+    char env[64];
+    int memfd = syscall(SYS_memfd_create, "processWatchdog-state", 0); // inherited by the new image
+
+    if(0 > memfd)
+    {
+        LOGE("Upgrade failed, memfd cannot be created : %s", strerror(errno));
+        return 1;
+    }
+
+    if(0 > state_save_fd(memfd))
+    {
+        close(memfd);
+        return 1;
+    }
+
+    // The running binary, even if it has been replaced on disk, for the rollback
+    int self = open("/proc/self/exe", O_RDONLY);
+    // The next watchdog adopts the applications from the state file if the new image dies before it can roll back
+    bool fallback = (0 < strlen(get_state_file()) && 0 <= state_save(get_state_file()));
+
+    for(int i = 0; i < get_app_count(); i++)
+    {
+        if(!is_application_removed(i))
+        {
+            stats_write_to_file(i);
+            stats_print_to_file(i);
+        }
+    }
+
+    bool tracing = trace_enabled();
+    trace_stop();
+    snprintf(env, sizeof(env), "%d %d %d", memfd, socket, self);
+    setenv(UPGRADE_ENV, env, 1);
+    fcntl(socket, F_SETFD, 0);
+    activation_inheritable(true);
+    LOGN("Upgrading to %s", exe_path);
+    // Preserved across execve(), the new image rolls back if it has not committed by then
+    alarm(UPGRADE_COMMIT_TIMEOUT);
+    execv(exe_path, args);
+
+    alarm(0);
+    LOGE("Upgrade to %s failed, the running image continues : %s", exe_path, strerror(errno));
+    fcntl(socket, F_SETFD, FD_CLOEXEC);
+    activation_inheritable(false);
+    unsetenv(UPGRADE_ENV);
+    close(memfd);
+
+    if(fallback)
+    {
+        unlink(get_state_file());
+    }
+
+    if(0 <= self)
+    {
+        close(self);
+    }
+
+    if(tracing)
+    {
+        trace_start(get_trace_file(), true);
+    }
+
+    return 1;
+}
+
+void upgrade_rollback(void)
+{
+    if(!resuming || 0 > rollback_fd || NULL == rollback_envp)
+    {
+        return;
+    }
+
+    LOGE("The new image has failed to start, rolling back to the previous one");
+    exec_rollback();
+    LOGE("Rollback failed : %s", strerror(errno));
+}
+
+void upgrade_commit(void)
+{
+    if(!resuming)
+    {
+        return;
+    }
+
+    disarm_rollback();
+
+    // Written for the case the new image died before it could roll back
+    if(0 < strlen(get_state_file()))
+    {
+        unlink(get_state_file());
+    }
+
+    if(0 <= rollback_fd)
+    {
+        close(rollback_fd);
+        LOGN("Upgrade completed");
+    }
+    else
+    {
+        LOGW("Rollback completed, the previous image runs again");
+    }
+
+    close(state_fd);
+    rollback_fd = -1;
+    state_fd = -1;
+    resuming = false;
+}
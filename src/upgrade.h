@@ -0,0 +1,94 @@
+/**
+    @file upgrade.h
+    @brief Process Watchdog Application Manager
+
+    The Process Watchdog application manages the processes listed in the configuration file.
+    It listens to a specified UDP port for heartbeat messages from these processes, which must
+    periodically send their PID. If any process stops running or fails to send its PID over UDP
+    within the expected interval, the Process Watchdog application will restart the process.
+
+    The application ensures high reliability and availability by continuously monitoring and
+    restarting processes as necessary. It also logs various statistics about the monitored
+    processes, including start times, crash times, and heartbeat intervals.
+
+    @date 2023-01-01
+    @version 1.0
+    @author by Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license GPL-3 License
+*/
+
+#ifndef UPGRADE_H
+#define UPGRADE_H
+
+#include <stdbool.h>
+
+/**
+    @file upgrade.h
+    @brief Live upgrade of the watchdog by re-executing its binary in place.
+
+    The state of the applications is written into a memfd and the new binary is executed
+    with execve() in the same process, so the applications stay its children. The memfd,
+    the UDP socket and a descriptor of the running binary are inherited by the new image,
+    which receives the heartbeats queued on the socket meanwhile and adopts the applications
+    without restarting them. The listening sockets of all the applications are inherited too.
+    When the new image fails to start, crashes or does not run its main loop within
+    UPGRADE_COMMIT_TIMEOUT, it executes the previous binary again with the same state. The
+    deadline is an alarm armed by the previous image, which survives execve(). If the new image
+    dies before it can roll back, the state file, if configured, lets the restarted watchdog adopt
+    the applications. The statistics are handed over by their files.
+*/
+
+#define UPGRADE_ENV "WDT_UPGRADE" /**< Environment variable passing the state, socket and rollback descriptors. */
+#define UPGRADE_COMMIT_TIMEOUT 30 /**< Time the new image has to run its main loop before it is rolled back (seconds). */
+
+/**
+    @brief Records the binary and the arguments of the watchdog and takes over the descriptors
+    handed over by the previous image, if any.
+
+    @param argv Arguments of the watchdog, used to execute the new image.
+*/
+void upgrade_init(char *argv[]);
+
+/**
+    @brief Checks if the watchdog is started by an upgrade or a rollback and has not completed it yet.
+
+    @return true if the state of the previous image is being taken over, false otherwise.
+*/
+bool upgrade_resuming(void);
+
+/**
+    @brief Gets the UDP socket handed over by the previous image.
+
+    @return Socket file descriptor, -1 if none.
+*/
+int upgrade_socket(void);
+
+/**
+    @brief Adopts the applications handed over by the previous image.
+
+    @return Number of the applications adopted, -1 on error.
+*/
+int upgrade_restore(void);
+
+/**
+    @brief Executes the binary of the watchdog in place, handing the state and the UDP socket over.
+
+    @param socket UDP socket of the watchdog.
+    @return 1 if the upgrade failed and the running image continues, it does not return otherwise.
+*/
+int upgrade_exec(int socket);
+
+/**
+    @brief Executes the previous binary again after the new image has failed to start.
+
+    Returns only when there is no previous image to roll back to.
+*/
+void upgrade_rollback(void);
+
+/**
+    @brief Completes the upgrade once the new image runs its main loop, the previous binary is released.
+*/
+void upgrade_commit(void);
+
+#endif // UPGRADE_H
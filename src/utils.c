@@ -82,21 +82,217 @@ clk_t elapsed_ms(clk_t clk)
     return (c - clk);
 }
 
+int split_command(char *command, char **argv, int max)
+{
+    int argc = 0;
+    char *src = command, *dst = command;
+
+    while(*src)
+    {
+        while(isspace((unsigned char)*src))
+        {
+            src++;
+        }
+
+        if(!*src)
+        {
+            break;
+        }
+
+        if(argc >= max - 1)
+        {
+            return -1; // no room for the terminating NULL
+        }
+
+        argv[argc++] = dst;
+        char quote = 0;
+
+        while(*src && (quote || !isspace((unsigned char)*src)))
+        {
+            if(quote == *src)
+            {
+                quote = 0; // closing quote
+            }
+            else if(!quote && ('\'' == *src || '"' == *src))
+            {
+                quote = *src; // opening quote
+            }
+            else if('\\' == *src && '\'' != quote && src[1])
+            {
+                *dst++ = *++src; // escaped character
+            }
+            else
+            {
+                *dst++ = *src;
+            }
+
+            src++;
+        }
+
+        if(quote)
+        {
+            return -1; // unterminated quote
+        }
+
+        if(*src)
+        {
+            src++;
+        }
+
+        *dst++ = '\0';
+    }
+
+    argv[argc] = NULL;
+    return argc;
+}
+
+bool find_executable(const char *name, char *path, size_t size)
+{
+    if(NULL != strchr(name, '/'))
+    {
+        snprintf(path, size, "%s", name);
+        return (0 == access(path, X_OK));
+    }
+
+    const char *dirs = getenv("PATH");
+
+    if(NULL == dirs)
+    {
+        dirs = "/usr/local/bin:/usr/bin:/bin";
+    }
+
+    while(*dirs)
+    {
+        const char *end = strchr(dirs, ':');
+
+        if(NULL == end)
+        {
+            end = dirs + strlen(dirs);
+        }
+
+        int length = (int)(end - dirs);
+
+        // An empty entry is the current directory
+        if((int)size > snprintf(path, size, "%.*s/%s", length ? length : 1, length ? dirs : ".", name)
+                && 0 == access(path, X_OK))
+        {
+            return true;
+        }
+
+        dirs = *end ? end + 1 : end;
+    }
+
+    snprintf(path, size, "%s", name);
+    return false;
+}
+
+int find_process_group(int pgid, int *pids, int max)
+{
+    int count = 0;
+    DIR *dir = opendir("/proc");
+    struct dirent *de;
+
+    if(NULL == dir)
+    {
+        return 0;
+    }
+
+    while(count < max && NULL != (de = readdir(dir)))
+    {
+        char path[64], buf[512];
+        int pid = atoi(de->d_name);
+
+        if(0 >= pid)
+        {
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+        FILE *fp = fopen(path, "re");
+
+        if(NULL == fp)
+        {
+            continue;
+        }
+
+        if(NULL != fgets(buf, sizeof(buf), fp))
+        {
+            // pid (comm) state ppid pgrp ...
+            char *p = strrchr(buf, ')');
+            char state = 0;
+            int pgrp = 0;
+
+            if(NULL != p && 2 == sscanf(p + 2, "%c %*d %d", &state, &pgrp) && pgrp == pgid && 'Z' != state)
+            {
+                pids[count++] = pid;
+            }
+        }
+
+        fclose(fp);
+    }
+
+    closedir(dir);
+    return count;
+}
+
+char *process_name(int pid, char *name, size_t size)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/comm", pid);
+    snprintf(name, size, "?");
+    FILE *fp = fopen(path, "re");
+
+    if(NULL != fp)
+    {
+        if(NULL != fgets(name, size, fp))
+        {
+            name[strcspn(name, "\n")] = 0;
+        }
+
+        fclose(fp);
+    }
+
+    return name;
+}
+
+unsigned long long process_start_time(int pid)
+{
+    char path[64], buf[512];
+    unsigned long long start_time = 0;
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    FILE *fp = fopen(path, "re");
+
+    if(NULL != fp)
+    {
+        if(NULL != fgets(buf, sizeof(buf), fp))
+        {
+            // pid (comm) state ppid pgrp session tty_nr tpgid flags minflt cminflt majflt cmajflt
+            // utime stime cutime cstime priority nice num_threads itrealvalue starttime ...
+            char *p = strrchr(buf, ')');
+
+            if(NULL == p || 1 != sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %*u %*u %*d %*d %*d %*d %*d %*d %llu",
+                                        &start_time))
+            {
+                start_time = 0;
+            }
+        }
+
+        fclose(fp);
+    }
+
+    return start_time;
+}
+
 void run_command(char *command)
 {
-    char *token;
     char *argv[1024] = {NULL};
-    int i = 0;
-    token = strtok(command, " ");
 
-    while(token != NULL)
+    if(0 < split_command(command, argv, sizeof(argv) / sizeof(argv[0])))
     {
-        argv[i++] = token;
-        token = strtok(NULL, " ");
+        execvp(argv[0], argv);
     }
 
-    execv(argv[0], argv);
-    perror("execv");
+    perror("execvp");
 }
 
 void f_rename(const char *fromfilename, const char *tofilename)
@@ -133,7 +329,7 @@ int f_size(const char *filename)
 int f_read(const char *filename, char *buf, size_t size)
 {
     size_t len = 0;
-    FILE *fp = fopen(filename, "r");
+    FILE *fp = fopen(filename, "re");
 
     if(fp != NULL)
     {
@@ -158,7 +354,7 @@ int f_read(const char *filename, char *buf, size_t size)
 int f_write(const char *filename, char *buf, size_t size)
 {
     size_t len = 0;
-    FILE *fp = fopen(filename, "w");
+    FILE *fp = fopen(filename, "we");
 
     if(fp != NULL)
     {
@@ -178,7 +374,7 @@ int f_write(const char *filename, char *buf, size_t size)
 
 void f_create(const char *filename)
 {
-    FILE *fp = fopen(filename, "w");
+    FILE *fp = fopen(filename, "we");
 
     if(fp != NULL)
     {
@@ -126,7 +126,58 @@ clk_t time_ms(void);
 clk_t elapsed_ms(clk_t clk);
 
 /**
-    @brief Executes a shell command using execv.
+    @brief Splits a command line into arguments in place.
+
+    The arguments are separated by whitespace. Single quotes keep everything literally,
+    double quotes keep the whitespace and a backslash escapes the next character.
+
+    @param command The command line, it is overwritten by the arguments.
+    @param argv Array receiving the arguments, terminated by NULL.
+    @param max Size of argv including the terminating NULL.
+    @return Number of arguments, -1 on an unterminated quote or too many arguments.
+*/
+int split_command(char *command, char **argv, int max);
+
+/**
+    @brief Resolves an executable name in PATH, names containing a slash are kept as they are.
+
+    @param name Name of the executable.
+    @param path Buffer receiving the path, the name itself if it is not found.
+    @param size Size of the buffer.
+    @return true if an executable file is found, false otherwise.
+*/
+bool find_executable(const char *name, char *path, size_t size);
+
+/**
+    @brief Finds the running members of a process group, zombies are skipped.
+
+    @param pgid Process group ID.
+    @param pids Array receiving the process IDs.
+    @param max Size of the array.
+    @return Number of processes found.
+*/
+int find_process_group(int pgid, int *pids, int max);
+
+/**
+    @brief Gets the command name of a process.
+
+    @param pid Process ID.
+    @param name Buffer receiving the name, "?" if the process is gone.
+    @param size Size of the buffer.
+    @return The name buffer.
+*/
+char *process_name(int pid, char *name, size_t size);
+
+/**
+    @brief Gets the start time of a process, which tells a process apart from a later one reusing its PID.
+
+    @param pid Process ID.
+    @return Start time after the system boot (clock ticks), 0 if the process is gone.
+*/
+unsigned long long process_start_time(int pid);
+
+/**
+    @brief Executes a shell command using execvp.
 
     @param command The shell command to execute.
 */
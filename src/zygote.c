@@ -0,0 +1,386 @@
+/**
+    @file zygote.c
+    @brief Process Watchdog Application Manager
+
+    The Process Watchdog application manages the processes listed in the configuration file.
+    It listens to a specified UDP port for heartbeat messages from these processes, which must
+    periodically send their PID. If any process stops running or fails to send its PID over UDP
+    within the expected interval, the Process Watchdog application will restart the process.
+
+    The application ensures high reliability and availability by continuously monitoring and
+    restarting processes as necessary. It also logs various statistics about the monitored
+    processes, including start times, crash times, and heartbeat intervals.
+
+    @date 2023-01-01
+    @version 1.0
+    @author by Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license GPL-3 License
+*/
+
+#include "zygote.h"
+#include "activation.h"
+#include "apps.h"
+#include "clock.h"
+#include "log.h"
+#include "placement.h"
+#include "utils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/socket.h>
+
+static int pids[MAX_APPS]; // zygote processes, 0 if none
+static int ctl[MAX_APPS]; // control sockets of the zygotes, non-blocking, valid while pids is set
+static bool ready[MAX_APPS];
+static clk_t started_ms[MAX_APPS]; // last start of the zygotes, 0 to start the next one at once
+static char cmds[MAX_APPS][MAX_APP_CMD_LENGTH]; // commands the zygotes were started with
+static char lines[MAX_APPS][16]; // reply lines read so far, completed by the next reads
+static size_t line_lengths[MAX_APPS];
+static bool pending[MAX_APPS][ZYGOTE_MAX_PENDING]; // requests waiting for their replies in order, true for a warm spare
+static clk_t pending_ms[MAX_APPS][ZYGOTE_MAX_PENDING]; // times the requests were sent
+static int pending_counts[MAX_APPS];
+
+static bool is_alive(int i)
+{
+    // The zygote is a child of the watchdog, reaped automatically once it exits
+    return 0 < pids[i] && 0 == kill(pids[i], 0);
+}
+
+// Handles a reply line of the zygote, the first one tells it is ready, the others are the PIDs it forked
+static void handle_reply(int i, const char *line)
+{
+    int value = atoi(line);
+
+    if(!ready[i])
+    {
+        if(0 == value)
+        {
+            ready[i] = true;
+            LOGI("Zygote of %s is ready after %llu ms", get_app_name(i), (unsigned long long)(clock_ms() - started_ms[i]));
+        }
+
+        return;
+    }
+
+    if(0 == pending_counts[i])
+    {
+        LOGW("Zygote of %s has sent an unexpected reply : %s", get_app_name(i), line);
+        return;
+    }
+
+    bool spare = pending[i][0];
+    pending_counts[i]--;
+    memmove(&pending[i][0], &pending[i][1], pending_counts[i] * sizeof(pending[i][0]));
+    memmove(&pending_ms[i][0], &pending_ms[i][1], pending_counts[i] * sizeof(pending_ms[i][0]));
+
+    if(0 >= value)
+    {
+        errno = (0 > value) ? -value : EINVAL;
+        value = -1;
+    }
+
+    set_forked_pid(i, value, spare);
+}
+
+// Reads the replies available on the control socket, a partial line is kept for the next read
+static int read_replies(int i)
+{
+    char data[64];
+    ssize_t length;
+
+    while(0 < (length = read(ctl[i], data, sizeof(data))))
+    {
+        for(ssize_t n = 0; n < length; n++)
+        {
+            if('\n' == data[n])
+            {
+                lines[i][line_lengths[i]] = '\0';
+                line_lengths[i] = 0;
+                handle_reply(i, lines[i]);
+            }
+            else if(line_lengths[i] < sizeof(lines[i]) - 1)
+            {
+                lines[i][line_lengths[i]++] = data[n];
+            }
+        }
+    }
+
+    // The socket is closed when the zygote exits
+    return (0 == length || (EAGAIN != errno && EWOULDBLOCK != errno && EINTR != errno)) ? 1 : 0;
+}
+
+// Handles the replies of the zygote, replaces it once it has exited or when a reply is late
+static void receive(int i)
+{
+    if(0 >= pids[i])
+    {
+        return;
+    }
+
+    if(read_replies(i) || !is_alive(i))
+    {
+        LOGW("Zygote of %s (PID %d) has exited, restarting it", get_app_name(i), pids[i]);
+        zygote_kill(i);
+    }
+    else if(0 < pending_counts[i] && clock_ms() - pending_ms[i][0] >= ZYGOTE_TIMEOUT)
+    {
+        LOGE("Zygote of %s does not reply, restarting it", get_app_name(i));
+        zygote_kill(i);
+    }
+}
+
+// Starts the zygote with the CPU and NUMA placement of the application, inherited by the processes it forks
+static int launch(int i)
+{
+    extern char **environ;
+    char args[MAX_APP_CMD_LENGTH];
+    char *argv[MAX_APP_ARGS];
+    char exe[MAX_APP_CMD_LENGTH];
+    char fd_env[32];
+    int sv[2], env_count = 0, n = 0;
+    pid_t pid = -1;
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_t actions;
+    sigset_t signals;
+
+    snprintf(cmds[i], sizeof(cmds[i]), "%s", get_zygote(i));
+    snprintf(args, sizeof(args), "%s", cmds[i]);
+    started_ms[i] = clock_ms();
+
+    if(0 < activation_count(i))
+    {
+        LOGW("Zygote of %s is not used, the sockets of the application are not passed through it", get_app_name(i));
+        return 1;
+    }
+
+    if(0 >= split_command(args, argv, MAX_APP_ARGS) || !find_executable(argv[0], exe, sizeof(exe)))
+    {
+        LOGE("Zygote of %s is invalid : %s", get_app_name(i), cmds[i]);
+        return 1;
+    }
+
+    // Kept above the file descriptor it is moved to, so dup2() clears close-on-exec
+    if(0 != socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) || 0 != fcntl(sv[0], F_SETFL, O_NONBLOCK))
+    {
+        LOGE("Zygote of %s cannot be connected : %s", get_app_name(i), strerror(errno));
+        return 1;
+    }
+
+    int child = fcntl(sv[1], F_DUPFD_CLOEXEC, ZYGOTE_FD + 1);
+    close(sv[1]);
+
+    while(NULL != environ[env_count])
+    {
+        env_count++;
+    }
+
+    char **envp = malloc((env_count + 2) * sizeof(char *));
+
+    if(0 > child || NULL == envp)
+    {
+        LOGE("Zygote of %s cannot be started : %s", get_app_name(i), strerror(errno));
+        close(sv[0]);
+
+        if(0 <= child)
+        {
+            close(child);
+        }
+
+        free(envp);
+        return 1;
+    }
+
+    snprintf(fd_env, sizeof(fd_env), "%s=%d", ZYGOTE_FD_ENV, ZYGOTE_FD);
+
+    for(int k = 0; k < env_count; k++)
+    {
+        if(0 != strncmp(environ[k], ZYGOTE_FD_ENV "=", sizeof(ZYGOTE_FD_ENV)))
+        {
+            envp[n++] = environ[k];
+        }
+    }
+
+    envp[n++] = fd_env;
+    envp[n] = NULL;
+    posix_spawnattr_init(&attr);
+    sigemptyset(&signals);
+    posix_spawnattr_setsigmask(&attr, &signals);
+    /* Reset the signals handled or ignored by the watchdog */
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGQUIT);
+    sigaddset(&signals, SIGUSR1);
+    sigaddset(&signals, SIGUSR2);
+    sigaddset(&signals, SIGCHLD);
+    sigaddset(&signals, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attr, &signals);
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETPGROUP);
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, child, ZYGOTE_FD);
+    placement_begin(i);
+    int ret = posix_spawn(&pid, exe, &actions, &attr, argv, envp);
+    placement_end(i, (0 == ret) ? pid : -1);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    free(envp);
+    close(child);
+
+    if(0 != ret)
+    {
+        LOGE("Zygote of %s cannot be started, error code: %d - %s", get_app_name(i), ret, strerror(ret));
+        close(sv[0]);
+        return 1;
+    }
+
+    pids[i] = pid;
+    ctl[i] = sv[0];
+    ready[i] = false;
+    line_lengths[i] = 0;
+    LOGI("Zygote of %s started (PID %d): %s", get_app_name(i), pid, cmds[i]);
+    return 0;
+}
+
+void zygote_update(int i)
+{
+    receive(i);
+
+    if(0 < pids[i] && 0 != strcmp(cmds[i], get_zygote(i)))
+    {
+        LOGN("Zygote of %s has changed, restarting it", get_app_name(i));
+        zygote_kill(i);
+        started_ms[i] = 0;
+    }
+
+    if(0 == pids[i] && 0 < strlen(get_zygote(i)) &&
+            (0 == started_ms[i] || clock_ms() - started_ms[i] >= (clk_t)ZYGOTE_RETRY * 1000))
+    {
+        launch(i);
+    }
+}
+
+bool zygote_ready(int i)
+{
+    return 0 < pids[i] && ready[i];
+}
+
+int zygote_spawn(int i, char *const argv[], bool spare)
+{
+    char request[MAX_APP_CMD_LENGTH + MAX_APP_ARGS];
+    size_t length = 0;
+
+    if(!zygote_ready(i) || ZYGOTE_MAX_PENDING <= pending_counts[i])
+    {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    // The arguments are separated by NUL characters, the last one is replaced by the newline
+    for(int n = 0; NULL != argv[n]; n++)
+    {
+        size_t size = strlen(argv[n]) + 1;
+
+        if(length + size > sizeof(request))
+        {
+            errno = E2BIG;
+            return -1;
+        }
+
+        memcpy(&request[length], argv[n], size);
+        length += size;
+    }
+
+    if(0 == length)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    request[length - 1] = '\n';
+
+    // A request sent in part would mix with the next one
+    if((ssize_t)length != send(ctl[i], request, length, MSG_NOSIGNAL))
+    {
+        LOGE("Zygote of %s does not accept requests, restarting it", get_app_name(i));
+        zygote_kill(i);
+        errno = EAGAIN;
+        return -1;
+    }
+
+    pending[i][pending_counts[i]] = spare;
+    pending_ms[i][pending_counts[i]] = clock_ms();
+    pending_counts[i]++;
+    return 0;
+}
+
+void zygote_wait(int i)
+{
+    while(0 < pids[i] && 0 < pending_counts[i])
+    {
+        clk_t waited = clock_ms() - pending_ms[i][0];
+        struct pollfd pfd = { ctl[i], POLLIN, 0 };
+
+        if(waited < ZYGOTE_TIMEOUT)
+        {
+            poll(&pfd, 1, (int)(ZYGOTE_TIMEOUT - waited));
+        }
+
+        receive(i);
+    }
+}
+
+int zygote_fds(int *fds, int max)
+{
+    int count = 0;
+
+    for(int i = 0; i < MAX_APPS && count < max; i++)
+    {
+        if(0 < pids[i])
+        {
+            fds[count++] = ctl[i];
+        }
+    }
+
+    return count;
+}
+
+void zygote_kill(int i)
+{
+    int count = pending_counts[i];
+
+    if(0 >= pids[i])
+    {
+        return;
+    }
+
+    // Only the zygote, the processes it forked lead their own process groups
+    kill(pids[i], SIGKILL);
+    close(ctl[i]);
+    LOGD("Zygote of %s (PID %d) stopped", get_app_name(i), pids[i]);
+    pids[i] = 0;
+    ready[i] = false;
+    pending_counts[i] = 0;
+
+    // The requests without a reply have failed, a process forked for them is not known
+    for(int n = 0; n < count; n++)
+    {
+        errno = ECONNRESET;
+        set_forked_pid(i, -1, pending[i][n]);
+    }
+}
+
+void zygote_stop(void)
+{
+    for(int i = 0; i < MAX_APPS; i++)
+    {
+        zygote_kill(i);
+    }
+}
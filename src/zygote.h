@@ -0,0 +1,108 @@
+/**
+    @file zygote.h
+    @brief Process Watchdog Application Manager
+
+    The Process Watchdog application manages the processes listed in the configuration file.
+    It listens to a specified UDP port for heartbeat messages from these processes, which must
+    periodically send their PID. If any process stops running or fails to send its PID over UDP
+    within the expected interval, the Process Watchdog application will restart the process.
+
+    The application ensures high reliability and availability by continuously monitoring and
+    restarting processes as necessary. It also logs various statistics about the monitored
+    processes, including start times, crash times, and heartbeat intervals.
+
+    @date 2023-01-01
+    @version 1.0
+    @author by Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license GPL-3 License
+*/
+
+#ifndef ZYGOTE_H
+#define ZYGOTE_H
+
+#include <stdbool.h>
+
+/**
+    @file zygote.h
+    @brief Fork server of an application with a preloaded runtime.
+
+    The zygote of an application is a long lived process started from its zygote command,
+    which loads the runtime and the modules of the application once and forks a new process
+    for every start of the application. It is connected to the watchdog by a stream socket
+    at the file descriptor WDT_ZYGOTE_FD, writes "0\n" once it is ready, then reads requests
+    made of the arguments of the command separated by NUL characters and ended by a newline,
+    and replies to every request with the PID of the forked process, or a negative errno,
+    followed by a newline. The forked process leads its own process group and the zygote
+    reaps the processes it forks and exits when the socket is closed.
+
+    The watchdog does not wait for the replies, the control socket wakes up its main loop and the
+    PID of a forked process is passed to set_forked_pid() once its reply line is complete. Until
+    its zygote is ready, or when it fails, the application is spawned directly. A zygote which
+    exits or does not reply is killed and started again, the applications it forked keep running.
+*/
+
+#define ZYGOTE_FD 3 /**< File descriptor of the control socket in the zygote. */
+#define ZYGOTE_FD_ENV "WDT_ZYGOTE_FD" /**< Environment variable holding the file descriptor of the control socket. */
+#define ZYGOTE_TIMEOUT 1000 /**< Maximum time to wait for the reply to a request (milliseconds). */
+#define ZYGOTE_MAX_PENDING 2 /**< Maximum number of requests waiting for their replies, for the application and its warm spare. */
+#define ZYGOTE_RETRY 5 /**< Minimum time between two starts of the zygote of an application (seconds). */
+
+/**
+    @brief Starts, checks and replaces the zygote of the specified application and handles its replies.
+
+    Called for every application by the application scan.
+
+    @param i Index of the application.
+*/
+void zygote_update(int i);
+
+/**
+    @brief Checks if the zygote of the specified application has loaded its runtime and accepts requests.
+
+    @param i Index of the application.
+    @return true if the zygote is ready, false otherwise or if the application has no zygote.
+*/
+bool zygote_ready(int i);
+
+/**
+    @brief Requests a process of the specified application from its zygote, without waiting for the reply.
+
+    @param i Index of the application.
+    @param argv Arguments of the command of the application.
+    @param spare true if the process is the warm spare of the application.
+    @return 0 if the request is sent, -1 on failure with errno set, EAGAIN if the zygote is not ready.
+*/
+int zygote_spawn(int i, char *const argv[], bool spare);
+
+/**
+    @brief Waits for the replies to the requests sent to the zygote of the specified application,
+    at most ZYGOTE_TIMEOUT milliseconds after every request.
+
+    @param i Index of the application.
+*/
+void zygote_wait(int i);
+
+/**
+    @brief Gets the control sockets of the zygotes, the main loop wakes up when a reply arrives or a zygote exits.
+
+    @param fds Array to store the file descriptors.
+    @param max Size of the array.
+    @return Number of the file descriptors stored.
+*/
+int zygote_fds(int *fds, int max);
+
+/**
+    @brief Kills the zygote of the specified application, the processes it forked keep running
+    and the requests without a reply fail.
+
+    @param i Index of the application.
+*/
+void zygote_kill(int i);
+
+/**
+    @brief Kills the zygotes of all the applications.
+*/
+void zygote_stop(void);
+
+#endif // ZYGOTE_H
@@ -0,0 +1,426 @@
+/**
+    @file bench.c
+    @brief Process Watchdog Application Manager
+
+    The Process Watchdog application manages the processes listed in the configuration file.
+    It listens to a specified UDP port for heartbeat messages from these processes, which must
+    periodically send their PID. If any process stops running or fails to send its PID over UDP
+    within the expected interval, the Process Watchdog application will restart the process.
+
+    The application ensures high reliability and availability by continuously monitoring and
+    restarting processes as necessary. It also logs various statistics about the monitored
+    processes, including start times, crash times, and heartbeat intervals.
+
+    @date 2023-01-01
+    @version 1.0
+    @author by Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license GPL-3 License
+*/
+
+/**
+    @file bench.c
+    @brief Micro-benchmarks of the hot-path primitives.
+
+    Every benchmark is repeated until it runs for at least BENCH_MIN_TIME, then its time and
+    heap allocations per operation are reported. The results are printed as a table into
+    stderr and written as JSON into the file given as the first argument (bench.json).
+
+    Usage: make bench
+*/
+
+#include "apps.h"
+#include "clock.h"
+#include "ini.h"
+#include "log.h"
+#include "resource.h"
+#include "stats.h"
+#include "utils.h"
+
+#include <limits.h>
+
+#define BENCH_MIN_TIME 200000000ULL // [ns] minimum measured time of a benchmark
+#define BENCH_MAX_RESULTS 64
+#define BENCH_BALLOON_MB 512 // [MB] memory touched by the watchdog for the spawn benchmark
+#define BENCH_SAMPLED_PROCS 1000 // processes sampled by the resource sampling benchmark
+
+/**
+    @brief Structure representing a benchmark result.
+*/
+typedef struct
+{
+    char name[64]; /**< Name of the benchmark. */
+    uint64_t iterations; /**< Number of measured operations. */
+    double ns_per_op; /**< Time per operation (nanoseconds). */
+    double allocs_per_op; /**< Heap allocations per operation. */
+} Result_t;
+
+static Result_t results[BENCH_MAX_RESULTS];
+static int result_count;
+static volatile uint64_t alloc_count;
+static volatile uintptr_t sink; // keeps the results of the benchmarked calls alive
+static int app_count; // number of applications of the current config
+
+// Heap allocation counters, they replace the allocator of the C library for the whole process
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+__attribute__((visibility("default"))) void *malloc(size_t size)
+{
+    alloc_count++;
+    return __libc_malloc(size);
+}
+
+__attribute__((visibility("default"))) void *calloc(size_t n, size_t size)
+{
+    alloc_count++;
+    return __libc_calloc(n, size);
+}
+
+__attribute__((visibility("default"))) void *realloc(void *ptr, size_t size)
+{
+    alloc_count++;
+    return __libc_realloc(ptr, size);
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void run(const char *name, void (*fn)(uint64_t n))
+{
+    uint64_t n = 1, elapsed = 0, allocs = 0;
+    fn(1); // warm up
+
+    while(elapsed < BENCH_MIN_TIME)
+    {
+        n *= 2;
+        uint64_t a = alloc_count;
+        uint64_t t = now_ns();
+        fn(n);
+        elapsed = now_ns() - t;
+        allocs = alloc_count - a;
+    }
+
+    if(result_count < BENCH_MAX_RESULTS)
+    {
+        Result_t *r = &results[result_count++];
+        snprintf(r->name, sizeof(r->name), "%s", name);
+        r->iterations = n;
+        r->ns_per_op = (double)elapsed / n;
+        r->allocs_per_op = (double)allocs / n;
+        fprintf(stderr, "%-36s %12llu ops %14.1f ns/op %8.2f allocs/op\n", r->name,
+                (unsigned long long)n, r->ns_per_op, r->allocs_per_op);
+    }
+}
+
+//------------------------------------------------------------------
+
+static int bench_spawn(int i)
+{
+    return 1000 + i; // fake PIDs, nothing is started
+}
+
+static int bench_kill(int pid, int sig)
+{
+    UNUSED(pid);
+    UNUSED(sig);
+    return 0;
+}
+
+static int bench_wait(int pid, int *status, int options)
+{
+    UNUSED(options);
+    *status = 0;
+    return pid;
+}
+
+static const ProcessOps_t bench_ops = { bench_spawn, bench_kill, bench_wait };
+
+static void write_config(const char *path, int count, const char *cmd)
+{
+    FILE *fp = fopen(path, "w");
+
+    if(NULL == fp)
+    {
+        perror(path);
+        exit(1);
+    }
+
+    fprintf(fp, "[processWatchdog]\nudp_port = 12345\nnWdtApps = %d\n", count);
+
+    for(int i = 1; i <= count; i++)
+    {
+        fprintf(fp, "%d_name = App%d\n%d_start_delay = 0\n%d_heartbeat_delay = 60\n"
+                "%d_heartbeat_interval = 20\n%d_cmd = %s %d crash\n",
+                i, i, i, i, i, i, cmd, i);
+    }
+
+    fclose(fp);
+}
+
+// Loads a config with the given number of apps and starts them with fake PIDs
+static void load_apps(int count, const char *cmd)
+{
+    write_config("bench.ini", count, cmd);
+    set_ini_file("bench.ini");
+
+    if(read_ini_file())
+    {
+        exit(1);
+    }
+
+    app_count = get_app_count();
+
+    for(int i = 0; i < app_count; i++)
+    {
+        start_application(i);
+    }
+}
+
+//------------------------------------------------------------------
+
+static void b_parse_number(uint64_t n)
+{
+    static const char data[] = "p1234567";
+
+    for(uint64_t k = 0; k < n; k++)
+    {
+        sink += parse_number(data, sizeof(data) - 1, NULL);
+    }
+}
+
+static void b_find_pid(uint64_t n)
+{
+    for(uint64_t k = 0; k < n; k++)
+    {
+        sink += find_pid(1000 + (int)(k % app_count));
+    }
+}
+
+static void b_find_pid_miss(uint64_t n)
+{
+    for(uint64_t k = 0; k < n; k++)
+    {
+        sink += find_pid(999);
+    }
+}
+
+static void b_is_timeup_sweep(uint64_t n)
+{
+    for(uint64_t k = 0; k < n; k++)
+    {
+        for(int i = 0; i < app_count; i++)
+        {
+            sink += is_timeup(i);
+        }
+    }
+}
+
+static void b_stats_heartbeat(uint64_t n)
+{
+    for(uint64_t k = 0; k < n; k++)
+    {
+        stats_update_heartbeat_time((int)(k % app_count), (time_t)(k & 31));
+    }
+}
+
+static void b_log(uint64_t n)
+{
+    for(uint64_t k = 0; k < n; k++)
+    {
+        LOGN("Benchmark log line %llu of %s", (unsigned long long)k, "bench");
+    }
+}
+
+static void b_spawn(uint64_t n)
+{
+    for(uint64_t k = 0; k < n; k++)
+    {
+        start_application(0);
+    }
+}
+
+static void b_resource_sample(uint64_t n)
+{
+    for(uint64_t k = 0; k < n; k++)
+    {
+        clock_sleep_ms(1000); // simulated, every call takes a sample
+        resource_sample(1);
+    }
+}
+
+static int ini_count_handler(void *user, const char *section, const char *name, const char *value)
+{
+    UNUSED(section);
+    UNUSED(name);
+    UNUSED(value);
+    (*(int *)user)++;
+    return 1;
+}
+
+static void b_ini_parse(uint64_t n)
+{
+    int pairs = 0;
+
+    for(uint64_t k = 0; k < n; k++)
+    {
+        ini_parse("bench.ini", ini_count_handler, &pairs);
+    }
+
+    sink += pairs;
+}
+
+static void b_read_ini_file(uint64_t n)
+{
+    for(uint64_t k = 0; k < n; k++)
+    {
+        read_ini_file();
+    }
+}
+
+static void b_crc16(uint64_t n)
+{
+    static unsigned char data[64] = "p1234567 heartbeat payload of a supervised application";
+
+    for(uint64_t k = 0; k < n; k++)
+    {
+        data[0] = (unsigned char)k;
+        sink += crc16(data, sizeof(data));
+    }
+}
+
+static void b_findin(uint64_t n)
+{
+    static char haystack[4096];
+    static char needle[] = "heartbeat";
+
+    if(0 == haystack[0])
+    {
+        memset(haystack, 'x', sizeof(haystack));
+        memcpy(&haystack[sizeof(haystack) - sizeof(needle) - 1], needle, sizeof(needle) - 1);
+    }
+
+    for(uint64_t k = 0; k < n; k++)
+    {
+        sink += (uintptr_t)findin(haystack, sizeof(haystack), needle, sizeof(needle) - 1);
+    }
+}
+
+//------------------------------------------------------------------
+
+static void write_json(const char *path)
+{
+    char ts[22];
+    FILE *fp = fopen(path, "w");
+
+    if(NULL == fp)
+    {
+        perror(path);
+        return;
+    }
+
+    fprintf(fp, "{\n  \"timestamp\": \"%s\",\n  \"max_apps\": %d,\n  \"benchmarks\": [\n", timestamp(ts, sizeof(ts)), MAX_APPS);
+
+    for(int i = 0; i < result_count; i++)
+    {
+        fprintf(fp, "    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.3f, \"allocs_per_op\": %.3f}%s\n",
+                results[i].name, (unsigned long long)results[i].iterations, results[i].ns_per_op,
+                results[i].allocs_per_op, i + 1 < result_count ? "," : "");
+    }
+
+    fprintf(fp, "  ]\n}\n");
+    fclose(fp);
+}
+
+int main(int argc, char *argv[])
+{
+    static const int counts[] = { 6, 64, 1024, 10000 };
+    char json[PATH_MAX];
+    char name[64];
+    char dir[] = "/tmp/wdtbench.XXXXXX";
+    char cmd[64];
+
+    if(NULL == realpath(".", json))
+    {
+        return 1;
+    }
+
+    snprintf(json + strlen(json), sizeof(json) - strlen(json), "/%s", argc > 1 ? argv[1] : "bench.json");
+
+    if(argc > 1 && '/' == argv[1][0])
+    {
+        snprintf(json, sizeof(json), "%s", argv[1]);
+    }
+
+    // Work in a scratch directory, the benchmarks create config, stats and log files
+    if(NULL == mkdtemp(dir) || 0 != chdir(dir))
+    {
+        perror("scratch directory");
+        return 1;
+    }
+
+    set_process_ops(&bench_ops);
+    run("parse_number", b_parse_number);
+
+    for(size_t c = 0; c < sizeof(counts) / sizeof(counts[0]) && counts[c] <= MAX_APPS; c++)
+    {
+        load_apps(counts[c], "/bin/true");
+        snprintf(name, sizeof(name), "find_pid/%d_apps", app_count);
+        run(name, b_find_pid);
+        snprintf(name, sizeof(name), "find_pid_miss/%d_apps", app_count);
+        run(name, b_find_pid_miss);
+        snprintf(name, sizeof(name), "is_timeup_sweep/%d_apps", app_count);
+        run(name, b_is_timeup_sweep);
+    }
+
+    load_apps(64, "/bin/true");
+    run("stats_update_heartbeat_time", b_stats_heartbeat);
+    log_file_output(false);
+    run("iLOG/file_off", b_log);
+    log_file_output(true);
+    run("iLOG/file_on", b_log);
+    load_apps(1000, "/bin/true");
+    run("ini_parse/1000_apps", b_ini_parse);
+    run("read_ini_file/1000_apps", b_read_ini_file);
+    run("crc16/64_bytes", b_crc16);
+    run("findin/4096_bytes", b_findin);
+    // Real processes, the spawn time must not depend on the memory size of the watchdog
+    signal(SIGCHLD, SIG_IGN);
+    set_process_ops(NULL);
+    load_apps(1, "/bin/true");
+    run("spawn/small_rss", b_spawn);
+    size_t balloon_size = (size_t)BENCH_BALLOON_MB << 20;
+    char *balloon = malloc(balloon_size);
+
+    if(NULL != balloon)
+    {
+        memset(balloon, 0x5A, balloon_size);
+        snprintf(name, sizeof(name), "spawn/%d_MB_rss", BENCH_BALLOON_MB);
+        run(name, b_spawn);
+        free(balloon);
+    }
+
+    // Real processes sampled from /proc, the cost per process is the result divided by the count
+    load_apps(BENCH_SAMPLED_PROCS <= MAX_APPS ? BENCH_SAMPLED_PROCS : MAX_APPS, "/bin/sh -c 'exec sleep 600'");
+    clock_simulate(true);
+    snprintf(name, sizeof(name), "resource_sample/%d_procs", app_count);
+    run(name, b_resource_sample);
+
+    for(int i = 0; i < app_count; i++)
+    {
+        kill_application(i);
+    }
+
+    clock_simulate(false);
+    signal(SIGCHLD, SIG_DFL);
+
+    write_json(json);
+    fprintf(stderr, "Results written into %s\n", json);
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+    return system(cmd);
+}
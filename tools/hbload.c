@@ -0,0 +1,525 @@
+/**
+    @file hbload.c
+    @brief Process Watchdog Application Manager
+
+    The Process Watchdog application manages the processes listed in the configuration file.
+    It listens to a specified UDP port for heartbeat messages from these processes, which must
+    periodically send their PID. If any process stops running or fails to send its PID over UDP
+    within the expected interval, the Process Watchdog application will restart the process.
+
+    The application ensures high reliability and availability by continuously monitoring and
+    restarting processes as necessary. It also logs various statistics about the monitored
+    processes, including start times, crash times, and heartbeat intervals.
+
+    @date 2023-01-01
+    @version 1.0
+    @author by Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license GPL-3 License
+*/
+
+/**
+    @file hbload.c
+    @brief Heartbeat load generator and soak benchmark.
+
+    Generates a config with N applications in a scratch directory, runs the watchdog on it
+    and keeps all N applications heartbeating at the given rate and jitter. Reports the drop
+    rate of the heartbeat socket, the heartbeat processing throughput, the CPU usage of the
+    watchdog and the number of false heartbeat timeouts.
+
+    Modes:
+    - proxy : the apps are /bin/sleep children, hbload sends the heartbeats on their behalf
+              from a single socket, this reaches high heartbeat rates cheaply.
+    - child : the apps are hbload instances in child role sending their own heartbeats.
+
+    Usage:
+    hbload [-n apps] [-r rate] [-j jitter] [-d seconds] [-m proxy|child] [-p port]
+           [-I heartbeat_interval] [-D heartbeat_delay] [-w watchdog]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <dirent.h>
+#include <signal.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define DISCOVERY_TIMEOUT 120 // [s] time to wait until the watchdog has started all apps
+#define RESCAN_PERIOD 1000 // [ms] period to look for restarted apps
+
+/**
+    @brief Structure representing a simulated application.
+*/
+typedef struct
+{
+    int pid; /**< Process ID of the application, 0 if not discovered yet. */
+    uint64_t next; /**< Monotonic time of the next heartbeat (microseconds). */
+} Load_t;
+
+static int app_count = 100;
+static double rate = 1.0; // heartbeats per second per app
+static int jitter = 20; // [%] of the heartbeat period
+static int duration = 30; // [s]
+static int port = 12345;
+static int heartbeat_interval = 5;
+static int heartbeat_delay = 30;
+static bool child_mode = false;
+static char watchdog[PATH_MAX] = "./processWatchdog";
+static char self[PATH_MAX];
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static uint64_t period_us(void)
+{
+    uint64_t period = (uint64_t)(1000000.0 / rate);
+    int64_t spread = (int64_t)period * jitter / 100;
+
+    if(0 < spread)
+    {
+        period += (rand() % (2 * spread + 1)) - spread;
+    }
+
+    return period;
+}
+
+static int open_socket(struct sockaddr_in *addr)
+{
+    int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(port);
+    addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+    return sockfd;
+}
+
+static int send_heartbeat(int sockfd, struct sockaddr_in *addr, int pid)
+{
+    char data[32];
+    int len = snprintf(data, sizeof(data), "p%d", pid);
+    return sendto(sockfd, data, len, 0, (struct sockaddr *)addr, sizeof(*addr)) == len ? 0 : 1;
+}
+
+// Child role : hbload -c <port> <rate> <jitter>
+static int run_child(void)
+{
+    struct sockaddr_in addr;
+    int sockfd = open_socket(&addr);
+    srand(getpid());
+
+    while(1)
+    {
+        send_heartbeat(sockfd, &addr, getpid());
+        usleep(period_us());
+    }
+
+    return 0;
+}
+
+static int write_config(const char *path)
+{
+    FILE *fp = fopen(path, "w");
+
+    if(NULL == fp)
+    {
+        perror(path);
+        return 1;
+    }
+
+    fprintf(fp, "[processWatchdog]\nudp_port = %d\nnWdtApps = %d\n", port, app_count);
+
+    for(int i = 0; i < app_count; i++)
+    {
+        fprintf(fp, "%d_name = L%d\n", i + 1, i + 1);
+        fprintf(fp, "%d_start_delay = 0\n", i + 1);
+        fprintf(fp, "%d_heartbeat_delay = %d\n", i + 1, heartbeat_delay);
+        fprintf(fp, "%d_heartbeat_interval = %d\n", i + 1, heartbeat_interval);
+
+        if(child_mode)
+        {
+            fprintf(fp, "%d_cmd = %s -c %d %g %d\n", i + 1, self, port, rate, jitter);
+        }
+        else
+        {
+            fprintf(fp, "%d_cmd = /bin/sleep %d\n", i + 1, duration + DISCOVERY_TIMEOUT + 600);
+        }
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+// Fills pids with the children of the given parent, returns their count
+static int find_children(int ppid, int *pids, int max)
+{
+    int count = 0;
+    DIR *dir = opendir("/proc");
+    struct dirent *de;
+
+    if(NULL == dir)
+    {
+        return 0;
+    }
+
+    while(count < max && NULL != (de = readdir(dir)))
+    {
+        char path[64], buf[512];
+        int pid = atoi(de->d_name);
+
+        if(0 >= pid)
+        {
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+        FILE *fp = fopen(path, "r");
+
+        if(NULL == fp)
+        {
+            continue;
+        }
+
+        if(NULL != fgets(buf, sizeof(buf), fp))
+        {
+            // pid (comm) state ppid ...
+            char *p = strrchr(buf, ')');
+            int parent = 0;
+
+            if(NULL != p && 1 == sscanf(p + 2, "%*c %d", &parent) && parent == ppid)
+            {
+                pids[count++] = pid;
+            }
+        }
+
+        fclose(fp);
+    }
+
+    closedir(dir);
+    return count;
+}
+
+static bool is_known(Load_t *apps, int pid)
+{
+    for(int i = 0; i < app_count; i++)
+    {
+        if(apps[i].pid == pid)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// CPU time of a process in clock ticks
+static unsigned long long cpu_ticks(int pid)
+{
+    char path[64], buf[1024];
+    unsigned long long utime = 0, stime = 0;
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    FILE *fp = fopen(path, "r");
+
+    if(NULL == fp)
+    {
+        return 0;
+    }
+
+    if(NULL != fgets(buf, sizeof(buf), fp))
+    {
+        char *p = strrchr(buf, ')');
+
+        if(NULL != p)
+        {
+            sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &utime, &stime);
+        }
+    }
+
+    fclose(fp);
+    return utime + stime;
+}
+
+// Drop counter and receive queue of the heartbeat socket from /proc/net/udp
+static unsigned long long socket_drops(unsigned long *rx_queue)
+{
+    char buf[512];
+    unsigned long long drops = 0;
+    FILE *fp = fopen("/proc/net/udp", "r");
+    *rx_queue = 0;
+
+    if(NULL == fp)
+    {
+        return 0;
+    }
+
+    while(NULL != fgets(buf, sizeof(buf), fp))
+    {
+        unsigned int local_port;
+        unsigned long rxq;
+        unsigned long long d;
+
+        // sl local_address rem_address st tx_queue:rx_queue tr:tm->when retrnsmt uid timeout inode ref pointer drops
+        if(3 == sscanf(buf, " %*d: %*x:%x %*x:%*x %*x %*x:%lx %*x:%*x %*x %*u %*u %*u %*u %*x %llu", &local_port, &rxq, &d) && (int)local_port == port)
+        {
+            drops += d;
+            *rx_queue += rxq;
+        }
+    }
+
+    fclose(fp);
+    return drops;
+}
+
+static void usage(const char *progname)
+{
+    fprintf(stderr, "%s [-n apps] [-r rate] [-j jitter] [-d seconds] [-m proxy|child] [-p port]\n"
+            "    [-I heartbeat_interval] [-D heartbeat_delay] [-w watchdog]\n"
+            "  -n  number of simulated apps (%d)\n"
+            "  -r  heartbeats per second per app (%g)\n"
+            "  -j  heartbeat period jitter in percent (%d)\n"
+            "  -d  measurement duration in seconds (%d)\n"
+            "  -m  proxy : sleeper children, heartbeats sent by hbload | child : hbload children\n"
+            "  -p  heartbeat UDP port (%d)\n"
+            "  -I  heartbeat_interval of the apps in seconds (%d)\n"
+            "  -D  heartbeat_delay of the apps in seconds (%d)\n"
+            "  -w  watchdog executable (%s)\n"
+            "The watchdog must be built with make MAX_APPS=<apps> for more than the default apps.\n",
+            progname, app_count, rate, jitter, duration, port, heartbeat_interval, heartbeat_delay, watchdog);
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+
+    if(NULL == realpath("/proc/self/exe", self))
+    {
+        strncpy(self, argv[0], sizeof(self) - 1);
+    }
+
+    if(5 == argc && 0 == strcmp(argv[1], "-c"))
+    {
+        port = atoi(argv[2]);
+        rate = atof(argv[3]);
+        jitter = atoi(argv[4]);
+        return run_child();
+    }
+
+    while((opt = getopt(argc, argv, "n:r:j:d:m:p:I:D:w:h")) != EOF)
+    {
+        switch(opt)
+        {
+            case 'n': app_count = atoi(optarg); break;
+            case 'r': rate = atof(optarg); break;
+            case 'j': jitter = atoi(optarg); break;
+            case 'd': duration = atoi(optarg); break;
+            case 'm': child_mode = (0 == strcmp(optarg, "child")); break;
+            case 'p': port = atoi(optarg); break;
+            case 'I': heartbeat_interval = atoi(optarg); break;
+            case 'D': heartbeat_delay = atoi(optarg); break;
+            case 'w': strncpy(watchdog, optarg, sizeof(watchdog) - 1); break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+
+    char path[PATH_MAX];
+
+    if(0 >= app_count || 0 >= rate || 0 >= duration || NULL == realpath(watchdog, path))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    strncpy(watchdog, path, sizeof(watchdog) - 1);
+    // Scratch directory for the config, statistics and logs of the watchdog
+    char dir[] = "/tmp/hbload.XXXXXX";
+
+    if(NULL == mkdtemp(dir) || 0 != chdir(dir) || write_config("config.ini"))
+    {
+        perror("scratch directory");
+        return 1;
+    }
+
+    // Orphans of the watchdog are reparented to us, so they can be cleaned up
+    prctl(PR_SET_CHILD_SUBREAPER, 1);
+    printf("hbload: %d apps, %g heartbeats/s/app (%g/s total), jitter %d%%, %s mode, %d s in %s\n",
+           app_count, rate, rate * app_count, jitter, child_mode ? "child" : "proxy", duration, dir);
+    fflush(stdout);
+    int wdt = fork();
+
+    if(0 == wdt)
+    {
+        if(NULL == freopen("/dev/null", "w", stdout) || NULL == freopen("/dev/null", "w", stderr))
+        {
+            _exit(1);
+        }
+
+        execl(watchdog, watchdog, "-i", "config.ini", (char *)NULL);
+        _exit(1);
+    }
+
+    Load_t *apps = calloc(app_count, sizeof(Load_t));
+    int *pids = calloc(app_count * 2, sizeof(int));
+
+    if(0 > wdt || NULL == apps || NULL == pids)
+    {
+        perror("start");
+        return 1;
+    }
+
+    // Wait until the watchdog has started all apps
+    uint64_t t0 = now_us();
+    int found = 0;
+
+    while(found < app_count && now_us() - t0 < DISCOVERY_TIMEOUT * 1000000ULL && 0 == waitpid(wdt, NULL, WNOHANG))
+    {
+        usleep(200000);
+        found = find_children(wdt, pids, app_count);
+    }
+
+    if(found < app_count)
+    {
+        fprintf(stderr, "hbload: watchdog started %d of %d apps, check MAX_APPS of the watchdog build\n", found, app_count);
+    }
+
+    printf("hbload: %d apps started in %.2f s\n", found, (now_us() - t0) / 1e6);
+    srand(time(NULL));
+
+    for(int i = 0; i < found; i++)
+    {
+        apps[i].pid = pids[i];
+        apps[i].next = now_us() + (uint64_t)(rand() % (int)(1000000.0 / rate + 1));
+    }
+
+    struct sockaddr_in addr;
+    int sockfd = open_socket(&addr);
+    unsigned long rx_queue;
+    unsigned long long drops0 = socket_drops(&rx_queue);
+    unsigned long long cpu0 = cpu_ticks(wdt);
+    unsigned long long sent = 0, send_errors = 0;
+    int restarts = 0;
+    uint64_t start = now_us(), end = start + (uint64_t)duration * 1000000ULL, rescan = start;
+
+    // Measurement : a proxy sends the heartbeats of all apps, child apps send their own
+    while(now_us() < end && 0 == waitpid(wdt, NULL, WNOHANG))
+    {
+        uint64_t t = now_us(), next = t + 1000;
+
+        if(t >= rescan)
+        {
+            // A new child is an app restarted by the watchdog, which is a false timeout here
+            int n = find_children(wdt, pids, app_count * 2);
+
+            for(int k = 0; k < n; k++)
+            {
+                if(!is_known(apps, pids[k]))
+                {
+                    int slot = -1;
+
+                    for(int i = 0; i < app_count && slot < 0; i++)
+                    {
+                        if(0 == apps[i].pid || 0 != kill(apps[i].pid, 0))
+                        {
+                            slot = i;
+                        }
+                    }
+
+                    if(0 <= slot)
+                    {
+                        restarts += (0 != apps[slot].pid);
+                        apps[slot].pid = pids[k];
+                        apps[slot].next = t;
+                    }
+                }
+            }
+
+            rescan = t + RESCAN_PERIOD * 1000ULL;
+        }
+
+        if(!child_mode)
+        {
+            for(int i = 0; i < app_count; i++)
+            {
+                if(0 < apps[i].pid && apps[i].next <= t)
+                {
+                    if(send_heartbeat(sockfd, &addr, apps[i].pid))
+                    {
+                        send_errors++;
+                    }
+                    else
+                    {
+                        sent++;
+                    }
+
+                    apps[i].next += period_us();
+
+                    if(apps[i].next < t)
+                    {
+                        apps[i].next = t + period_us(); // sender is overloaded, do not burst
+                    }
+                }
+
+                if(0 < apps[i].pid && apps[i].next < next)
+                {
+                    next = apps[i].next;
+                }
+            }
+        }
+
+        t = now_us();
+
+        if(next > t)
+        {
+            usleep(next - t);
+        }
+    }
+
+    double elapsed = (now_us() - start) / 1e6;
+    unsigned long long drops = socket_drops(&rx_queue) - drops0;
+    unsigned long long cpu = cpu_ticks(wdt) - cpu0;
+
+    if(child_mode)
+    {
+        sent = (unsigned long long)(rate * elapsed * found); // expected, the children do not report
+    }
+
+    unsigned long long delivered = sent > drops ? sent - drops : 0;
+    printf("hbload: results over %.2f s\n", elapsed);
+    printf("  heartbeats sent       : %llu (%.0f/s)%s\n", sent, sent / elapsed, child_mode ? " expected" : "");
+    printf("  send errors           : %llu\n", send_errors);
+    printf("  dropped by socket     : %llu (%.3f %%)\n", drops, sent ? 100.0 * drops / sent : 0.0);
+    printf("  still queued          : %lu bytes\n", rx_queue);
+    printf("  processing throughput : %.0f heartbeats/s\n", delivered / elapsed);
+    printf("  watchdog CPU usage    : %.1f %% of one core\n", 100.0 * cpu / sysconf(_SC_CLK_TCK) / elapsed);
+    printf("  false timeouts        : %d\n", restarts);
+    // The watchdog stops the apps one by one, which takes too long for large app counts
+    kill(wdt, SIGKILL);
+    waitpid(wdt, NULL, 0);
+    int n = find_children(getpid(), pids, app_count * 2);
+
+    for(int k = 0; k < n; k++)
+    {
+        kill(pids[k], SIGKILL);
+    }
+
+    while(0 < waitpid(-1, NULL, 0));
+
+    free(apps);
+    free(pids);
+    printf("hbload: scratch directory %s kept for the watchdog logs\n", dir);
+    return 0;
+}
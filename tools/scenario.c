@@ -0,0 +1,395 @@
+/**
+    @file scenario.c
+    @brief Process Watchdog Application Manager
+
+    The Process Watchdog application manages the processes listed in the configuration file.
+    It listens to a specified UDP port for heartbeat messages from these processes, which must
+    periodically send their PID. If any process stops running or fails to send its PID over UDP
+    within the expected interval, the Process Watchdog application will restart the process.
+
+    The application ensures high reliability and availability by continuously monitoring and
+    restarting processes as necessary. It also logs various statistics about the monitored
+    processes, including start times, crash times, and heartbeat intervals.
+
+    @date 2023-01-01
+    @version 1.0
+    @author by Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license GPL-3 License
+*/
+
+/**
+    @file scenario.c
+    @brief Supervision scenario runner.
+
+    Every scenario runs its own watchdog in a scratch directory on a generated config whose
+    applications are test_child instances with a scripted misbehaviour. The restarts done by
+    the watchdog are counted by following its children and compared with the expected range.
+    The processes left behind by the applications are reported as well. All scenarios run
+    in parallel, the exit code is the number of failed scenarios.
+
+    Usage:
+    scenario [-n apps] [-s scenario] [-l] [-w watchdog] [-c test_child] [-p port]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <dirent.h>
+#include <libgen.h>
+#include <signal.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+
+#define POLL_PERIOD 200 // [ms] period to look for restarted apps
+#define MAX_SEEN 4096 // maximum number of distinct app PIDs followed per scenario
+
+/**
+    @brief Structure representing a supervision scenario.
+*/
+typedef struct
+{
+    const char *name; /**< Name of the scenario. */
+    const char *args; /**< Options of test_child, the port is added. */
+    int heartbeat_delay; /**< heartbeat_delay of the apps (seconds). */
+    int heartbeat_interval; /**< heartbeat_interval of the apps (seconds). */
+    int duration; /**< Observation time (seconds). */
+    int min_restarts; /**< Minimum expected restarts per app. */
+    int max_restarts; /**< Maximum expected restarts per app. */
+    const char *keys; /**< Additional ini keys of the apps separated by ';', the index prefix is added. */
+} Scenario_t;
+
+static const Scenario_t scenarios[] =
+{
+    { "steady",           "-i 1000",              5, 3, 12, 0, 0, NULL },
+    { "jitter",           "-i 1500 -j 80",        5, 4, 12, 0, 0, NULL },
+    { "burst",            "-i 1000 -b 200",       5, 3, 12, 0, 0, NULL },
+    { "cpu_hog",          "-i 1000 -c",           5, 3, 12, 0, 0, NULL },
+    { "memory_leak",      "-i 500 -l 512",        5, 3, 12, 0, 0, NULL },
+    { "slow_start",       "-s 3000",              5, 3, 12, 0, 0, NULL },
+    { "slow_start_late",  "-s 8000",              3, 3, 12, 1, 3, NULL },
+    { "periodic_hang",    "-H 3:6",               5, 3, 14, 1, 3, NULL },
+    { "exit_normally",    "-e 3:normal",          5, 3, 12, 1, 4, NULL },
+    { "exit_crashed",     "-e 3:crashed",         5, 3, 12, 1, 4, NULL },
+    { "exit_restart",     "-e 3:restart",         5, 3, 12, 1, 4, NULL },
+    { "exit_reboot",      "-e 3:reboot",          5, 3, 12, 1, 4, NULL },
+    { "orphans",          "-o 2 -e 3:crashed",    5, 3, 12, 1, 4, NULL },
+    { "ignore_sigterm",   "-T -H 3:600",          5, 3, 85, 1, 2, NULL },
+    { "crash_loop",       "-e 1:crashed",         5, 3, 20, 3, 6, NULL },
+    { "memory_limit",     "-i 500 -l 4096",       5, 3, 14, 1, 3, "max_rss_mb = 32" },
+    { "cpu_limit",        "-i 1000 -c",           5, 3, 14, 1, 3, "max_cpu_pct = 10;max_cpu_duration = 3" },
+};
+
+#define SCENARIO_COUNT (int)(sizeof(scenarios) / sizeof(scenarios[0]))
+
+static int app_count = 2;
+static int port = 12500;
+static char watchdog[PATH_MAX] = "./processWatchdog";
+static char child[PATH_MAX];
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+static int write_config(const char *path, const Scenario_t *s, int udp_port)
+{
+    FILE *fp = fopen(path, "w");
+
+    if(NULL == fp)
+    {
+        perror(path);
+        return 1;
+    }
+
+    fprintf(fp, "[processWatchdog]\nudp_port = %d\nnWdtApps = %d\nsample_interval = 1\n", udp_port, app_count);
+
+    for(int i = 1; i <= app_count; i++)
+    {
+        fprintf(fp, "%d_name = %s%d\n", i, s->name, i);
+        fprintf(fp, "%d_start_delay = 0\n", i);
+        fprintf(fp, "%d_heartbeat_delay = %d\n", i, s->heartbeat_delay);
+        fprintf(fp, "%d_heartbeat_interval = %d\n", i, s->heartbeat_interval);
+
+        for(const char *k = s->keys; NULL != k && 0 != *k; k += strcspn(k, ";") + (';' == k[strcspn(k, ";")]))
+        {
+            fprintf(fp, "%d_%.*s\n", i, (int)strcspn(k, ";"), k);
+        }
+
+        fprintf(fp, "%d_cmd = %s -q -p %d %s\n", i, child, udp_port, s->args);
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+// Fills pids with the children of the given parent, returns their count
+static int find_children(int ppid, int *pids, int max)
+{
+    int count = 0;
+    DIR *dir = opendir("/proc");
+    struct dirent *de;
+
+    if(NULL == dir)
+    {
+        return 0;
+    }
+
+    while(count < max && NULL != (de = readdir(dir)))
+    {
+        char path[64], buf[512];
+        int pid = atoi(de->d_name);
+
+        if(0 >= pid)
+        {
+            continue;
+        }
+
+        snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+        FILE *fp = fopen(path, "r");
+
+        if(NULL == fp)
+        {
+            continue;
+        }
+
+        if(NULL != fgets(buf, sizeof(buf), fp))
+        {
+            // pid (comm) state ppid ...
+            char *p = strrchr(buf, ')');
+            char state = 0;
+            int parent = 0;
+
+            if(NULL != p && 2 == sscanf(p + 2, "%c %d", &state, &parent) && parent == ppid && 'Z' != state)
+            {
+                pids[count++] = pid;
+            }
+        }
+
+        fclose(fp);
+    }
+
+    closedir(dir);
+    return count;
+}
+
+static bool add_seen(int *seen, int *seen_count, int pid)
+{
+    for(int k = 0; k < *seen_count; k++)
+    {
+        if(seen[k] == pid)
+        {
+            return false;
+        }
+    }
+
+    if(*seen_count < MAX_SEEN)
+    {
+        seen[(*seen_count)++] = pid;
+    }
+
+    return true;
+}
+
+// Runs one scenario in its own process, returns 0 when the outcome is as expected
+static int run_scenario(int index)
+{
+    const Scenario_t *s = &scenarios[index];
+    int udp_port = port + index;
+    char dir[] = "/tmp/scenario.XXXXXX";
+    static int seen[MAX_SEEN];
+    int seen_count = 0;
+    int *pids = calloc(MAX_SEEN, sizeof(int));
+
+    if(NULL == pids || NULL == mkdtemp(dir) || 0 != chdir(dir) || write_config("config.ini", s, udp_port))
+    {
+        perror(s->name);
+        return 1;
+    }
+
+    // Orphans of the apps are reparented to this process, so they can be counted and cleaned up
+    prctl(PR_SET_CHILD_SUBREAPER, 1);
+    int wdt = fork();
+
+    if(0 == wdt)
+    {
+        if(NULL == freopen("/dev/null", "w", stdout) || NULL == freopen("/dev/null", "w", stderr))
+        {
+            _exit(1);
+        }
+
+        execl(watchdog, watchdog, "-i", "config.ini", (char *)NULL);
+        _exit(1);
+    }
+
+    if(0 > wdt)
+    {
+        perror(s->name);
+        return 1;
+    }
+
+    uint64_t end = now_ms() + s->duration * 1000ULL;
+    bool alive = true;
+
+    while(now_ms() < end && (alive = (0 == waitpid(wdt, NULL, WNOHANG))))
+    {
+        int n = find_children(wdt, pids, MAX_SEEN);
+
+        for(int k = 0; k < n; k++)
+        {
+            add_seen(seen, &seen_count, pids[k]);
+        }
+
+        usleep(POLL_PERIOD * 1000);
+    }
+
+    int restarts = seen_count > app_count ? seen_count - app_count : 0;
+    int leftover = 0;
+    int n = find_children(getpid(), pids, MAX_SEEN);
+
+    for(int k = 0; k < n; k++)
+    {
+        leftover += (pids[k] != wdt);
+    }
+
+    // Stop the watchdog, its apps and the leftovers without waiting for the termination escalation
+    kill(wdt, SIGKILL);
+    waitpid(wdt, NULL, 0);
+
+    // The apps and their orphans are reparented here, repeat as long as they may still be forking
+    do
+    {
+        n = find_children(getpid(), pids, MAX_SEEN);
+
+        for(int k = 0; k < n; k++)
+        {
+            kill(pids[k], SIGKILL);
+        }
+
+        while(0 < waitpid(-1, NULL, WNOHANG));
+        usleep(10000);
+    }
+    while(0 < n);
+
+    bool pass = alive && restarts >= s->min_restarts * app_count && restarts <= s->max_restarts * app_count;
+    printf("%-4s %-18s restarts %3d (expected %d..%d)  leftover processes %3d%s\n", pass ? "PASS" : "FAIL",
+           s->name, restarts, s->min_restarts * app_count, s->max_restarts * app_count, leftover,
+           alive ? "" : "  watchdog exited");
+    fflush(stdout);
+    char cmd[64];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+
+    if(0 != system(cmd))
+    {
+        fprintf(stderr, "%s: failed to remove %s\n", s->name, dir);
+    }
+
+    free(pids);
+    return pass ? 0 : 1;
+}
+
+static void usage(const char *progname)
+{
+    fprintf(stderr, "%s [-n apps] [-s scenario] [-l] [-w watchdog] [-c test_child] [-p port]\n"
+            "  -n  number of apps per scenario (%d)\n"
+            "  -s  run only the given scenario\n"
+            "  -l  list the scenarios\n"
+            "  -w  watchdog executable (%s)\n"
+            "  -c  test child executable (test_child next to %s)\n"
+            "  -p  heartbeat UDP port of the first scenario, the others use the following ports (%d)\n",
+            progname, app_count, watchdog, progname, port);
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    const char *only = NULL;
+    char path[PATH_MAX];
+
+    if(NULL != realpath("/proc/self/exe", path))
+    {
+        snprintf(child, sizeof(child), "%s/test_child", dirname(path));
+    }
+
+    while((opt = getopt(argc, argv, "n:s:lw:c:p:h")) != EOF)
+    {
+        switch(opt)
+        {
+            case 'n': app_count = atoi(optarg); break;
+            case 's': only = optarg; break;
+            case 'l':
+                for(int i = 0; i < SCENARIO_COUNT; i++)
+                {
+                    printf("%-18s test_child %s\n", scenarios[i].name, scenarios[i].args);
+                }
+
+                return 0;
+
+            case 'w': strncpy(watchdog, optarg, sizeof(watchdog) - 1); break;
+            case 'c': strncpy(child, optarg, sizeof(child) - 1); break;
+            case 'p': port = atoi(optarg); break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+
+    if(0 >= app_count || NULL == realpath(watchdog, path))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    strncpy(watchdog, path, sizeof(watchdog) - 1);
+
+    if(NULL == realpath(child, path))
+    {
+        fprintf(stderr, "test_child not found : %s\n", child);
+        return 1;
+    }
+
+    strncpy(child, path, sizeof(child) - 1);
+    printf("scenario: %d apps per scenario\n", app_count);
+    fflush(stdout);
+    int started = 0, failed = 0;
+
+    for(int i = 0; i < SCENARIO_COUNT; i++)
+    {
+        if(NULL != only && 0 != strcmp(only, scenarios[i].name))
+        {
+            continue;
+        }
+
+        int pid = fork();
+
+        if(0 == pid)
+        {
+            exit(run_scenario(i));
+        }
+
+        started += (0 < pid);
+    }
+
+    if(0 == started)
+    {
+        fprintf(stderr, "No scenario run\n");
+        return 1;
+    }
+
+    int status;
+
+    while(0 < wait(&status))
+    {
+        failed += !(WIFEXITED(status) && 0 == WEXITSTATUS(status));
+    }
+
+    printf("scenario: %d of %d passed\n", started - failed, started);
+    return failed;
+}
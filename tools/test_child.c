@@ -0,0 +1,250 @@
+/**
+    @file test_child.c
+    @brief Process Watchdog Application Manager
+
+    The Process Watchdog application manages the processes listed in the configuration file.
+    It listens to a specified UDP port for heartbeat messages from these processes, which must
+    periodically send their PID. If any process stops running or fails to send its PID over UDP
+    within the expected interval, the Process Watchdog application will restart the process.
+
+    The application ensures high reliability and availability by continuously monitoring and
+    restarting processes as necessary. It also logs various statistics about the monitored
+    processes, including start times, crash times, and heartbeat intervals.
+
+    @date 2023-01-01
+    @version 1.0
+    @author by Eray Ozturk | erayozturk1@gmail.com
+    @url github.com/diffstorm
+    @license GPL-3 License
+*/
+
+/**
+    @file test_child.c
+    @brief Fault-injection test child with deterministic misbehaviour modes.
+
+    A small replacement of test_child.py, it sends heartbeats to the watchdog and misbehaves
+    as scripted by its options, so the supervision can be tested with many cheap instances.
+
+    Usage:
+    test_child -p port [-i interval_ms] [-j jitter] [-s start_ms] [-H every_s:for_s] [-T]
+               [-o orphans] [-b burst] [-e after_s:code] [-l leak_kb] [-c] [-q]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define ORPHAN_LIFETIME 600 // [s] orphaned grandchildren exit by themselves after this time
+
+static int port = 0;
+static int interval = 1000; // [ms] heartbeat period
+static int jitter = 0; // [%] of the heartbeat period
+static int start_delay = 0; // [ms] before the first heartbeat
+static int hang_every = 0; // [s] period of the hangs, 0 disables
+static int hang_for = 0; // [s] length of a hang
+static bool ignore_sigterm = false;
+static int orphans = 0; // grandchildren left behind
+static int burst = 1; // heartbeats sent per period
+static int exit_after = -1; // [s] exit time, -1 disables
+static int exit_code = 0;
+static int leak_kb = 0; // [KB] leaked per heartbeat period
+static bool cpu_hog = false;
+static bool quiet = false;
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+static void say(const char *what)
+{
+    if(!quiet)
+    {
+        printf("test_child %d: %s\n", getpid(), what);
+        fflush(stdout);
+    }
+}
+
+// Waits until the given time, burning CPU in hog mode
+static void wait_until(uint64_t t)
+{
+    if(cpu_hog)
+    {
+        volatile uint64_t spin = 0;
+
+        while(now_ms() < t)
+        {
+            spin++;
+        }
+    }
+    else
+    {
+        uint64_t now = now_ms();
+
+        if(t > now)
+        {
+            usleep((t - now) * 1000);
+        }
+    }
+}
+
+static int period_ms(void)
+{
+    int spread = interval * jitter / 100;
+    return interval + (0 < spread ? (rand() % (2 * spread + 1)) - spread : 0);
+}
+
+static void spawn_orphans(void)
+{
+    for(int n = 0; n < orphans; n++)
+    {
+        if(0 == fork())
+        {
+            // The grandchild outlives its parent and is reparented
+            signal(SIGTERM, SIG_IGN);
+            sleep(ORPHAN_LIFETIME);
+            _exit(0);
+        }
+    }
+}
+
+static int exit_code_of(const char *name)
+{
+    static const char *names[] = { "normal", "crashed", "restart", "reboot" }; // EXIT_* in utils.h
+
+    for(int n = 0; n < (int)(sizeof(names) / sizeof(names[0])); n++)
+    {
+        if(0 == strcmp(name, names[n]))
+        {
+            return n;
+        }
+    }
+
+    return atoi(name);
+}
+
+static void usage(const char *progname)
+{
+    fprintf(stderr, "%s -p port [-i interval_ms] [-j jitter] [-s start_ms] [-H every_s:for_s] [-T]\n"
+            "    [-o orphans] [-b burst] [-e after_s:code] [-l leak_kb] [-c] [-q]\n"
+            "  -p  heartbeat UDP port of the watchdog\n"
+            "  -i  heartbeat period in milliseconds (%d)\n"
+            "  -j  heartbeat period jitter in percent (%d)\n"
+            "  -s  slow start, delay of the first heartbeat in milliseconds\n"
+            "  -H  periodic hang, stop the heartbeats every X seconds for Y seconds\n"
+            "  -T  ignore SIGTERM\n"
+            "  -o  fork the given number of grandchildren and orphan them\n"
+            "  -b  heartbeat burst, send the given number of heartbeats per period\n"
+            "  -e  exit after X seconds with the code Y : normal, crashed, restart, reboot or a number\n"
+            "  -l  leak the given KB of memory per heartbeat period\n"
+            "  -c  busy-loop between the heartbeats\n"
+            "  -q  quiet\n",
+            progname, interval, jitter);
+}
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    char code[16];
+
+    while((opt = getopt(argc, argv, "p:i:j:s:H:To:b:e:l:cqh")) != EOF)
+    {
+        switch(opt)
+        {
+            case 'p': port = atoi(optarg); break;
+            case 'i': interval = atoi(optarg); break;
+            case 'j': jitter = atoi(optarg); break;
+            case 's': start_delay = atoi(optarg); break;
+            case 'H': sscanf(optarg, "%d:%d", &hang_every, &hang_for); break;
+            case 'T': ignore_sigterm = true; break;
+            case 'o': orphans = atoi(optarg); break;
+            case 'b': burst = atoi(optarg); break;
+            case 'e':
+                if(2 == sscanf(optarg, "%d:%15s", &exit_after, code))
+                {
+                    exit_code = exit_code_of(code);
+                }
+
+                break;
+
+            case 'l': leak_kb = atoi(optarg); break;
+            case 'c': cpu_hog = true; break;
+            case 'q': quiet = true; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+
+    if(0 >= port || 0 >= interval || 0 > jitter || 100 < jitter || 0 >= burst)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Ignored signals are inherited over exec, start from a known state
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, ignore_sigterm ? SIG_IGN : SIG_DFL);
+    srand(getpid());
+    say("started");
+    spawn_orphans();
+
+    struct sockaddr_in addr;
+    int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    char data[32];
+    int len = snprintf(data, sizeof(data), "p%d", getpid());
+    uint64_t start = now_ms();
+    uint64_t next_hang = start + hang_every * 1000ULL;
+    wait_until(start + start_delay);
+
+    while(1)
+    {
+        uint64_t t = now_ms();
+
+        if(0 <= exit_after && t - start >= exit_after * 1000ULL)
+        {
+            say("exiting");
+            exit(exit_code);
+        }
+
+        if(0 < hang_every && t >= next_hang)
+        {
+            say("hanging");
+            wait_until(t + hang_for * 1000ULL);
+            next_hang = now_ms() + hang_every * 1000ULL;
+            say("resumed");
+        }
+
+        for(int n = 0; n < burst; n++)
+        {
+            sendto(sockfd, data, len, 0, (struct sockaddr *)&addr, sizeof(addr));
+        }
+
+        if(0 < leak_kb)
+        {
+            char *leak = malloc(leak_kb * 1024);
+
+            if(NULL != leak)
+            {
+                memset(leak, 0xA5, leak_kb * 1024); // touch the pages so they count in the RSS
+            }
+        }
+
+        wait_until(now_ms() + period_ms());
+    }
+
+    return 0;
+}
@@ -0,0 +1,69 @@
+# processWatchdog zygote for python applications
+# Copyright (c) 2023 Eray Ozturk <erayozturk1@gmail.com>
+
+# Usage, in the ini file:
+# 1_zygote = /usr/bin/python3 zygote.py <module> ...
+# 1_cmd = /usr/bin/python3 test_child.py 1 crash
+#
+# The modules are imported once, every start of the application is forked from this
+# process and runs the script of its command without starting the interpreter again.
+# Commands which are not a python script are executed as usual.
+
+import importlib
+import os
+import runpy
+import signal
+import socket
+import sys
+import traceback
+
+for module in sys.argv[1:]:
+    importlib.import_module(module)
+
+# The forked applications are reaped automatically
+signal.signal(signal.SIGCHLD, signal.SIG_IGN)
+
+control = socket.socket(fileno=int(os.environ.pop("WDT_ZYGOTE_FD")))
+control.sendall(b"0\n")  # ready
+requests = control.makefile("rb")
+
+
+def run(argv):
+    requests.close()
+    control.close()
+    os.setpgid(0, 0)
+    signal.signal(signal.SIGCHLD, signal.SIG_DFL)
+    code = 0
+
+    try:
+        if len(argv) > 1 and os.path.basename(argv[0]).startswith("python") and argv[1].endswith(".py"):
+            sys.argv = argv[1:]
+            sys.path[0] = os.path.dirname(os.path.abspath(argv[1]))
+            runpy.run_path(argv[1], run_name="__main__")
+        else:
+            os.execvp(argv[0], argv)
+    except SystemExit as e:
+        code = e.code if isinstance(e.code, int) else (0 if e.code is None else 1)
+    except BaseException:
+        traceback.print_exc()
+        code = 1
+
+    sys.stdout.flush()
+    sys.stderr.flush()
+    os._exit(code)
+
+
+# Exits when the watchdog closes the control socket
+for request in requests:
+    argv = [arg.decode() for arg in request.rstrip(b"\n").split(b"\0")]
+
+    try:
+        pid = os.fork()
+    except OSError as e:
+        control.sendall(b"-%d\n" % e.errno)
+        continue
+
+    if pid == 0:
+        run(argv)
+
+    control.sendall(b"%d\n" % pid)